@@ -30,6 +30,7 @@
 #include <QTimer>
 #include <QElapsedTimer>
 #include <QFuture>
+#include <QMetaMethod>
 
 AbstractImageGrabber::AbstractImageGrabber(QObject *parent)
     : AbstractGrabber(parent)
@@ -41,6 +42,7 @@ AbstractImageGrabber::AbstractImageGrabber(QObject *parent)
     , m_timer(0)
     , m_initTime(0)
 {
+    qRegisterMetaType<VideoFrame>("VideoFrame");
 }
 
 AbstractImageGrabber::~AbstractImageGrabber()
@@ -126,7 +128,7 @@ void AbstractImageGrabber::startGrabbing()
 
 void AbstractImageGrabber::grab()
 {
-    QImage frame;//this stores grabbed image
+    VideoFrame frame;//this stores grabbed frame
     QEventLoop latencyLoop;
     QElapsedTimer timer;
 
@@ -142,7 +144,7 @@ void AbstractImageGrabber::grab()
         if (isStopRequest() || isPauseRequest())
             break;
 
-        frame = captureFrame();
+        frame = captureVideoFrame();
 
         setGrabbedFrameCount(grabbedFrameCount() + 1);
         
@@ -150,7 +152,11 @@ void AbstractImageGrabber::grab()
 
         if (m_prevPts != pts) {
             m_prevPts = pts;
-            Q_EMIT frameAvailable(frame, pts);
+            Q_EMIT videoFrameAvailable(frame, pts);
+
+            //converting to QImage is only paid for when someone wants it
+            if (isSignalConnected(QMetaMethod::fromSignal(&AbstractImageGrabber::frameAvailable)))
+                Q_EMIT frameAvailable(frame.toImage(), pts);
         }
 
         //check if we must finish grabbing
@@ -171,9 +177,15 @@ void AbstractImageGrabber::grab()
     setStopRequest(false);
     setPauseRequest(false);
 
+    Q_EMIT videoFrameAvailable(VideoFrame(), pts);
     Q_EMIT frameAvailable(QImage(), pts);
 }
 
+VideoFrame AbstractImageGrabber::captureVideoFrame()
+{
+    return VideoFrame(captureFrame());
+}
+
 void AbstractImageGrabber::setGrabbedFrameCount(int count)
 {
     QMutexLocker locker(&m_grabbedFrameCountMutex);
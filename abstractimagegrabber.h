@@ -20,6 +20,7 @@
 #define ABSTRACTIMAGEGRABBER_H
 
 #include "abstractgrabber.h"
+#include "encoder/videoframe.h"
 #include <QImage>
 #include <QMutex>
 #include <QFuture>
@@ -31,7 +32,8 @@ class Recorder;
 /*!
   The class defines the functions for the functionality shared by image grabbers. By inheriting this class, you can create custom grabbers that grab images from any devices.
 
-  AbstractImageGrabber will emit frameAvailable() whenever a new frame will be available.
+  AbstractImageGrabber will emit videoFrameAvailable() whenever a new frame will be available. The frameAvailable() signal
+  carries the same frame as a QImage, it is only emitted if something is connected to it.
 */
 class AbstractImageGrabber : public AbstractGrabber
 {
@@ -118,6 +120,13 @@ Q_SIGNALS:
     */
     void frameAvailable(const QImage &frame, int pts);
 
+    /*!
+      This signal is emitted when a new frame was captured from a device. The frame keeps the pixel format of the device.
+      \param frame a frame grabbed from a device.
+      \param pts presentation time stamp.
+    */
+    void videoFrameAvailable(const VideoFrame &frame, int pts);
+
     /*!
       This signal is emitted immediately after the latency value has been changed.
     */
@@ -148,6 +157,12 @@ protected:
     /*! Implement this function to get a frame from a device. */
     virtual QImage captureFrame() = 0;
 
+    /*!
+      Reimplement this function to get a frame from a device in its native pixel format.
+      The default implementation wraps captureFrame().
+    */
+    virtual VideoFrame captureVideoFrame();
+
     /*! Sets count of grabbed frames. */
     void setGrabbedFrameCount(int count);
 
@@ -0,0 +1,59 @@
+/****************************************************************************
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License as published by the Free Software Foundation; either
+** version 2.1 of the License, or (at your option) any later version.
+**
+** This library is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public
+** License along with this library; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**
+****************************************************************************/
+#include "audiobackend.h"
+
+#include "loopbackaudiobackend.h"
+#include "rtaudiobackend.h"
+
+AudioBackend::AudioBackend()
+{
+}
+
+AudioBackend::~AudioBackend()
+{
+}
+
+AudioBackend *AudioBackend::create(AudioBackend::Api api)
+{
+    if (api == AudioBackend::LoopbackApi)
+        return new LoopbackAudioBackend();
+
+    if (!availableApis().contains(api))
+        return NULL;
+
+    return new RtAudioBackend(api);
+}
+
+QList<AudioBackend::Api> AudioBackend::availableApis()
+{
+    QList<AudioBackend::Api> apis = RtAudioBackend::compiledApis();
+    apis.prepend(AudioBackend::DefaultApi);
+    apis.append(AudioBackend::LoopbackApi);
+
+    return apis;
+}
+
+QString AudioBackend::errorString() const
+{
+    return m_errorString;
+}
+
+void AudioBackend::setErrorString(const QString &errorString)
+{
+    m_errorString = errorString;
+}
@@ -0,0 +1,113 @@
+/****************************************************************************
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License as published by the Free Software Foundation; either
+** version 2.1 of the License, or (at your option) any later version.
+**
+** This library is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public
+** License along with this library; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**
+****************************************************************************/
+#ifndef AUDIOBACKEND_H
+#define AUDIOBACKEND_H
+
+#include <audioformat.h>
+
+#include <QHash>
+#include <QList>
+#include <QString>
+
+/*!
+  Prototype of the function exchanging audio with a stream, it matches the RtAudio callback.
+  For capture streams \a outputBuffer is NULL, for playback streams \a inputBuffer is NULL.
+  It is called from the audio thread of the backend.
+*/
+typedef int (*AudioBackendCallback)(void *outputBuffer, void *inputBuffer, unsigned int frameCount,
+                                    double streamTime, unsigned int status, void *userData);
+
+//! The AudioBackend class is the interface to a sound system.
+/*!
+  AudioGrabber and AudioPlayer open their streams through a backend, so the same code runs against ALSA, PulseAudio,
+  DirectSound or the in-process LoopbackAudioBackend, which needs no sound hardware at all.
+  A backend holds at most one stream.
+
+  Here is an example of the AudioBackend usage:
+  @code
+  AudioBackend *backend = AudioBackend::create(AudioBackend::PulseAudioApi);
+  if (backend->openStream(backend->defaultInputDevice(), AudioBackend::CaptureStream, format, &bufferFrames, &callback, this))
+      backend->startStream();
+  @endcode
+*/
+class AudioBackend
+{
+public:
+    /*! This enum describes the sound systems. */
+    enum Api {
+        DefaultApi = 0, /*!< The first sound system compiled in and working on this machine. */
+        AlsaApi, /*!< The Advanced Linux Sound Architecture. */
+        PulseAudioApi, /*!< The PulseAudio sound server. */
+        DirectSoundApi, /*!< Microsoft DirectSound. */
+        LoopbackApi /*!< An in-process virtual device, see LoopbackAudioBackend. */
+    };
+
+    /*! This enum describes the direction of a stream. */
+    enum StreamDirection {
+        CaptureStream = 0,
+        PlaybackStream
+    };
+
+    virtual ~AudioBackend();
+
+    /*! Creates a backend for \a api, the caller takes ownership. Returns NULL if \a api is not compiled in. */
+    static AudioBackend *create(AudioBackend::Api api);
+    /*! Returns the sound systems compiled in, LoopbackApi is always available. */
+    static QList<AudioBackend::Api> availableApis();
+
+    virtual AudioBackend::Api api() const = 0;
+
+    /*! Returns the devices with input channels by their index. */
+    virtual QHash<int, QString> inputDevices() = 0;
+    /*! Returns the devices with output channels by their index. */
+    virtual QHash<int, QString> outputDevices() = 0;
+    virtual int defaultInputDevice() = 0;
+    virtual int defaultOutputDevice() = 0;
+
+    /*!
+      Opens a stream on \a deviceIndex. \a bufferFrames is the requested count of frames per callback and receives
+      the count chosen by the backend. Returns false and sets errorString() if the stream can not be opened.
+    */
+    virtual bool openStream(int deviceIndex, AudioBackend::StreamDirection direction, const AudioFormat &format,
+                            unsigned int *bufferFrames, AudioBackendCallback callback, void *userData) = 0;
+    virtual void closeStream() = 0;
+    virtual bool isStreamOpen() const = 0;
+
+    virtual bool startStream() = 0;
+    virtual void stopStream() = 0;
+    virtual bool isStreamRunning() const = 0;
+
+    /*! Returns the seconds of audio processed since the stream was opened. */
+    virtual double streamTime() = 0;
+    virtual void setStreamTime(double time) = 0;
+
+    /*! Returns a description of the last error. */
+    QString errorString() const;
+
+protected:
+    AudioBackend();
+
+    void setErrorString(const QString &errorString);
+
+private:
+    Q_DISABLE_COPY(AudioBackend)
+
+    QString m_errorString;
+};
+
+#endif // AUDIOBACKEND_H
@@ -58,3 +58,26 @@ int AudioFormat::channelCount() const
 {
     return m_channelCount;
 }
+
+int AudioFormat::bytesPerSample() const
+{
+    switch (m_format) {
+    case AudioFormat::SignedInt8:
+        return 1;
+
+    case AudioFormat::SignedInt16:
+        return 2;
+
+    case AudioFormat::SignedInt24:
+        return 3;
+
+    case AudioFormat::SignedInt32:
+    case AudioFormat::Float32:
+        return 4;
+
+    case AudioFormat::Float64:
+        return 8;
+    }
+
+    return 0;
+}
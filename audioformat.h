@@ -42,6 +42,9 @@ public:
     void setChannelCount(int count);
     int channelCount() const;
 
+    /*! Returns the size of one sample of one channel in bytes. */
+    int bytesPerSample() const;
+
 private:
     int m_sampleRate;
     AudioFormat::Format m_format;
@@ -17,23 +17,54 @@
 ****************************************************************************/
 
 #include "audiograbber.h"
-#include "3rdparty/RtAudio/RtAudio.h"
+
+#include <QThread>
+
+#define CAPTURE_BUFFER_FRAMES 2048
+#define CAPTURE_RING_BUFFER_MSECS 2000
+#define CAPTURE_BATCH_MSECS 20
+#define CAPTURE_POLL_INTERVAL 5
+
+class AudioCaptureThread : public QThread
+{
+public:
+    explicit AudioCaptureThread(AudioGrabber *grabber)
+        : m_grabber(grabber)
+    {
+    }
+
+protected:
+    void run()
+    {
+        m_grabber->consume();
+    }
+
+private:
+    AudioGrabber *m_grabber;
+};
 
 int handleData(void *outputBuffer, void *inputBuffer, unsigned int nBufferFrames,
-               double streamTime, RtAudioStreamStatus status, void *data)
+               double streamTime, unsigned int status, void *data)
 {
     Q_UNUSED(outputBuffer)
     Q_UNUSED(streamTime)
-    Q_UNUSED(status)
 
     AudioGrabber *grabber = static_cast<AudioGrabber *>(data);
 
-    int bytesReady = nBufferFrames * grabber->format().channelCount() * 2;
-    QByteArray array;
-    array.resize(bytesReady);
-    memcpy(array.data(), inputBuffer, bytesReady);
+    //this runs on the real-time audio thread: no allocation, no locking and no signals, just a copy into the ring
+    int size = nBufferFrames * grabber->m_frameBytes;
 
-    grabber->onDataAvailable(array);
+    if (status != 0)
+        grabber->m_overrunCount.ref();
+
+    //a partial write would break the frame alignment, so the whole buffer is dropped if it does not fit
+    if (grabber->m_ringBuffer.freeSpace() < size) {
+        grabber->m_overrunCount.ref();
+        grabber->m_droppedFrameCount.fetchAndAddRelaxed(nBufferFrames);
+        return 0;
+    }
+
+    grabber->m_ringBuffer.write(static_cast<const char *>(inputBuffer), size);
 
     return 0;
 }
@@ -41,13 +72,50 @@ int handleData(void *outputBuffer, void *inputBuffer, unsigned int nBufferFrames
 AudioGrabber::AudioGrabber(QObject *parent)
     : AbstractGrabber(parent)
     , m_deviceIndex(-1)
+    , m_api(AudioBackend::DefaultApi)
+    , m_backend(AudioBackend::create(AudioBackend::DefaultApi))
+    , m_frameBytes(0)
+    , m_batchBytes(0)
+    , m_consumedFrames(0)
+    , m_accountedDroppedFrames(0)
 {
+    m_captureThread = new AudioCaptureThread(this);
+
     init();
 }
 
 AudioGrabber::~AudioGrabber()
 {
-    cleanup();
+    m_backend->closeStream();
+    stopCaptureThread();
+    delete m_backend;
+    delete m_captureThread;
+}
+
+void AudioGrabber::setApi(AudioBackend::Api api)
+{
+    if (m_api == api || state() != AbstractGrabber::StoppedState)
+        return;
+
+    AudioBackend *backend = AudioBackend::create(api);
+    if (!backend) {
+        setError(AbstractGrabber::InvalidConfigurationError, tr("The audio API is not available."));
+        return;
+    }
+
+    delete m_backend;
+    m_backend = backend;
+    m_api = api;
+}
+
+AudioBackend::Api AudioGrabber::api() const
+{
+    return m_api;
+}
+
+AudioBackend *AudioGrabber::backend() const
+{
+    return m_backend;
 }
 
 
@@ -75,61 +143,45 @@ AudioFormat AudioGrabber::format() const
 
 int AudioGrabber::grabbedAudioDataSize() const
 {
-    return m_grabbedAudioDataSize;
+    return m_grabbedAudioDataSize.load();
+}
+
+int AudioGrabber::overrunCount() const
+{
+    return m_overrunCount.load();
 }
 
 int AudioGrabber::elapsedMilliseconds() const
 { 
-    if (!m_rtAudio || state() == AudioGrabber::StoppedState)
+    if (state() == AudioGrabber::StoppedState)
         return 0;
 
-    return m_rtAudio->getStreamTime() * 1000;
+    return m_backend->streamTime() * 1000;
 }
 
 QHash<int, QString> AudioGrabber::availableDevices()
 {
-    RtAudio rtAudio;
-    int deviceCount = rtAudio.getDeviceCount();
-    RtAudio::DeviceInfo info;
-    QHash<int, QString> devices;
-
-    for (int i = 0; i < deviceCount; ++i) {
-        info = rtAudio.getDeviceInfo(i);
-
-        if (info.inputChannels > 0) {
-            devices.insert(i, QString::fromStdString(info.name));
-        }
-    }
+    AudioBackend *backend = AudioBackend::create(AudioBackend::DefaultApi);
+    QHash<int, QString> devices = backend->inputDevices();
+    delete backend;
 
     return devices;
 }
 
 int AudioGrabber::defaultAudioDeviceIndex() const
 {
-    RtAudio rtAudio;
-    return rtAudio.getDefaultInputDevice();
+    return m_backend->defaultInputDevice();
 }
 
 QString AudioGrabber::deviceNameByIndex(int index)
 {
-    RtAudio rtAudio;
-    if (index < 0 || index > rtAudio.getDeviceCount())
-        return QString();
-
-    return QString::fromStdString(rtAudio.getDeviceInfo(index).name);
+    return m_backend->inputDevices().value(index);
 }
 
 QVariant AudioGrabber::deviceListIndex() const
 {
-    RtAudio rtAudio;
-    int deviceCount = rtAudio.getDeviceCount();
-    QList<int> list;
-
-    for (int i = 0; i < deviceCount; ++i) {
-        if (rtAudio.getDeviceInfo(i).inputChannels > 0) {
-            list.append(i);
-        }
-    }
+    QList<int> list = m_backend->inputDevices().keys();
+    qSort(list);
 
     return QVariant::fromValue(list);
 }
@@ -137,28 +189,31 @@ QVariant AudioGrabber::deviceListIndex() const
 bool AudioGrabber::start()
 {
     if (state() == AbstractGrabber::StoppedState) {
-        if (deviceIndex() < 0 || deviceIndex() > availableDevices().count()) {
+        if (!m_backend->inputDevices().contains(deviceIndex())) {
             setError(AbstractGrabber::DeviceNotFoundError, tr("Device to be grabbed was not found."));
             return false;
         }
 
-        #ifdef Q_OS_WIN32
-            m_rtAudio = new RtAudio();
-        #endif
+        unsigned int bufferFrames = CAPTURE_BUFFER_FRAMES;
 
-        unsigned int bufferFrames = 2048;
-        RtAudio::StreamParameters params;
-        params.deviceId = deviceIndex();
-        params.nChannels = format().channelCount();
-        params.firstChannel = 0;
-
-        try {
-            m_rtAudio->openStream(NULL, &params, format().format(), format().sampleRate(), &bufferFrames, &handleData, this);
-            m_rtAudio->startStream();
+        if (!m_backend->openStream(deviceIndex(), AudioBackend::CaptureStream, format(), &bufferFrames, &handleData, this)) {
+            setError(AbstractGrabber::DeviceOpenError, "Unable to open device. Error " + m_backend->errorString());
+            return false;
         }
-        catch (RtAudioError& e) {
-            setError(AbstractGrabber::DeviceOpenError, "Unable to open device. Error " +
-                     QString::fromStdString(e.getMessage()));
+
+        //everything the callback touches is allocated before the stream starts
+        m_frameBytes = format().channelCount() * format().bytesPerSample();
+        int bytesPerMillisecond = format().sampleRate() * m_frameBytes / 1000;
+        m_batchBytes = qMax<int>(bufferFrames * m_frameBytes, CAPTURE_BATCH_MSECS * bytesPerMillisecond);
+        m_batchBytes -= m_batchBytes % m_frameBytes;
+        m_ringBuffer.setCapacity(qMax(CAPTURE_RING_BUFFER_MSECS * bytesPerMillisecond, 4 * m_batchBytes));
+
+        m_captureThread->start();
+
+        if (!m_backend->startStream()) {
+            m_backend->closeStream();
+            stopCaptureThread();
+            setError(AbstractGrabber::DeviceOpenError, "Unable to open device. Error " + m_backend->errorString());
             return false;
         }
 
@@ -173,7 +228,8 @@ bool AudioGrabber::start()
 void AudioGrabber::stop()
 {
     if (state() != AbstractGrabber::StoppedState) {
-        m_rtAudio->closeStream();
+        m_backend->closeStream();
+        stopCaptureThread();
         cleanup();
 
         setState(AbstractGrabber::StoppedState);
@@ -183,7 +239,7 @@ void AudioGrabber::stop()
 void AudioGrabber::suspend()
 {
     if (state() == AbstractGrabber::ActiveState) {
-        m_rtAudio->stopStream();
+        m_backend->stopStream();
 
         setState(AbstractGrabber::SuspendedState);
     }
@@ -192,7 +248,7 @@ void AudioGrabber::suspend()
 void AudioGrabber::resume()
 {
     if (state() == AbstractGrabber::SuspendedState) {
-        m_rtAudio->startStream();
+        m_backend->startStream();
 
         setState(AbstractGrabber::ActiveState);
     }
@@ -200,23 +256,64 @@ void AudioGrabber::resume()
 
 void AudioGrabber::init()
 {
-    m_grabbedAudioDataSize = 0;
-    m_rtAudio = 0;
+    m_grabbedAudioDataSize.store(0);
+    m_overrunCount.store(0);
+    m_droppedFrameCount.store(0);
+    m_accountedDroppedFrames = 0;
+    m_consumedFrames = 0;
 }
 
 void AudioGrabber::cleanup()
 {
-    if (m_rtAudio)
-        delete m_rtAudio;
-
     init();
 }
 
-void AudioGrabber::onDataAvailable(const QByteArray &data)
+void AudioGrabber::stopCaptureThread()
+{
+    m_captureThread->requestInterruption();
+    m_captureThread->wait();
+}
+
+void AudioGrabber::consume()
+{
+    while (!m_captureThread->isInterruptionRequested()) {
+        drain(false);
+        QThread::msleep(CAPTURE_POLL_INTERVAL);
+    }
+
+    //the stream is closed, the rest is delivered as it is
+    drain(true);
+}
+
+void AudioGrabber::drain(bool flush)
+{
+    int available = m_ringBuffer.bytesAvailable();
+
+    while (available >= m_batchBytes || (flush && available >= m_frameBytes)) {
+        int size = qMin(available, m_batchBytes);
+        size -= size % m_frameBytes;
+
+        //frames dropped by the callback leave a gap in the timeline
+        int droppedFrames = m_droppedFrameCount.load();
+        m_consumedFrames += droppedFrames - m_accountedDroppedFrames;
+        m_accountedDroppedFrames = droppedFrames;
+
+        QByteArray data(size, Qt::Uninitialized);
+        m_ringBuffer.read(data.data(), size);
+
+        int pts = static_cast<int>(m_consumedFrames * 1000 / format().sampleRate());
+        m_consumedFrames += size / m_frameBytes;
+        available -= size;
+
+        onDataAvailable(data, pts);
+    }
+}
+
+void AudioGrabber::onDataAvailable(const QByteArray &data, int pts)
 {
     if (data.size() > 0) {
-        m_grabbedAudioDataSize += data.size();
+        m_grabbedAudioDataSize.fetchAndAddRelaxed(data.size());
 
-        Q_EMIT dataAvailable(data, this->elapsedMilliseconds());
+        Q_EMIT dataAvailable(data, pts);
     }
 }
@@ -21,16 +21,17 @@
 
 #include "abstractgrabber.h"
 #include <audioformat.h>
+#include <audiobackend.h>
+#include "helpers/ringbuffer.h"
 #include <QHash>
 #include <QVariant>
+#include <QAtomicInt>
 
 class QAudioInput;
-class RtAudio;
-
-typedef unsigned int RtAudioStreamStatus;
+class AudioCaptureThread;
 
 int handleData(void *outputBuffer, void *inputBuffer, unsigned int nBufferFrames,
-               double streamTime, RtAudioStreamStatus status, void *data);
+               double streamTime, unsigned int status, void *data);
 
 //! The AudioGrabber class allows the application to capture data from audio input devices.
 /*!
@@ -39,7 +40,12 @@ int handleData(void *outputBuffer, void *inputBuffer, unsigned int nBufferFrames
   Also you can adjust the quality of audio by passing AudioFormat object to the setFormat() function. During the process of capture you can call the grabbedAudioDataSize()
   function that returns the size of grabbed audio data.
 
-  The signal dataAvailable() is emmited whenever a new data chunk is available.
+  The devices belong to the sound system selected by setApi(). AudioBackend::LoopbackApi captures a generated
+  signal without any sound hardware, see LoopbackAudioBackend.
+
+  The signal dataAvailable() is emmited whenever a new data chunk is available. The audio callback only copies samples
+  into a preallocated ring buffer, a capture thread emits them in chunks of at least 20 milliseconds, so the signal is
+  emmited from that thread.
 
   Here is an example of AudioGrabber usage:
   @code
@@ -59,12 +65,24 @@ class AudioGrabber : public AbstractGrabber
     Q_OBJECT
 
     friend int handleData(void *outputBuffer, void *inputBuffer, unsigned int nBufferFrames,
-                          double streamTime, RtAudioStreamStatus status, void *data);
+                          double streamTime, unsigned int status, void *data);
+    friend class AudioCaptureThread;
 
 public:
     explicit AudioGrabber(QObject *parent = 0);
     virtual ~AudioGrabber();
 
+    /*!
+      Selects the sound system, it takes effect only while the grabber is stopped.
+      The default value is AudioBackend::DefaultApi.
+      \sa AudioBackend::availableApis()
+    */
+    void setApi(AudioBackend::Api api);
+    AudioBackend::Api api() const;
+
+    /*! Returns the backend of the selected sound system, e.g. to configure a LoopbackAudioBackend. */
+    AudioBackend *backend() const;
+
     /*!
       Lets AudioGrabber know which device it must grab.
       \sa deviceIndex()
@@ -101,6 +119,12 @@ public:
     */
     int elapsedMilliseconds() const;
 
+    /*!
+      Returns how many times captured audio was lost since start, because the device overran
+      or the ring buffer was full. Lost frames leave a gap in the pts of dataAvailable().
+    */
+    int overrunCount() const;
+
     /*!
       Returns available audio input devices.
       Return value consists of <b>deviceId</b> and <b>deviceName</b> parameters.
@@ -121,18 +145,32 @@ public Q_SLOTS:
 Q_SIGNALS:
     /*!
       This signal is emmited whenever a new data chunk is available.
+      \a pts is the position of the chunk in the captured stream in milliseconds.
     */
     void dataAvailable(const QByteArray &data, int pts);
 
 private:
     void init();
     void cleanup();
-    void onDataAvailable(const QByteArray &data);
+    void stopCaptureThread();
+    void consume();
+    void drain(bool flush);
+    void onDataAvailable(const QByteArray &data, int pts);
 
     AudioFormat m_format;
     int m_deviceIndex;
-    int m_grabbedAudioDataSize;
-    RtAudio *m_rtAudio;
+    QAtomicInt m_grabbedAudioDataSize;
+    AudioBackend::Api m_api;
+    AudioBackend *m_backend;
+
+    RingBuffer m_ringBuffer;
+    int m_frameBytes;
+    int m_batchBytes;
+    QAtomicInt m_overrunCount;
+    QAtomicInt m_droppedFrameCount;
+    qint64 m_consumedFrames;
+    int m_accountedDroppedFrames;
+    AudioCaptureThread *m_captureThread;
 };
 
 #endif // AUDIOGRABBER_H
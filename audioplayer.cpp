@@ -17,49 +17,67 @@
 ****************************************************************************/
 
 #include "audioplayer.h"
-#include "3rdparty/RtAudio/RtAudio.h"
 
-#include <QDebug>
-#include <QMutexLocker>
-
-int pos = 0;
+#define PLAYBACK_BUFFER_FRAMES 2304
+#define JITTER_BUFFER_CAPACITY 4000
 
 int dataCallback(void *outputBuffer, void *inputBuffer, unsigned int nBufferFrames,
-                 double streamTime, RtAudioStreamStatus status, void *data)
+                 double streamTime, unsigned int status, void *data)
 {
-    Q_UNUSED(outputBuffer)
+    Q_UNUSED(inputBuffer)
     Q_UNUSED(streamTime)
     Q_UNUSED(status)
 
-    if (status) {
-        qDebug() << "Stream audio overflow/underlow";
-        return 0;
-    }
-
     AudioPlayer *player = static_cast<AudioPlayer *>(data);
 
-    QByteArray array = player->readData( streamTime, nBufferFrames * 2 );
-    if (array.isEmpty()) {
-        return 0;
-    }
+    //this runs on the real-time audio thread, the jitter buffer neither locks nor allocates
+    player->m_jitterBuffer.read(static_cast<char *>(outputBuffer), nBufferFrames * player->m_frameBytes);
 
-    memcpy(outputBuffer, array.data(), array.size());
-    return array.size();
+    return 0;
 }
 
 AudioPlayer::AudioPlayer(QObject *parent)
     : AbstractGrabber(parent)
-    , m_rtAudio(0)
     , m_deviceIndex(-1)
+    , m_api(AudioBackend::DefaultApi)
+    , m_backend(AudioBackend::create(AudioBackend::DefaultApi))
+    , m_frameBytes(0)
+    , m_outputLatency(0)
 {
     init();
 }
 
 AudioPlayer::~AudioPlayer()
 {
-    if (this->m_rtAudio)
-        this->m_rtAudio->stopStream();
+    m_backend->closeStream();
     cleanup();
+    delete m_backend;
+}
+
+void AudioPlayer::setApi(AudioBackend::Api api)
+{
+    if (m_api == api || state() != AbstractGrabber::StoppedState)
+        return;
+
+    AudioBackend *backend = AudioBackend::create(api);
+    if (!backend) {
+        setError(AbstractGrabber::InvalidConfigurationError, tr("The audio API is not available."));
+        return;
+    }
+
+    delete m_backend;
+    m_backend = backend;
+    m_api = api;
+}
+
+AudioBackend::Api AudioPlayer::api() const
+{
+    return m_api;
+}
+
+AudioBackend *AudioPlayer::backend() const
+{
+    return m_backend;
 }
 
 
@@ -92,26 +110,17 @@ int AudioPlayer::grabbedAudioDataSize() const
 
 int AudioPlayer::elapsedMilliseconds() const
 { 
-    if (!m_rtAudio || state() == AudioPlayer::StoppedState)
+    if (state() == AudioPlayer::StoppedState)
         return 0;
 
-    return m_rtAudio->getStreamTime() * 1000;
+    return m_backend->streamTime() * 1000;
 }
 
 QHash<int, QString> AudioPlayer::availableDevices()
 {
-    RtAudio rtAudio;
-    int deviceCount = rtAudio.getDeviceCount();
-    RtAudio::DeviceInfo info;
-    QHash<int, QString> devices;
-
-    for (int i = 0; i < deviceCount; ++i) {
-        info = rtAudio.getDeviceInfo(i);
-
-        if (info.outputChannels > 0) {
-            devices.insert(i, QString::fromStdString(info.name));
-        }
-    }
+    AudioBackend *backend = AudioBackend::create(AudioBackend::DefaultApi);
+    QHash<int, QString> devices = backend->outputDevices();
+    delete backend;
 
     return devices;
 }
@@ -121,93 +130,97 @@ void AudioPlayer::writeData(double pts, const QByteArray &newArray)
     if (state() != AbstractGrabber::ActiveState)
         return;
 
-    QMutexLocker locker(&this->_mutex);
-//    qDebug() << "write" << newArray.size() << "size" << this->_audioData.size();
-
-//    if (this->_audioData.size() > newArray.size() * 4) {
-//        //m_rtAudio->stopStream();
-//       // m_rtAudio->setStreamTime( m_rtAudio->getStreamTime() + 1.0f );
-//        //m_rtAudio->startStream();
+    m_jitterBuffer.write(newArray.constData(), newArray.size(), static_cast<qint64>(pts * 1000));
+}
 
-//        //this->_audioData.remove(0, this->_audioData.size() - newArray.size() * 4);
-//    }
+void AudioPlayer::restartTimeline()
+{
+    m_jitterBuffer.restartTimeline();
+}
 
-    this->_audioDataList.append(qMakePair<double, QByteArray>(pts, newArray));
+void AudioPlayer::setTargetDelay(int msecs)
+{
+    m_jitterBuffer.setTargetDelay(msecs);
+}
 
-//    this->_audioData += newArray;
+int AudioPlayer::targetDelay() const
+{
+    return m_jitterBuffer.targetDelay();
 }
 
+void AudioPlayer::setMaximumDelay(int msecs)
+{
+    m_jitterBuffer.setMaximumDelay(msecs);
+}
 
-QByteArray AudioPlayer::readData(double pts, int num)
+int AudioPlayer::maximumDelay() const
 {
-    QMutexLocker locker(&this->_mutex);
+    return m_jitterBuffer.maximumDelay();
+}
 
-    QByteArray ret;
+int AudioPlayer::playoutDelay() const
+{
+    return m_jitterBuffer.playoutDelay();
+}
 
-    double delay = 0.2;
+qint64 AudioPlayer::playbackPosition() const
+{
+    qint64 position = m_jitterBuffer.playbackPosition();
+    if (position < 0)
+        return -1;
 
-    while (!this->_audioDataList.isEmpty()) {
-        QPair<double, QByteArray> value = this->_audioDataList.takeFirst();
+    //the samples read last are still in the device buffer
+    return qMax<qint64>(position - m_outputLatency, 0);
+}
 
-        if (value.first < pts - delay) {
-            continue;
-        }
+int AudioPlayer::bufferedDuration() const
+{
+    return m_jitterBuffer.bufferedDuration();
+}
 
-        ret += value.second;
-        if (ret.size() >= num)
-            break;
-    }
+int AudioPlayer::underrunCount() const
+{
+    return m_jitterBuffer.underrunCount();
+}
 
-    if (ret.isEmpty()) {
-        ret.fill('\0', num);
-    }
-    return ret;
+int AudioPlayer::droppedDuration() const
+{
+    return m_jitterBuffer.droppedDuration();
 }
 
-QByteArray AudioPlayer::readAll()
+int AudioPlayer::jitter() const
 {
-    QMutexLocker locker(&this->_mutex);
-    if (this->_audioData.isEmpty())
-        return QByteArray();
+    return m_jitterBuffer.jitter();
+}
 
-    QByteArray ret;
-    ret.resize(this->_audioData.size());
-    memcpy(ret.data(), this->_audioData.data(), this->_audioData.size());
-    this->_audioData.clear();
-    return ret;
+int AudioPlayer::clockDrift() const
+{
+    return m_jitterBuffer.clockDrift();
 }
 
 bool AudioPlayer::start()
 {
     if (state() == AbstractGrabber::StoppedState) {
-        if (deviceIndex() < 0 || deviceIndex() > availableDevices().count()) {
+        if (!m_backend->outputDevices().contains(deviceIndex())) {
             setError(AbstractGrabber::DeviceNotFoundError, tr("Device to be players was not found."));
             return false;
         }
 
-        m_rtAudio = new RtAudio();
-
-        RtAudio::StreamParameters params;
-        RtAudio::StreamOptions options;
-        //options.flags = RTAUDIO_SCHEDULE_REALTIME | RTAUDIO_MINIMIZE_LATENCY;
-        //options.numberOfBuffers = 1;
-        //options.priority = 8;
+        //the buffer is allocated before the callback can use it
+        m_frameBytes = format().channelCount() * format().bytesPerSample();
+        m_jitterBuffer.setFormat(format(), JITTER_BUFFER_CAPACITY);
 
-        unsigned int bufferFrames = 2304;
+        unsigned int bufferFrames = PLAYBACK_BUFFER_FRAMES;
 
-        params.deviceId = deviceIndex();
-        params.nChannels = format().channelCount();
-        params.firstChannel = 0;
-
-        try {
-            m_rtAudio->openStream(&params, NULL, format().format(), format().sampleRate(), &bufferFrames, &dataCallback, this, &options);
-            m_rtAudio->startStream();
-        } catch (RtAudioError& e) {
-            setError(AbstractGrabber::DeviceOpenError, "Unable to open device. Error " +
-                     QString::fromStdString(e.getMessage()));
+        if (!m_backend->openStream(deviceIndex(), AudioBackend::PlaybackStream, format(), &bufferFrames, &dataCallback, this)
+                || !m_backend->startStream()) {
+            m_backend->closeStream();
+            setError(AbstractGrabber::DeviceOpenError, "Unable to open device. Error " + m_backend->errorString());
             return false;
         }
 
+        m_outputLatency = static_cast<int>(static_cast<qint64>(bufferFrames) * 1000 / format().sampleRate());
+
         setState(AbstractGrabber::ActiveState);
 
         return true;
@@ -219,8 +232,8 @@ bool AudioPlayer::start()
 void AudioPlayer::stop()
 {
     if (state() != AbstractGrabber::StoppedState) {
-        m_rtAudio->closeStream();
-        this->_audioData.clear();
+        m_backend->closeStream();
+        m_jitterBuffer.clear();
         cleanup();
 
         setState(AbstractGrabber::StoppedState);
@@ -230,7 +243,7 @@ void AudioPlayer::stop()
 void AudioPlayer::suspend()
 {
     if (state() == AbstractGrabber::ActiveState) {
-        m_rtAudio->stopStream();
+        m_backend->stopStream();
 
         setState(AbstractGrabber::SuspendedState);
     }
@@ -239,7 +252,7 @@ void AudioPlayer::suspend()
 void AudioPlayer::resume()
 {
     if (state() == AbstractGrabber::SuspendedState) {
-        m_rtAudio->startStream();
+        m_backend->startStream();
 
         setState(AbstractGrabber::ActiveState);
     }
@@ -248,29 +261,24 @@ void AudioPlayer::resume()
 void AudioPlayer::init()
 {
     m_grabbedAudioDataSize = 0;
-    m_rtAudio = 0;
 }
 
 void AudioPlayer::cleanup()
 {
-    if (m_rtAudio)
-        delete m_rtAudio;
-
     init();
 }
 
 int AudioPlayer::defaultAudioDeviceIndex() const
 {
-    RtAudio rtAudio;
-    return rtAudio.getDefaultOutputDevice();
+    return m_backend->defaultOutputDevice();
 }
 
 void AudioPlayer::setStreamTime(double time)
 {
-    m_rtAudio->setStreamTime(time);
+    m_backend->setStreamTime(time);
 }
 
 double AudioPlayer::getStreamTime()
 {
-    return m_rtAudio->getStreamTime();
+    return m_backend->streamTime();
 }
@@ -21,18 +21,13 @@
 
 #include "abstractgrabber.h"
 #include <audioformat.h>
+#include <audiobackend.h>
+#include "helpers/jitterbuffer.h"
 
 #include <QHash>
-#include <QQueue>
 #include <QByteArray>
-#include <QList>
-#include <QVector>
-#include <QMutex>
 
 class QAudioInput;
-class RtAudio;
-
-typedef unsigned int RtAudioStreamStatus;
 
 //! The AudioGrabber class allows the application to capture data from audio input devices.
 /*!
@@ -60,13 +55,24 @@ class AudioPlayer : public AbstractGrabber
 {
     Q_OBJECT
 
-    friend int handleData(void *outputBuffer, void *inputBuffer, unsigned int nBufferFrames,
-                          double streamTime, RtAudioStreamStatus status, void *data);
+    friend int dataCallback(void *outputBuffer, void *inputBuffer, unsigned int nBufferFrames,
+                            double streamTime, unsigned int status, void *data);
 
 public:
     explicit AudioPlayer(QObject *parent = 0);
     virtual ~AudioPlayer();
 
+    /*!
+      Selects the sound system, it takes effect only while the player is stopped.
+      The default value is AudioBackend::DefaultApi.
+      \sa AudioBackend::availableApis()
+    */
+    void setApi(AudioBackend::Api api);
+    AudioBackend::Api api() const;
+
+    /*! Returns the backend of the selected sound system, e.g. to read the output of a LoopbackAudioBackend. */
+    AudioBackend *backend() const;
+
     /*!
       Lets AudioPlayer know which device it must playback.
       \sa deviceIndex()
@@ -109,9 +115,48 @@ public:
     */
     static QHash<int /*id*/, QString /*name*/> availableDevices();
 
+    /*!
+      Queues samples in format() for playback, \a pts is the time of the first sample in seconds.
+      Samples pass a JitterBuffer, so they may arrive with gaps, overlaps and irregular timing.
+    */
     void writeData(double pts, const QByteArray& newArray);
-    QByteArray readData(double pts, int num);
-    QByteArray readAll();
+
+    /*!
+      Lets the next writeData() start a new timeline, e.g. when the samples come from another stream.
+      \sa JitterBuffer::restartTimeline()
+    */
+    void restartTimeline();
+
+    /*!
+      Sets the lowest playout delay in milliseconds. The default value is 200.
+      The playout delay grows with the network jitter up to maximumDelay(), see JitterBuffer.
+    */
+    void setTargetDelay(int msecs);
+    int targetDelay() const;
+
+    /*! Sets the highest playout delay in milliseconds. The default value is 1000. */
+    void setMaximumDelay(int msecs);
+    int maximumDelay() const;
+
+    /*! Returns the current playout delay in milliseconds. */
+    int playoutDelay() const;
+
+    /*!
+      Returns the pts of the samples heard now in milliseconds, -1 before the first writeData().
+      It is the clock video is synchronized to.
+    */
+    qint64 playbackPosition() const;
+
+    /*! Returns the duration of samples waiting for playback in milliseconds. */
+    int bufferedDuration() const;
+    /*! Returns how many times playback ran out of samples since start. */
+    int underrunCount() const;
+    /*! Returns the duration of samples dropped because they arrived too late, in milliseconds. */
+    int droppedDuration() const;
+    /*! Returns the estimated network jitter in milliseconds. */
+    int jitter() const;
+    /*! Returns the estimated drift of the sender clock against the sound card in parts per million. */
+    int clockDrift() const;
 
     int defaultAudioDeviceIndex() const;
 
@@ -131,11 +176,11 @@ private:
     AudioFormat m_format;
     int m_deviceIndex;
     int m_grabbedAudioDataSize;
-    RtAudio *m_rtAudio;
-    QMutex _mutex;
-    QByteArray _audioData;
-
-    QList<QPair<double, QByteArray> > _audioDataList;
+    AudioBackend::Api m_api;
+    AudioBackend *m_backend;
+    int m_frameBytes;
+    int m_outputLatency;
+    JitterBuffer m_jitterBuffer;
 };
 
 #endif // AUDIOPLAYER_H
@@ -0,0 +1,314 @@
+/****************************************************************************
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License as published by the Free Software Foundation; either
+** version 2.1 of the License, or (at your option) any later version.
+**
+** This library is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public
+** License along with this library; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**
+****************************************************************************/
+#include "benchmark.h"
+
+#include "streamer.h"
+#include "audiograbber.h"
+#include "fileimagegrabber.h"
+#include "patternimagegrabber.h"
+
+#include <QProcess>
+#include <QStringList>
+#include <QTextStream>
+#include <QTimer>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#define AUDIO_SAMPLE_RATE 44100
+#define AUDIO_BITRATE 128000
+
+//returns user and system time used by all threads of the process, in microseconds
+static qint64 processCpuTime()
+{
+#ifdef Q_OS_WIN
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime))
+        return 0;
+
+    ULARGE_INTEGER kernel, user;
+    kernel.LowPart = kernelTime.dwLowDateTime;
+    kernel.HighPart = kernelTime.dwHighDateTime;
+    user.LowPart = userTime.dwLowDateTime;
+    user.HighPart = userTime.dwHighDateTime;
+
+    //FILETIME counts 100 ns intervals
+    return static_cast<qint64>((kernel.QuadPart + user.QuadPart) / 10);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+
+    return static_cast<qint64>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000
+            + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+#endif
+}
+
+Benchmark::Benchmark(QObject *parent)
+    : QObject(parent)
+    , m_streamer(new Streamer(this))
+    , m_grabber(0)
+    , m_audioGrabber(0)
+    , m_frameSize(1280, 720)
+    , m_frameRate(30)
+    , m_duration(10)
+    , m_videoCodec(EncoderGlobal::H264)
+    , m_videoBitrate(2000000)
+    , m_audioEnabled(true)
+    , m_outputPath(QProcess::nullDevice())
+    , m_outputFormat(Encoder::AutoFormat)
+    , m_minimumFrameRate(0)
+    , m_startCpuTime(0)
+    , m_wallTime(0)
+    , m_cpuTime(0)
+    , m_failed(false)
+{
+    Encoder *encoder = m_streamer->encoder();
+
+    connect(encoder, SIGNAL(started()), this, SLOT(onEncoderStarted()));
+    connect(encoder, SIGNAL(stopped()), this, SLOT(onEncoderStopped()));
+    connect(encoder, SIGNAL(error(Encoder::Error)), this, SLOT(onEncoderError()));
+    connect(encoder, SIGNAL(statisticsUpdated(QVariantMap)), this, SLOT(printProgress(QVariantMap)));
+}
+
+Benchmark::~Benchmark()
+{
+}
+
+void Benchmark::setFrameSize(const QSize &size)
+{
+    m_frameSize = size;
+}
+
+void Benchmark::setFrameRate(int frameRate)
+{
+    m_frameRate = qMax(frameRate, 1);
+}
+
+void Benchmark::setDuration(int seconds)
+{
+    m_duration = seconds;
+}
+
+void Benchmark::setVideoCodec(EncoderGlobal::VideoCodec codec)
+{
+    m_videoCodec = codec;
+}
+
+void Benchmark::setVideoBitrate(int bitrate)
+{
+    m_videoBitrate = bitrate;
+}
+
+void Benchmark::setAudioEnabled(bool enabled)
+{
+    m_audioEnabled = enabled;
+}
+
+void Benchmark::setInputFileName(const QString &fileName)
+{
+    m_inputFileName = fileName;
+}
+
+void Benchmark::setOutputPath(const QString &path)
+{
+    m_outputPath = path;
+}
+
+void Benchmark::setOutputFormat(Encoder::OutputFormat format)
+{
+    m_outputFormat = format;
+}
+
+void Benchmark::addRendition(const QSize &size, int bitrate)
+{
+    m_renditionSizes.append(size);
+    m_renditionBitrates.append(bitrate);
+}
+
+void Benchmark::setRecordingPath(const QString &path)
+{
+    m_recordingPath = path;
+}
+
+void Benchmark::setMinimumFrameRate(double frameRate)
+{
+    m_minimumFrameRate = frameRate;
+}
+
+void Benchmark::start()
+{
+    Encoder *encoder = m_streamer->encoder();
+
+    VideoCodecSettings videoSettings;
+    videoSettings.setBitrate(m_videoBitrate);
+    videoSettings.setGopSize(m_frameRate * 2);
+
+    //the encoder converts the interleaved 16 bit samples of the grabber into the planar codec format
+    AudioCodecSettings audioSettings;
+    audioSettings.setSampleRate(AUDIO_SAMPLE_RATE);
+    audioSettings.setChannelCount(1);
+    audioSettings.setSampleFormat(EncoderGlobal::SAMPLE_FMT_S16P);
+    audioSettings.setBitrate(AUDIO_BITRATE);
+
+    encoder->setFilePath(m_outputPath);
+    encoder->setOutputFormat(m_outputFormat);
+    encoder->setRecordingPath(m_recordingPath);
+
+    encoder->clearRenditions();
+    for (int i = 0; i < m_renditionSizes.size(); ++i)
+        encoder->addRendition(m_renditionSizes.at(i), m_renditionBitrates.at(i), QProcess::nullDevice(), m_outputFormat);
+
+    encoder->setVideoSize(m_frameSize);
+    encoder->setFixedFrameRate(m_frameRate);
+    encoder->setOutputPixelFormat(EncoderGlobal::YUV420P);
+    encoder->setVideoCodec(m_videoCodec);
+    encoder->setVideoCodecSettings(videoSettings);
+    encoder->setAudioCodec(EncoderGlobal::MP3);
+    encoder->setAudioCodecSettings(audioSettings);
+    encoder->setEncodingMode(m_audioEnabled ? Encoder::VideoAudioMode : Encoder::VideoMode);
+
+    //a sine tone is captured from the loopback device through the same path as from a sound card
+    if (m_audioEnabled) {
+        AudioFormat format;
+        format.setSampleRate(AUDIO_SAMPLE_RATE);
+        format.setChannelCount(1);
+        format.setFormat(AudioFormat::SignedInt16);
+
+        m_audioGrabber = new AudioGrabber(this);
+        m_audioGrabber->setApi(AudioBackend::LoopbackApi);
+        m_audioGrabber->setDeviceIndex(m_audioGrabber->defaultAudioDeviceIndex());
+        m_audioGrabber->setFormat(format);
+
+        m_streamer->setAudioGrabber(m_audioGrabber);
+    }
+
+    //the encoder scales file frames to the benchmark size
+    if (!m_inputFileName.isEmpty()) {
+        FileImageGrabber *grabber = new FileImageGrabber(this);
+        grabber->setFileName(m_inputFileName);
+        m_grabber = grabber;
+    } else {
+        PatternImageGrabber *grabber = new PatternImageGrabber(this);
+        grabber->setSize(m_frameSize);
+        grabber->setLatency(1000 / m_frameRate);
+        m_grabber = grabber;
+    }
+
+    m_streamer->setImageGrabber(m_grabber);
+
+    QTextStream(stdout) << "Streaming " << (m_inputFileName.isEmpty() ? QString("a test pattern") : m_inputFileName)
+                        << " at " << m_frameSize.width() << "x" << m_frameSize.height() << ", " << m_frameRate
+                        << " fps for " << m_duration << " s to " << m_outputPath << endl;
+
+    m_streamer->start();
+}
+
+void Benchmark::onEncoderStarted()
+{
+    m_wallClock.start();
+    m_startCpuTime = processCpuTime();
+
+    QTimer::singleShot(m_duration * 1000, this, SLOT(stop()));
+}
+
+void Benchmark::stop()
+{
+    m_streamer->stop();
+}
+
+void Benchmark::onEncoderStopped()
+{
+    //the encoder has flushed its queues, everything grabbed is accounted for
+    m_wallTime = m_wallClock.nsecsElapsed() / 1000;
+    m_cpuTime = processCpuTime() - m_startCpuTime;
+
+    printReport();
+}
+
+void Benchmark::onEncoderError()
+{
+    QTextStream(stderr) << "Encoder error: " << m_streamer->encoder()->errorString() << endl;
+
+    m_failed = true;
+    m_streamer->stop();
+
+    Q_EMIT finished(1);
+}
+
+void Benchmark::printProgress(const QVariantMap &statistics)
+{
+    QTextStream(stdout) << "  encoded " << statistics.value("encodedFrameCount").toInt()
+                        << " frames, queue " << statistics.value("videoQueueDepth").toInt()
+                        << ", dropped " << statistics.value("droppedVideoFrameCount").toInt()
+                        << ", written " << statistics.value("bytesWritten").toLongLong() << " bytes" << endl;
+}
+
+void Benchmark::printReport()
+{
+    if (m_failed)
+        return;
+
+    QVariantMap statistics = m_streamer->encoder()->statistics();
+    int frames = statistics.value("encodedFrameCount").toInt();
+    double seconds = m_wallTime / 1000000.0;
+    double frameRate = seconds > 0 ? frames / seconds : 0;
+
+    QTextStream out(stdout);
+    out << endl;
+    out << "grabbed frames:        " << m_grabber->grabbedFrameCount() << endl;
+    out << "encoded frames:        " << frames << endl;
+    out << "dropped frames:        " << statistics.value("droppedVideoFrameCount").toInt() << endl;
+    out << "encoded fps:           " << QString::number(frameRate, 'f', 2) << endl;
+    out << "CPU per frame (us):    " << (frames > 0 ? m_cpuTime / frames : 0) << endl;
+    out << "CPU load (cores):      " << QString::number(m_wallTime > 0 ? double(m_cpuTime) / m_wallTime : 0, 'f', 2) << endl;
+    out << "bytes written:         " << statistics.value("bytesWritten").toLongLong() << endl;
+    out << "A/V drift (ms):        " << statistics.value("avDrift").toInt() << endl;
+    out << endl;
+
+    out << qSetFieldWidth(20) << left << "stage (us)" << qSetFieldWidth(10) << right
+        << "count" << "average" << "p50" << "p95" << "p99" << "max" << qSetFieldWidth(0) << endl;
+
+    QStringList stages;
+    stages << "videoQueueLatency" << "conversionTime" << "videoEncodingTime"
+           << "audioQueueLatency" << "audioEncodingTime" << "writeTime";
+
+    Q_FOREACH (const QString &stage, stages) {
+        QVariantMap histogram = statistics.value(stage).toMap();
+
+        out << qSetFieldWidth(20) << left << stage << qSetFieldWidth(10) << right
+            << histogram.value("count").toInt()
+            << histogram.value("average").toLongLong()
+            << histogram.value("p50").toLongLong()
+            << histogram.value("p95").toLongLong()
+            << histogram.value("p99").toLongLong()
+            << histogram.value("max").toLongLong()
+            << qSetFieldWidth(0) << endl;
+    }
+
+    if (m_minimumFrameRate > 0 && frameRate < m_minimumFrameRate) {
+        QTextStream(stderr) << "Encoded frame rate " << frameRate << " is below " << m_minimumFrameRate << endl;
+        Q_EMIT finished(2);
+        return;
+    }
+
+    Q_EMIT finished(0);
+}
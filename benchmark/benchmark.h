@@ -0,0 +1,111 @@
+/****************************************************************************
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License as published by the Free Software Foundation; either
+** version 2.1 of the License, or (at your option) any later version.
+**
+** This library is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public
+** License along with this library; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**
+****************************************************************************/
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QObject>
+#include <QList>
+#include <QSize>
+#include <QElapsedTimer>
+#include <QVariantMap>
+
+#include "encoder/encoder.h"
+
+class Streamer;
+class AbstractImageGrabber;
+class AudioGrabber;
+
+//! The Benchmark class streams synthetic audio and video through Streamer for a fixed time and reports the throughput.
+/*!
+  Video is a PatternImageGrabber test pattern, or the content of a media file decoded by FileImageGrabber in real time
+  if setInputFileName() is called. Audio is a sine tone captured by AudioGrabber from the LoopbackAudioBackend device.
+
+  The report contains the encoded frame rate, CPU time per encoded frame and percentiles of every pipeline stage
+  taken from Encoder::statistics(). finished() carries the process exit code: 1 if encoding failed, 2 if the
+  encoded frame rate is below minimumFrameRate().
+*/
+class Benchmark : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit Benchmark(QObject *parent = 0);
+    virtual ~Benchmark();
+
+    void setFrameSize(const QSize &size);
+    void setFrameRate(int frameRate);
+    /*! Sets how long the benchmark streams, in seconds. */
+    void setDuration(int seconds);
+    void setVideoCodec(EncoderGlobal::VideoCodec codec);
+    void setVideoBitrate(int bitrate);
+    void setAudioEnabled(bool enabled);
+    /*! Sets a media file to be streamed instead of the test pattern. */
+    void setInputFileName(const QString &fileName);
+    /*! Sets the output path, the default is the null device. */
+    void setOutputPath(const QString &path);
+    /*! Sets the output container, by default it is chosen by the output path. */
+    void setOutputFormat(Encoder::OutputFormat format);
+    /*! Adds a simulcast rendition written to the null device. */
+    void addRendition(const QSize &size, int bitrate);
+    /*! Records the stream to segmented files at \a path as well. */
+    void setRecordingPath(const QString &path);
+    /*! Sets the encoded frame rate below which the benchmark fails. 0, the default, disables the check. */
+    void setMinimumFrameRate(double frameRate);
+
+public Q_SLOTS:
+    void start();
+
+Q_SIGNALS:
+    void finished(int exitCode);
+
+private Q_SLOTS:
+    void onEncoderStarted();
+    void onEncoderStopped();
+    void onEncoderError();
+    void printProgress(const QVariantMap &statistics);
+    void stop();
+
+private:
+    void printReport();
+
+    Streamer *m_streamer;
+    AbstractImageGrabber *m_grabber;
+    AudioGrabber *m_audioGrabber;
+
+    QSize m_frameSize;
+    int m_frameRate;
+    int m_duration;
+    EncoderGlobal::VideoCodec m_videoCodec;
+    int m_videoBitrate;
+    bool m_audioEnabled;
+    QString m_inputFileName;
+    QString m_outputPath;
+    Encoder::OutputFormat m_outputFormat;
+    QList<QSize> m_renditionSizes;
+    QList<int> m_renditionBitrates;
+    QString m_recordingPath;
+    double m_minimumFrameRate;
+
+    QElapsedTimer m_wallClock;
+    qint64 m_startCpuTime;
+    qint64 m_wallTime;
+    qint64 m_cpuTime;
+    bool m_failed;
+};
+
+#endif // BENCHMARK_H
@@ -0,0 +1,64 @@
+TEMPLATE = app
+TARGET = streamer-benchmark
+QT += core gui concurrent multimedia
+CONFIG += console
+CONFIG -= app_bundle
+
+# The benchmark links the encode pipeline sources directly, FFMPEG_* variables are the same as for streamer.pro
+ROOT = $$PWD/..
+INCLUDEPATH += $$ROOT $$(FFMPEG_INCLUDE_PATH)
+LIBS += -L$$(FFMPEG_LIBRARY_PATH) -lavcodec -lavformat -lswscale -lswresample -lavutil
+
+win32 {
+    DEFINES += __WINDOWS_DS__
+    LIBS += -ldsound -lole32 -lwinmm
+}
+
+unix {
+    DEFINES += __LINUX_ALSA__ __LINUX_PULSE__
+    LIBS += -lasound -lpulse-simple -lpulse -lpthread
+}
+
+SOURCES += \
+    main.cpp \
+    benchmark.cpp \
+    $$ROOT/abstractgrabber.cpp \
+    $$ROOT/abstractimagegrabber.cpp \
+    $$ROOT/audiobackend.cpp \
+    $$ROOT/audioformat.cpp \
+    $$ROOT/audiograbber.cpp \
+    $$ROOT/fileimagegrabber.cpp \
+    $$ROOT/loopbackaudiobackend.cpp \
+    $$ROOT/patternimagegrabber.cpp \
+    $$ROOT/rtaudiobackend.cpp \
+    $$ROOT/streamer.cpp \
+    $$ROOT/3rdparty/RtAudio/RtAudio.cpp \
+    $$ROOT/encoder/audiocodecsettings.cpp \
+    $$ROOT/encoder/bitratecontroller.cpp \
+    $$ROOT/encoder/encoder.cpp \
+    $$ROOT/encoder/muxer.cpp \
+    $$ROOT/encoder/outputwriter.cpp \
+    $$ROOT/encoder/renditionencoder.cpp \
+    $$ROOT/encoder/videocodecsettings.cpp \
+    $$ROOT/encoder/videoframe.cpp \
+    $$ROOT/helpers/audiotimer.cpp \
+    $$ROOT/helpers/latencyhistogram.cpp \
+    $$ROOT/helpers/ringbuffer.cpp
+
+HEADERS += \
+    benchmark.h \
+    $$ROOT/abstractgrabber.h \
+    $$ROOT/abstractimagegrabber.h \
+    $$ROOT/audiobackend.h \
+    $$ROOT/audioformat.h \
+    $$ROOT/audiograbber.h \
+    $$ROOT/fileimagegrabber.h \
+    $$ROOT/loopbackaudiobackend.h \
+    $$ROOT/patternimagegrabber.h \
+    $$ROOT/rtaudiobackend.h \
+    $$ROOT/streamer.h \
+    $$ROOT/encoder/encoder.h \
+    $$ROOT/encoder/muxer.h \
+    $$ROOT/encoder/outputwriter.h \
+    $$ROOT/encoder/renditionencoder.h \
+    $$ROOT/helpers/audiotimer.h
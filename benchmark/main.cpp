@@ -0,0 +1,120 @@
+/****************************************************************************
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License as published by the Free Software Foundation; either
+** version 2.1 of the License, or (at your option) any later version.
+**
+** This library is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public
+** License along with this library; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**
+****************************************************************************/
+#include "benchmark.h"
+
+#include <QCommandLineOption>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QTextStream>
+#include <QTimer>
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("streamer-benchmark");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Streams synthetic audio and video through the encoder and reports the throughput.");
+    parser.addHelpOption();
+
+    QCommandLineOption sizeOption(QStringList() << "s" << "size", "Frame size.", "WxH", "1280x720");
+    QCommandLineOption fpsOption(QStringList() << "r" << "fps", "Frame rate.", "fps", "30");
+    QCommandLineOption durationOption(QStringList() << "d" << "duration", "Duration in seconds.", "seconds", "10");
+    QCommandLineOption codecOption(QStringList() << "c" << "codec", "Video codec: h264 or flv1.", "codec", "h264");
+    QCommandLineOption bitrateOption(QStringList() << "b" << "bitrate", "Video bitrate in bits per second.", "bitrate", "2000000");
+    QCommandLineOption inputOption(QStringList() << "i" << "input", "Media file streamed instead of the test pattern.", "path");
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "Output file or URL, the null device by default.", "path");
+    QCommandLineOption formatOption(QStringList() << "f" << "format", "Output format: flv, mpegts, mp4 or hls, chosen by the output path by default.", "format");
+    QCommandLineOption renditionOption("rendition", "Simulcast rendition encoded as well, may be repeated.", "WxH:bitrate");
+    QCommandLineOption recordOption("record", "Records the stream to segmented files as well.", "path");
+    QCommandLineOption noAudioOption("no-audio", "Encode video only.");
+    QCommandLineOption minimumFpsOption("min-fps", "Fail with exit code 2 below this encoded frame rate.", "fps", "0");
+
+    parser.addOption(sizeOption);
+    parser.addOption(fpsOption);
+    parser.addOption(durationOption);
+    parser.addOption(codecOption);
+    parser.addOption(bitrateOption);
+    parser.addOption(inputOption);
+    parser.addOption(outputOption);
+    parser.addOption(formatOption);
+    parser.addOption(renditionOption);
+    parser.addOption(recordOption);
+    parser.addOption(noAudioOption);
+    parser.addOption(minimumFpsOption);
+    parser.process(app);
+
+    QStringList size = parser.value(sizeOption).split('x');
+    if (size.size() != 2 || size.at(0).toInt() <= 0 || size.at(1).toInt() <= 0) {
+        QTextStream(stderr) << "Invalid frame size: " << parser.value(sizeOption) << endl;
+        return 1;
+    }
+
+    Benchmark benchmark;
+    benchmark.setFrameSize(QSize(size.at(0).toInt(), size.at(1).toInt()));
+    benchmark.setFrameRate(parser.value(fpsOption).toInt());
+    benchmark.setDuration(parser.value(durationOption).toInt());
+    benchmark.setVideoCodec(parser.value(codecOption) == "flv1" ? EncoderGlobal::FLV1 : EncoderGlobal::H264);
+    benchmark.setVideoBitrate(parser.value(bitrateOption).toInt());
+    benchmark.setAudioEnabled(!parser.isSet(noAudioOption));
+    benchmark.setMinimumFrameRate(parser.value(minimumFpsOption).toDouble());
+
+    if (parser.isSet(inputOption))
+        benchmark.setInputFileName(parser.value(inputOption));
+
+    if (parser.isSet(outputOption))
+        benchmark.setOutputPath(parser.value(outputOption));
+
+    if (parser.isSet(recordOption))
+        benchmark.setRecordingPath(parser.value(recordOption));
+
+    foreach (const QString &rendition, parser.values(renditionOption)) {
+        QStringList sizeAndBitrate = rendition.split(':');
+        QStringList renditionSize = sizeAndBitrate.at(0).split('x');
+
+        if (sizeAndBitrate.size() != 2 || renditionSize.size() != 2 || renditionSize.at(0).toInt() <= 0
+                || renditionSize.at(1).toInt() <= 0 || sizeAndBitrate.at(1).toInt() <= 0) {
+            QTextStream(stderr) << "Invalid rendition: " << rendition << endl;
+            return 1;
+        }
+
+        benchmark.addRendition(QSize(renditionSize.at(0).toInt(), renditionSize.at(1).toInt()), sizeAndBitrate.at(1).toInt());
+    }
+
+    if (parser.isSet(formatOption)) {
+        QString format = parser.value(formatOption);
+
+        if (format == "flv") {
+            benchmark.setOutputFormat(Encoder::FlvFormat);
+        } else if (format == "mpegts") {
+            benchmark.setOutputFormat(Encoder::MpegTsFormat);
+        } else if (format == "mp4") {
+            benchmark.setOutputFormat(Encoder::FragmentedMp4Format);
+        } else if (format == "hls") {
+            benchmark.setOutputFormat(Encoder::HlsFormat);
+        } else {
+            QTextStream(stderr) << "Invalid output format: " << format << endl;
+            return 1;
+        }
+    }
+
+    QObject::connect(&benchmark, &Benchmark::finished, &app, &QCoreApplication::exit, Qt::QueuedConnection);
+    QTimer::singleShot(0, &benchmark, SLOT(start()));
+
+    return app.exec();
+}
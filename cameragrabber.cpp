@@ -29,6 +29,8 @@
 #include <opencv/cv.h>
 #include <opencv/highgui.h>
 
+#define FRAME_POOL_SIZE 4
+
 CameraGrabber::CameraGrabber(QObject *parent)
     : AbstractImageGrabber(parent)
     , m_deviceIndex(-1)
@@ -133,11 +135,16 @@ void CameraGrabber::releaseCamera()
 {
     cvReleaseCapture(&m_camera);
     m_camera = 0;
+    m_framePool.clear();
 }
 
 QImage CameraGrabber::captureFrame()
 {
-    IplImage *iplImage = cvQueryFrame(m_camera);
+    return captureFrame(cvQueryFrame(m_camera));
+}
+
+QImage CameraGrabber::captureFrame(IplImage *iplImage)
+{
     if (!iplImage)
         return QImage();
 
@@ -172,3 +179,45 @@ QImage CameraGrabber::captureFrame()
 
     return frame;
 }
+
+VideoFrame CameraGrabber::captureVideoFrame()
+{
+    IplImage *iplImage = cvQueryFrame(m_camera);
+    if (!iplImage)
+        return VideoFrame();
+
+    //frames which have to be letterboxed go through the QImage path
+    if (iplImage->depth != IPL_DEPTH_8U || iplImage->nChannels != 3
+            || QSize(iplImage->width, iplImage->height) != size()) {
+        return VideoFrame(captureFrame(iplImage));
+    }
+
+    //OpenCV reuses its buffer for the next frame, so the BGR pixels are copied once and converted by the encoder
+    VideoFrame frame = pooledFrame(size());
+    int lineSize = iplImage->width * 3;
+    const char *src = iplImage->imageData;
+    uchar *dst = frame.bits(0);
+
+    for (int y = 0; y < iplImage->height; ++y) {
+        memcpy(dst, src, lineSize);
+        src += iplImage->widthStep;
+        dst += frame.bytesPerLine(0);
+    }
+
+    return frame;
+}
+
+VideoFrame CameraGrabber::pooledFrame(const QSize &size)
+{
+    //a frame is free again as soon as the encoder has released its copy
+    for (int i = 0; i < m_framePool.count(); ++i) {
+        if (!m_framePool.at(i).isShared() && m_framePool.at(i).size() == size)
+            return m_framePool.at(i);
+    }
+
+    VideoFrame frame(size, EncoderGlobal::BGR24);
+    if (m_framePool.count() < FRAME_POOL_SIZE)
+        m_framePool.append(frame);
+
+    return frame;
+}
@@ -22,8 +22,10 @@
 #include "abstractimagegrabber.h"
 
 #include <QStringList>
+#include <QList>
 
 class CvCapture;
+struct _IplImage;
 
 //! The CameraGrabber class allows the application to capture frames from a camera device.
 /*!
@@ -85,10 +87,14 @@ private:
     bool createCamera();
     void releaseCamera();
     QImage captureFrame();
+    QImage captureFrame(_IplImage *iplImage);
+    VideoFrame captureVideoFrame();
+    VideoFrame pooledFrame(const QSize &size);
 
     CvCapture *m_camera;
     int m_deviceIndex;
     QSize m_size;
+    QList<VideoFrame> m_framePool;
 };
 
 #endif // CAMERAGRABBER_H
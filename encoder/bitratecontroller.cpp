@@ -0,0 +1,95 @@
+/****************************************************************************
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License as published by the Free Software Foundation; either
+** version 2.1 of the License, or (at your option) any later version.
+**
+** This library is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public
+** License along with this library; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**
+****************************************************************************/
+
+
+#include "bitratecontroller.h"
+
+//share of the interval spent in blocking writes above which the uplink is congested
+#define CONGESTED_RATIO 0.2
+//share of the interval below which the uplink has spare capacity
+#define STABLE_RATIO 0.05
+#define DECREASE_FACTOR 0.8
+#define INCREASE_STEP 0.05
+#define INCREASE_INTERVALS 3
+
+BitrateController::BitrateController()
+    : m_minimum(0)
+    , m_maximum(0)
+    , m_bitrate(0)
+    , m_stableIntervals(0)
+{
+}
+
+void BitrateController::setRange(int minimum, int maximum)
+{
+    m_minimum = minimum;
+    m_maximum = qMax(minimum, maximum);
+    m_bitrate = qBound(m_minimum, m_bitrate, m_maximum);
+}
+
+int BitrateController::minimum() const
+{
+    return m_minimum;
+}
+
+int BitrateController::maximum() const
+{
+    return m_maximum;
+}
+
+void BitrateController::reset(int bitrate)
+{
+    m_bitrate = qBound(m_minimum, bitrate, m_maximum);
+    m_stableIntervals = 0;
+}
+
+int BitrateController::bitrate() const
+{
+    return m_bitrate;
+}
+
+bool BitrateController::update(qint64 bytes, qint64 blockedUsecs, qint64 intervalUsecs)
+{
+    if (intervalUsecs <= 0)
+        return false;
+
+    double blockedRatio = static_cast<double>(blockedUsecs) / intervalUsecs;
+    qint64 throughput = bytes * 8 * 1000000 / intervalUsecs;
+    qint64 target = m_bitrate;
+
+    if (blockedRatio > CONGESTED_RATIO) {
+        //the uplink could not take more than it just did, so go below both the current rate and the throughput
+        target = qMin<qint64>(m_bitrate, throughput) * DECREASE_FACTOR;
+        m_stableIntervals = 0;
+    } else if (blockedRatio < STABLE_RATIO) {
+        if (++m_stableIntervals >= INCREASE_INTERVALS) {
+            target = m_bitrate + qMax<qint64>(1, m_maximum * INCREASE_STEP);
+            m_stableIntervals = 0;
+        }
+    } else {
+        m_stableIntervals = 0;
+    }
+
+    target = qBound<qint64>(m_minimum, target, m_maximum);
+
+    if (target == m_bitrate)
+        return false;
+
+    m_bitrate = static_cast<int>(target);
+    return true;
+}
@@ -0,0 +1,59 @@
+/****************************************************************************
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License as published by the Free Software Foundation; either
+** version 2.1 of the License, or (at your option) any later version.
+**
+** This library is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public
+** License along with this library; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**
+****************************************************************************/
+
+
+#ifndef BITRATECONTROLLER_H
+#define BITRATECONTROLLER_H
+
+#include <QtGlobal>
+
+//! The BitrateController class picks the video bitrate from measurements of the output.
+/*!
+  Every measurement interval the controller is fed with the count of written bytes and the time spent blocked in writes.
+  A congested uplink makes writes block, then the bitrate is cut below the measured throughput. After several intervals
+  without blocking the bitrate is raised again in small steps. The bitrate always stays within the configured range.
+*/
+class BitrateController
+{
+public:
+    BitrateController();
+
+    void setRange(int minimum, int maximum);
+    int minimum() const;
+    int maximum() const;
+
+    /*! Starts over at \a bitrate. */
+    void reset(int bitrate);
+    int bitrate() const;
+
+    /*!
+      Adds the measurement of one interval and returns true if bitrate() has changed.
+      \param bytes count of bytes written in the interval.
+      \param blockedUsecs time spent in blocking writes.
+      \param intervalUsecs length of the interval.
+    */
+    bool update(qint64 bytes, qint64 blockedUsecs, qint64 intervalUsecs);
+
+private:
+    int m_minimum;
+    int m_maximum;
+    int m_bitrate;
+    int m_stableIntervals;
+};
+
+#endif // BITRATECONTROLLER_H
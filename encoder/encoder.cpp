@@ -17,6 +17,12 @@
 ****************************************************************************/
 
 #include "encoder.h"
+#include "helpers/boundedqueue.h"
+#include "helpers/latencyhistogram.h"
+#include "muxer.h"
+#include "outputwriter.h"
+#include "renditionencoder.h"
+#include "bitratecontroller.h"
 
 #ifndef INT64_C
 #define INT64_C(c) (c ## LL)
@@ -28,19 +34,208 @@ extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
 #include <libswscale/swscale.h>
+#include <libswresample/swresample.h>
 #include <libavutil/opt.h>
+#include <libavutil/channel_layout.h>
 }
 
 #include <QMetaType>
 #include <QThread>
-#include <QMutex>
-#include <QMutexLocker>
 #include <QImage>
 #include <QElapsedTimer>
+#include <QAtomicInt>
+#include <QTimer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThreadPool>
+#include <QVariantList>
+#include <QVariantMap>
+#include <QVarLengthArray>
 
 #include <QDateTime>
 #include <QDebug>
 
+#define DEFAULT_VIDEO_QUEUE_CAPACITY 8
+#define DEFAULT_AUDIO_QUEUE_CAPACITY 64
+#define DEFAULT_AUDIO_FRAME_SIZE 1024
+#define BITRATE_ADJUSTMENT_INTERVAL 1000
+#define DEFAULT_STATISTICS_INTERVAL 1000
+#define DEFAULT_RECORDING_SEGMENT_DURATION 600000
+
+//AVChannelLayout replaced the channels/channel_layout pair in libavutil 57.24
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(57, 24, 100)
+#define ENCODER_CHANNEL_LAYOUT_API
+#endif
+
+struct EncoderVideoItem {
+    VideoFrame frame;
+    int pts;
+    qint64 enqueueTime;
+};
+
+struct EncoderAudioItem {
+    QByteArray data;
+    int pts;
+    qint64 enqueueTime;
+};
+
+struct EncoderRendition {
+    QSize size;
+    int bitrate;
+    QString url;
+    Encoder::OutputFormat format;
+};
+
+//EncoderGlobal keeps the historical PixelFormat numbering, which differs from AVPixelFormat after YUVJ444P
+static AVPixelFormat toAVPixelFormat(EncoderGlobal::EncoderPixelFormat format)
+{
+    switch (format) {
+    case EncoderGlobal::PIXEL_FORMAT_NONE: return AV_PIX_FMT_NONE;
+    case EncoderGlobal::UYVY422: return AV_PIX_FMT_UYVY422;
+    case EncoderGlobal::UYYVYY411: return AV_PIX_FMT_UYYVYY411;
+    case EncoderGlobal::BGR8: return AV_PIX_FMT_BGR8;
+    case EncoderGlobal::BGR4: return AV_PIX_FMT_BGR4;
+    case EncoderGlobal::BGR4_BYTE: return AV_PIX_FMT_BGR4_BYTE;
+    case EncoderGlobal::RGB8: return AV_PIX_FMT_RGB8;
+    case EncoderGlobal::RGB4: return AV_PIX_FMT_RGB4;
+    case EncoderGlobal::RGB4_BYTE: return AV_PIX_FMT_RGB4_BYTE;
+    case EncoderGlobal::NV12: return AV_PIX_FMT_NV12;
+    case EncoderGlobal::NV21: return AV_PIX_FMT_NV21;
+    case EncoderGlobal::ARGB: return AV_PIX_FMT_ARGB;
+    case EncoderGlobal::RGBA: return AV_PIX_FMT_RGBA;
+    case EncoderGlobal::ABGR: return AV_PIX_FMT_ABGR;
+    case EncoderGlobal::BGRA: return AV_PIX_FMT_BGRA;
+    case EncoderGlobal::GRAY16BE: return AV_PIX_FMT_GRAY16BE;
+    case EncoderGlobal::GRAY16LE: return AV_PIX_FMT_GRAY16LE;
+    case EncoderGlobal::YUV440P: return AV_PIX_FMT_YUV440P;
+    case EncoderGlobal::YUVJ440P: return AV_PIX_FMT_YUVJ440P;
+    case EncoderGlobal::YUVA420P: return AV_PIX_FMT_YUVA420P;
+    case EncoderGlobal::RGB48BE: return AV_PIX_FMT_RGB48BE;
+    case EncoderGlobal::RGB48LE: return AV_PIX_FMT_RGB48LE;
+    case EncoderGlobal::RGB565BE: return AV_PIX_FMT_RGB565BE;
+    case EncoderGlobal::RGB565LE: return AV_PIX_FMT_RGB565LE;
+    case EncoderGlobal::RGB555BE: return AV_PIX_FMT_RGB555BE;
+    case EncoderGlobal::RGB555LE: return AV_PIX_FMT_RGB555LE;
+    case EncoderGlobal::BGR565BE: return AV_PIX_FMT_BGR565BE;
+    case EncoderGlobal::BGR565LE: return AV_PIX_FMT_BGR565LE;
+    case EncoderGlobal::BGR555BE: return AV_PIX_FMT_BGR555BE;
+    case EncoderGlobal::BGR555LE: return AV_PIX_FMT_BGR555LE;
+    case EncoderGlobal::YUV420P16LE: return AV_PIX_FMT_YUV420P16LE;
+    case EncoderGlobal::YUV420P16BE: return AV_PIX_FMT_YUV420P16BE;
+    case EncoderGlobal::YUV422P16LE: return AV_PIX_FMT_YUV422P16LE;
+    case EncoderGlobal::YUV422P16BE: return AV_PIX_FMT_YUV422P16BE;
+    case EncoderGlobal::YUV444P16LE: return AV_PIX_FMT_YUV444P16LE;
+    case EncoderGlobal::YUV444P16BE: return AV_PIX_FMT_YUV444P16BE;
+    case EncoderGlobal::RGB444BE: return AV_PIX_FMT_RGB444BE;
+    case EncoderGlobal::RGB444LE: return AV_PIX_FMT_RGB444LE;
+    case EncoderGlobal::BGR444BE: return AV_PIX_FMT_BGR444BE;
+    case EncoderGlobal::BGR444LE: return AV_PIX_FMT_BGR444LE;
+    case EncoderGlobal::Y400A: return AV_PIX_FMT_YA8;
+
+    //hardware surfaces can not be encoded from memory
+    case EncoderGlobal::XVMC_MPEG2_MC:
+    case EncoderGlobal::XVMC_MPEG2_IDCT:
+    case EncoderGlobal::VDPAU_H264:
+    case EncoderGlobal::VDPAU_MPEG1:
+    case EncoderGlobal::VDPAU_MPEG2:
+    case EncoderGlobal::VDPAU_WMV3:
+    case EncoderGlobal::VDPAU_VC1:
+    case EncoderGlobal::VDPAU_MPEG4:
+    case EncoderGlobal::VAAPI_MOCO:
+    case EncoderGlobal::VAAPI_IDCT:
+    case EncoderGlobal::VAAPI_VLD:
+    case EncoderGlobal::DXVA2_VLD:
+        return AV_PIX_FMT_NONE;
+
+    default:
+        return static_cast<AVPixelFormat>(format);
+    }
+}
+
+static void setChannelCount(AVCodecContext *context, int channelCount)
+{
+#ifdef ENCODER_CHANNEL_LAYOUT_API
+    av_channel_layout_uninit(&context->ch_layout);
+    av_channel_layout_default(&context->ch_layout, channelCount);
+#else
+    context->channels = channelCount;
+    context->channel_layout = av_get_default_channel_layout(channelCount);
+#endif
+}
+
+static AVSampleFormat toAVSampleFormat(AudioFormat::Format format)
+{
+    switch (format) {
+    case AudioFormat::SignedInt8:
+        return AV_SAMPLE_FMT_U8;
+    case AudioFormat::SignedInt16:
+        return AV_SAMPLE_FMT_S16;
+    case AudioFormat::SignedInt32:
+        return AV_SAMPLE_FMT_S32;
+    case AudioFormat::Float32:
+        return AV_SAMPLE_FMT_FLT;
+    case AudioFormat::Float64:
+        return AV_SAMPLE_FMT_DBL;
+    default:
+        return AV_SAMPLE_FMT_NONE;
+    }
+}
+
+static int channelCount(const AVCodecContext *context)
+{
+#ifdef ENCODER_CHANNEL_LAYOUT_API
+    return context->ch_layout.nb_channels;
+#else
+    return context->channels;
+#endif
+}
+
+//names of the motion estimation methods in libx264 ("motion-est") and mpegvideo ("motion_est") encoders
+static const char *motionEstimationName(EncoderGlobal::MotionEstimationAlgorithm method, bool x264)
+{
+    switch (method) {
+    case EncoderGlobal::Zero: return x264 ? "dia" : "zero";
+    case EncoderGlobal::Full: return x264 ? "esa" : "epzs";
+    case EncoderGlobal::Epzs: return x264 ? "dia" : "epzs";
+    case EncoderGlobal::X1: return x264 ? "hex" : "xone";
+    case EncoderGlobal::Hex: return x264 ? "hex" : "epzs";
+    case EncoderGlobal::Umh: return x264 ? "umh" : "epzs";
+    case EncoderGlobal::Tesa: return x264 ? "tesa" : "epzs";
+    default: return 0;
+    }
+}
+
+//keeps a copy of the VideoFrame alive while the encoder refers to its planes
+static void releaseVideoFrame(void *opaque, uint8_t *data)
+{
+    Q_UNUSED(data);
+    delete static_cast<VideoFrame *>(opaque);
+}
+
+//x264 adds keyframes at scene cuts, which would not be at the same pictures in every rendition of a simulcast
+static void disableSceneCut(AVCodecContext *context)
+{
+    if (context->codec_id == AV_CODEC_ID_H264)
+        av_opt_set_int(context, "sc_threshold", 0, AV_OPT_SEARCH_CHILDREN);
+}
+
+//the FFmpeg muxer writing an Encoder::OutputFormat
+static QString formatName(Encoder::OutputFormat format, const QString &url)
+{
+    switch (format) {
+    case Encoder::FlvFormat:
+        return "flv";
+    case Encoder::MpegTsFormat:
+        return url.section(':', 0, 0).toLower() == "rtp" ? "rtp_mpegts" : "mpegts";
+    case Encoder::FragmentedMp4Format:
+        return "mp4";
+    case Encoder::HlsFormat:
+        return "hls";
+    default:
+        return Muxer::formatNameForUrl(url);
+    }
+}
+
 class EncoderPrivate : public QObject {
     Q_OBJECT
 
@@ -51,6 +246,27 @@ public:
     void setFilePath(const QString &filePath);
     QString filePath() const;
 
+    void setOutputFormat(Encoder::OutputFormat format);
+    Encoder::OutputFormat outputFormat() const;
+
+    void setOutputOptions(const QVariantMap &options);
+    QVariantMap outputOptions() const;
+
+    void addOutput(const QString &url, Encoder::OutputFormat format, const QVariantMap &options);
+    void clearOutputs();
+    QStringList outputUrls() const;
+
+    void setRecordingPath(const QString &path);
+    QString recordingPath() const;
+
+    void setRecordingSegmentLimits(int msecs, qint64 bytes);
+    int recordingSegmentDuration() const;
+    qint64 recordingSegmentSize() const;
+
+    void addRendition(const QSize &size, int bitrate, const QString &url, Encoder::OutputFormat format);
+    void clearRenditions();
+    int renditionCount() const;
+
     void setVideoSize(const QSize &size);
     QSize videoSize() const;
 
@@ -76,20 +292,82 @@ public:
     void setAudioCodecSettings(const AudioCodecSettings &settings);
     AudioCodecSettings audioCodecSettings() const;
 
+    void setAudioInputFormat(const AudioFormat &format);
+    AudioFormat audioInputFormat() const;
+
+    void setVideoQueueCapacity(int capacity);
+    int videoQueueCapacity() const;
+
+    void setAudioQueueCapacity(int capacity);
+    int audioQueueCapacity() const;
+
+    void setOutputQueueCapacity(int capacity);
+    int outputQueueCapacity() const;
+
+    void setOverflowPolicy(Encoder::OverflowPolicy policy);
+    Encoder::OverflowPolicy overflowPolicy() const;
+
+    int droppedVideoFrameCount() const;
+    int droppedAudioChunkCount() const;
+
+    void setMaximumReconnectAttempts(int count);
+    int maximumReconnectAttempts() const;
+
+    void setReconnectBufferDuration(int msecs);
+    int reconnectBufferDuration() const;
+
+    void setAdaptiveBitrateEnabled(bool enabled);
+    bool isAdaptiveBitrateEnabled() const;
+
+    void setBitrateRange(int minimum, int maximum);
+    int minimumBitrate() const;
+    int maximumBitrate() const;
+
+    int currentBitrate() const;
+
     int encodedFrameCount() const;
     int encodedAudioDataSize() const;
 
+    //safe to call from any thread
+    QVariantMap statistics() const;
+
+    //these are called from grabber threads
+    void enqueueVideoFrame(const VideoFrame &frame, int pts);
+    void enqueueAudioData(const QByteArray &data, int pts);
+
 public Q_SLOTS:
     void start();
     void stop();
 
-    void encodeVideoFrame(const QImage &frame, int pts);
-    void encodeAudioData(const QByteArray &data, int pts);
-
 private Q_SLOTS:
     void onError();
+    void processQueues();
 
 private:
+    void scheduleProcessing();
+    void openQueues();
+    void closeQueues();
+
+    void encodeVideoFrame(const VideoFrame &frame, int pts);
+    void encodeAudioData(const QByteArray &data, int pts);
+    bool encodeAudioFrame(int pts);
+
+    bool writePackets(AVCodecContext *context, int streamIndex);
+    void flushEncoders();
+
+    void startOutputWriters();
+    void stopOutputWriters();
+
+    bool startRenditions();
+    void stopRenditions();
+    void encodeRenditions(const AVFrame *picture);
+
+    void startBitrateAdjustment();
+    void adjustBitrate();
+
+    void resetStatistics();
+    qint64 clockUsecs() const;
+
     void initData();
     void initFfmpegStuff();
     void cleanup();
@@ -99,12 +377,13 @@ private:
 
     bool openVideoStream();
     bool openAudioStream();
+    bool openAudioResampler();
 
-    bool convertImage(const QImage &image);
-    EncoderGlobal::EncoderPixelFormat convertImagePixelFormat(QImage::Format format) const;
+    AVFrame *fillPicture(const VideoFrame &frame);
 
-    void applyVideoCodecSettings();
-    template <class T1, class T2> void setVideoCodecOption(T1 AVCodecContext::*option, T2 (VideoCodecSettings::*f)() const);
+    void applyVideoCodecSettings(AVCodecContext *context);
+    template <class T1, class T2> void setVideoCodecOption(AVCodecContext *context, T1 AVCodecContext::*option, T2 (VideoCodecSettings::*f)() const);
+    void setVideoCodecPrivateOption(AVCodecContext *context, const char *name, int value);
 
     void applyAudioCodecSettings();
     template <class T1, class T2> void setAudioCodecOption(T1 AVCodecContext::*option, T2 (AudioCodecSettings::*f)() const);
@@ -116,48 +395,108 @@ private:
     EncoderGlobal::AudioCodec m_audioCodecName;
     VideoCodecSettings m_videoSettings;
     AudioCodecSettings m_audioSettings;
+    AudioFormat m_audioInputFormat;
 
     QString m_filePath;
+    Encoder::OutputFormat m_outputFormatType;
     QSize m_videoSize;
+
+    struct OutputSettings {
+        QString url;
+        Encoder::OutputFormat format;
+        QVariantMap options;
+    };
     int m_fixedFrameRate;
     Encoder::EncodingMode m_encodingMode;
 
-    int m_pts;
-    int m_encodedFrameCount;
-    int m_encodedAudioDataSize;
+    int64_t m_lastVideoPts;
+    int64_t m_nextAudioPts;
+    QAtomicInt m_encodedFrameCount;
+    QAtomicInt m_encodedAudioDataSize;
+
+    //queues between grabbers and the encoder thread
+    BoundedQueue<EncoderVideoItem> m_videoQueue;
+    BoundedQueue<EncoderAudioItem> m_audioQueue;
+    Encoder::OverflowPolicy m_overflowPolicy;
+    QAtomicInt m_processingScheduled;
+    QAtomicInt m_queuedFrameCount;
+    int m_referenceInterval;
+
+    //output, written on a thread of its own so network stalls never block encoding
+    OutputWriter m_primaryOutput;
+    bool m_primaryConnected;
+    const AVOutputFormat *m_outputFormat;
+
+    //added outputs, the recording and simulcast renditions, they only change on start and stop
+    QList<OutputSettings> m_outputSettings;
+    QList<OutputWriter *> m_outputWriters;
+    QString m_recordingPath;
+    int m_recordingSegmentDuration;
+    qint64 m_recordingSegmentSize;
+    OutputWriter *m_recorder;
+    QList<EncoderRendition> m_renditionSettings;
+    QList<RenditionEncoder *> m_renditions;
+    QThreadPool m_renditionPool;
+    int64_t m_videoFrameIndex;
+    mutable QMutex m_outputsMutex;
+
+    //adaptive bitrate
+    bool m_adaptiveBitrate;
+    int m_minimumBitrate;
+    int m_maximumBitrate;
+    BitrateController m_bitrateController;
+    QElapsedTimer m_bitrateTimer;
+    QAtomicInt m_currentBitrate;
+
+    //statistics, written by the encoder thread and read from any thread
+    QElapsedTimer m_clock;
+    LatencyHistogram m_videoQueueLatency;
+    LatencyHistogram m_audioQueueLatency;
+    LatencyHistogram m_conversionTime;
+    LatencyHistogram m_videoEncodingTime;
+    LatencyHistogram m_audioEncodingTime;
+    QAtomicInt m_lastVideoTime;
+    QAtomicInt m_lastAudioTime;
 
     //video stuff
-    AVOutputFormat *m_outputFormat;
-    AVFormatContext *m_formatContext;
-    AVStream *m_videoStream;
+    int m_videoStreamIndex;
     AVCodecContext *m_videoCodecContext;
-    AVCodec *m_videoCodec;
-    uint8_t* m_videoBuffer;
+    const AVCodec *m_videoCodec;
     AVFrame *m_videoPicture;
-    AVFrame *m_audioFrame;
+    AVFrame *m_inputFrame;
+    AVPacket *m_packet;
     SwsContext *m_imageConvertContext;
-    int m_videoBufferSize;
-    uint8_t *m_pictureBuffer;
 
     //audio stuff
-    AVStream *m_audioStream;
+    int m_audioStreamIndex;
     AVCodecContext *m_audioCodecContext;
-    AVCodec *m_audioCodec;
-    uint8_t *m_audioOutputBuffer;
-    QByteArray m_audioInputBuffer;
-    int m_audioOutputBufferSize;
+    const AVCodec *m_audioCodec;
+    AVFrame *m_audioFrame;
+    SwrContext *m_audioResampler;
+    int m_audioFrameSize;
+    int m_audioFrameFill;
     int m_audioSampleSize;
-
-    mutable QMutex m_encodedFrameCountMutex;
-    mutable QMutex m_encodedAudioDataSizeMutex;
+    int m_audioInputSampleSize;
 };
 
 EncoderPrivate::EncoderPrivate(Encoder *e, QObject *parent)
     : QObject(parent)
+    , m_encodedFrameCount(0)
+    , m_encodedAudioDataSize(0)
+    , m_videoQueue(DEFAULT_VIDEO_QUEUE_CAPACITY)
+    , m_audioQueue(DEFAULT_AUDIO_QUEUE_CAPACITY)
+    , m_processingScheduled(0)
+    , m_queuedFrameCount(0)
+    , m_recorder(NULL)
+    , m_currentBitrate(0)
+    , m_lastVideoTime(0)
+    , m_lastAudioTime(0)
 {
     //get the pointer to the public class
     q_ptr = e;
 
+    m_clock.start();
+
     initData();
     initFfmpegStuff();
     avformat_network_init();
@@ -184,6 +523,103 @@ QString EncoderPrivate::filePath() const
     return m_filePath;
 }
 
+void EncoderPrivate::setOutputFormat(Encoder::OutputFormat format)
+{
+    m_outputFormatType = format;
+}
+
+Encoder::OutputFormat EncoderPrivate::outputFormat() const
+{
+    return m_outputFormatType;
+}
+
+void EncoderPrivate::setOutputOptions(const QVariantMap &options)
+{
+    m_primaryOutput.muxer()->setOptions(options);
+}
+
+QVariantMap EncoderPrivate::outputOptions() const
+{
+    return m_primaryOutput.muxer()->options();
+}
+
+void EncoderPrivate::addOutput(const QString &url, Encoder::OutputFormat format, const QVariantMap &options)
+{
+    OutputSettings settings;
+    settings.url = url;
+    settings.format = format;
+    settings.options = options;
+
+    m_outputSettings.append(settings);
+}
+
+void EncoderPrivate::clearOutputs()
+{
+    m_outputSettings.clear();
+}
+
+QStringList EncoderPrivate::outputUrls() const
+{
+    QStringList urls;
+    for (int i = 0; i < m_outputSettings.size(); ++i)
+        urls.append(m_outputSettings.at(i).url);
+
+    return urls;
+}
+
+void EncoderPrivate::setRecordingPath(const QString &path)
+{
+    m_recordingPath = path;
+}
+
+QString EncoderPrivate::recordingPath() const
+{
+    return m_recordingPath;
+}
+
+void EncoderPrivate::setRecordingSegmentLimits(int msecs, qint64 bytes)
+{
+    m_recordingSegmentDuration = msecs;
+    m_recordingSegmentSize = bytes;
+}
+
+int EncoderPrivate::recordingSegmentDuration() const
+{
+    return m_recordingSegmentDuration;
+}
+
+qint64 EncoderPrivate::recordingSegmentSize() const
+{
+    return m_recordingSegmentSize;
+}
+
+void EncoderPrivate::addRendition(const QSize &size, int bitrate, const QString &url, Encoder::OutputFormat format)
+{
+    EncoderRendition rendition;
+    rendition.size = size;
+    rendition.bitrate = bitrate;
+    rendition.url = url;
+    rendition.format = format;
+
+    //the list is kept from the largest to the smallest, each rendition is scaled from the one before
+    int index = 0;
+    while (index < m_renditionSettings.size()
+           && m_renditionSettings.at(index).size.width() * m_renditionSettings.at(index).size.height() >= size.width() * size.height())
+        ++index;
+
+    m_renditionSettings.insert(index, rendition);
+}
+
+void EncoderPrivate::clearRenditions()
+{
+    m_renditionSettings.clear();
+}
+
+int EncoderPrivate::renditionCount() const
+{
+    return m_renditionSettings.size();
+}
+
 void EncoderPrivate::setVideoSize(const QSize &size)
 {
     if (m_videoSize != size) {
@@ -281,16 +717,182 @@ AudioCodecSettings EncoderPrivate::audioCodecSettings() const
     return m_audioSettings;
 }
 
+void EncoderPrivate::setAudioInputFormat(const AudioFormat &format)
+{
+    m_audioInputFormat = format;
+}
+
+AudioFormat EncoderPrivate::audioInputFormat() const
+{
+    return m_audioInputFormat;
+}
+
+void EncoderPrivate::setVideoQueueCapacity(int capacity)
+{
+    m_videoQueue.setCapacity(capacity);
+}
+
+int EncoderPrivate::videoQueueCapacity() const
+{
+    return m_videoQueue.capacity();
+}
+
+void EncoderPrivate::setAudioQueueCapacity(int capacity)
+{
+    m_audioQueue.setCapacity(capacity);
+}
+
+int EncoderPrivate::audioQueueCapacity() const
+{
+    return m_audioQueue.capacity();
+}
+
+void EncoderPrivate::setOutputQueueCapacity(int capacity)
+{
+    m_primaryOutput.setQueueCapacity(capacity);
+}
+
+int EncoderPrivate::outputQueueCapacity() const
+{
+    return m_primaryOutput.queueCapacity();
+}
+
+void EncoderPrivate::setOverflowPolicy(Encoder::OverflowPolicy policy)
+{
+    if (m_overflowPolicy != policy) {
+        m_overflowPolicy = policy;
+
+        m_videoQueue.setOverflowPolicy(static_cast<BoundedQueueBase::OverflowPolicy>(policy));
+
+        //audio chunks are all alike, dropping the new ones would leave gaps in the sample clock
+        m_audioQueue.setOverflowPolicy(policy == Encoder::DropNonReference ? BoundedQueueBase::DropOldest
+                                                                           : static_cast<BoundedQueueBase::OverflowPolicy>(policy));
+    }
+}
+
+Encoder::OverflowPolicy EncoderPrivate::overflowPolicy() const
+{
+    return m_overflowPolicy;
+}
+
+int EncoderPrivate::droppedVideoFrameCount() const
+{
+    return m_videoQueue.droppedCount();
+}
+
+int EncoderPrivate::droppedAudioChunkCount() const
+{
+    return m_audioQueue.droppedCount();
+}
+
+void EncoderPrivate::setMaximumReconnectAttempts(int count)
+{
+    m_primaryOutput.muxer()->setMaximumReconnectAttempts(count);
+}
+
+int EncoderPrivate::maximumReconnectAttempts() const
+{
+    return m_primaryOutput.muxer()->maximumReconnectAttempts();
+}
+
+void EncoderPrivate::setReconnectBufferDuration(int msecs)
+{
+    m_primaryOutput.muxer()->setReconnectBufferDuration(msecs);
+}
+
+int EncoderPrivate::reconnectBufferDuration() const
+{
+    return m_primaryOutput.muxer()->reconnectBufferDuration();
+}
+
+void EncoderPrivate::setAdaptiveBitrateEnabled(bool enabled)
+{
+    m_adaptiveBitrate = enabled;
+}
+
+bool EncoderPrivate::isAdaptiveBitrateEnabled() const
+{
+    return m_adaptiveBitrate;
+}
+
+void EncoderPrivate::setBitrateRange(int minimum, int maximum)
+{
+    m_minimumBitrate = minimum;
+    m_maximumBitrate = maximum;
+}
+
+int EncoderPrivate::minimumBitrate() const
+{
+    return m_minimumBitrate;
+}
+
+int EncoderPrivate::maximumBitrate() const
+{
+    return m_maximumBitrate;
+}
+
+int EncoderPrivate::currentBitrate() const
+{
+    return m_currentBitrate.load();
+}
+
 int EncoderPrivate::encodedFrameCount() const
 {
-    QMutexLocker locker(&m_encodedFrameCountMutex);
-    return m_encodedFrameCount;
+    return m_encodedFrameCount.load();
 }
 
 int EncoderPrivate::encodedAudioDataSize() const
 {
-    QMutexLocker locker(&m_encodedAudioDataSizeMutex);
-    return m_encodedAudioDataSize;
+    return m_encodedAudioDataSize.load();
+}
+
+QVariantMap EncoderPrivate::statistics() const
+{
+    QVariantMap statistics;
+    statistics["encodedFrameCount"] = encodedFrameCount();
+    statistics["encodedAudioDataSize"] = encodedAudioDataSize();
+    statistics["droppedVideoFrameCount"] = droppedVideoFrameCount();
+    statistics["droppedAudioChunkCount"] = droppedAudioChunkCount();
+    statistics["videoQueueDepth"] = m_videoQueue.size();
+    statistics["audioQueueDepth"] = m_audioQueue.size();
+    statistics["bytesWritten"] = m_primaryOutput.muxer()->totalWrittenBytes();
+    statistics["pendingPacketCount"] = m_primaryOutput.muxer()->pendingPacketCount();
+    statistics["reconnectCount"] = m_primaryOutput.muxer()->reconnectCount();
+    statistics["outputQueueDepth"] = m_primaryOutput.queueDepth();
+    statistics["droppedPacketCount"] = m_primaryOutput.droppedPacketCount();
+    statistics["bitrate"] = currentBitrate();
+
+    //positive while audio is ahead of video, in milliseconds of capture time
+    statistics["avDrift"] = encodingMode() == Encoder::VideoAudioMode ? m_lastAudioTime.load() - m_lastVideoTime.load() : 0;
+
+    //durations are in microseconds
+    statistics["videoQueueLatency"] = m_videoQueueLatency.toVariantMap();
+    statistics["audioQueueLatency"] = m_audioQueueLatency.toVariantMap();
+    statistics["conversionTime"] = m_conversionTime.toVariantMap();
+    statistics["videoEncodingTime"] = m_videoEncodingTime.toVariantMap();
+    statistics["audioEncodingTime"] = m_audioEncodingTime.toVariantMap();
+    statistics["writeTime"] = m_primaryOutput.muxer()->writeLatency().toVariantMap();
+
+    QVariantList outputs;
+    QVariantList renditions;
+    QVariantMap recording;
+    {
+        QMutexLocker locker(&m_outputsMutex);
+        for (int i = 0; i < m_outputWriters.size(); ++i)
+            outputs.append(m_outputWriters.at(i)->statistics());
+
+        for (int i = 0; i < m_renditions.size(); ++i)
+            renditions.append(m_renditions.at(i)->statistics());
+
+        if (m_recorder)
+            recording = m_recorder->statistics();
+    }
+
+    statistics["outputs"] = outputs;
+    statistics["renditions"] = renditions;
+    statistics["recording"] = recording;
+
+    return statistics;
 }
 
 void EncoderPrivate::start()
@@ -314,18 +916,21 @@ void EncoderPrivate::start()
         return;
     }
 
+#if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58, 9, 100)
     avcodec_register_all();
     av_register_all();
+#endif
+
+    m_primaryOutput.muxer()->setFormatName(formatName(outputFormat(), filePath()));
+    m_primaryOutput.muxer()->setUrl(filePath());
 
-    m_outputFormat = av_guess_format("flv", NULL, NULL);
+    m_outputFormat = m_primaryOutput.muxer()->outputFormat();
     if (!m_outputFormat) {
         q_ptr->setError(Encoder::InvalidOutputFormatError, tr("Unable to get an output format by passed filename."));
         return;
     }
 
-    m_formatContext = avformat_alloc_context();
-    m_formatContext->oformat = m_outputFormat;
-    m_audioFrame = av_frame_alloc();
+    m_packet = av_packet_alloc();
 
     if (encodingMode() == Encoder::VideoMode
             || encodingMode() == Encoder::VideoAudioMode) {
@@ -346,126 +951,538 @@ void EncoderPrivate::start()
             return;
     }
 
-    if (avio_open(&m_formatContext->pb, filePath().toUtf8().constData(), AVIO_FLAG_WRITE) < 0) {
-        q_ptr->setError(Encoder::FileOpenError, QString(tr("Unable to open: %1")).arg(filePath()));
-        return;
+    //later write errors are handled by reconnecting, a failure here is reported at once
+    if (!m_primaryOutput.muxer()->open()) {
+        q_ptr->setError(Encoder::FileOpenError, QString(tr("Unable to open: %1")).arg(filePath()));
+        return;
+    }
+
+    m_primaryOutput.start();
+    m_primaryConnected = true;
+
+    if (!startRenditions())
+        return;
+
+    startOutputWriters();
+    resetStatistics();
+    startBitrateAdjustment();
+    openQueues();
+
+    Q_EMIT q_ptr->started();
+    q_ptr->setState(Encoder::ActiveState);
+}
+
+void EncoderPrivate::stop()
+{
+    closeQueues();
+
+    //frames held back by B-frames and lookahead are written before the trailer
+    if (m_primaryOutput.isConnected() || !m_outputWriters.isEmpty() || m_recorder)
+        flushEncoders();
+
+    //all outputs write what is still queued and their trailers
+    m_primaryOutput.stop();
+    stopOutputWriters();
+    stopRenditions();
+
+    Q_EMIT q_ptr->stopped();
+    q_ptr->setState(Encoder::StoppedState);
+
+    cleanup();
+}
+
+void EncoderPrivate::enqueueVideoFrame(const VideoFrame &frame, int pts)
+{
+    if (frame.isNull())
+        return;
+
+    //Encoder::DropNonReference keeps every gop_size-th frame, so an overloaded encoder still gets evenly spaced frames
+    bool reference = (m_queuedFrameCount.fetchAndAddRelaxed(1) % m_referenceInterval) == 0;
+
+    EncoderVideoItem item;
+    item.frame = frame;
+    item.pts = pts;
+    item.enqueueTime = clockUsecs();
+
+    if (m_videoQueue.enqueue(item, reference))
+        scheduleProcessing();
+}
+
+void EncoderPrivate::enqueueAudioData(const QByteArray &data, int pts)
+{
+    EncoderAudioItem item;
+    item.data = data;
+    item.pts = pts;
+    item.enqueueTime = clockUsecs();
+
+    if (m_audioQueue.enqueue(item))
+        scheduleProcessing();
+}
+
+void EncoderPrivate::scheduleProcessing()
+{
+    //only one processing request is posted to the encoder thread at a time
+    if (m_processingScheduled.testAndSetOrdered(0, 1))
+        QMetaObject::invokeMethod(this, "processQueues", Qt::QueuedConnection);
+}
+
+void EncoderPrivate::processQueues()
+{
+    m_processingScheduled.storeRelease(0);
+
+    EncoderVideoItem videoItem;
+    EncoderAudioItem audioItem;
+    bool dequeued;
+
+    do {
+        dequeued = false;
+
+        if (m_audioQueue.tryDequeue(&audioItem)) {
+            dequeued = true;
+            m_audioQueueLatency.addSample(clockUsecs() - audioItem.enqueueTime);
+
+            if (q_ptr->state() == Encoder::ActiveState)
+                encodeAudioData(audioItem.data, audioItem.pts);
+        }
+
+        if (m_videoQueue.tryDequeue(&videoItem)) {
+            dequeued = true;
+            m_videoQueueLatency.addSample(clockUsecs() - videoItem.enqueueTime);
+
+            if (q_ptr->state() == Encoder::ActiveState)
+                encodeVideoFrame(videoItem.frame, videoItem.pts);
+        }
+    } while (dequeued);
+}
+
+void EncoderPrivate::openQueues()
+{
+    m_referenceInterval = m_videoCodecContext && m_videoCodecContext->gop_size > 0 ? m_videoCodecContext->gop_size : 1;
+    m_queuedFrameCount.store(0);
+
+    m_videoQueue.clear();
+    m_audioQueue.clear();
+
+    m_videoQueue.open();
+    m_audioQueue.open();
+}
+
+void EncoderPrivate::closeQueues()
+{
+    m_videoQueue.close();
+    m_audioQueue.close();
+
+    m_videoQueue.clear();
+    m_audioQueue.clear();
+}
+
+void EncoderPrivate::encodeVideoFrame(const VideoFrame &frame, int pts)
+{
+    if (!pts || frame.isNull()) // if pts is -1(fixed fps) or greater than 0
+        return;
+
+    //pts are milliseconds, the codec counts in frames when the frame rate is fixed
+    int64_t framePts = pts < 0 ? (m_lastVideoPts == AV_NOPTS_VALUE ? 0 : m_lastVideoPts + 1)
+                               : av_rescale_q(pts, av_make_q(1, 1000), m_videoCodecContext->time_base);
+
+    //encoders reject timestamps that do not grow, such a frame falls into an already encoded slot
+    if (m_lastVideoPts != AV_NOPTS_VALUE && framePts <= m_lastVideoPts)
+        return;
+
+    adjustBitrate();
+
+    qint64 conversionStart = clockUsecs();
+    AVFrame *picture = fillPicture(frame);
+    if (!picture)
+        return;
+
+    qint64 encodingStart = clockUsecs();
+    m_conversionTime.addSample(encodingStart - conversionStart);
+
+    picture->pts = framePts;
+    //a reconnected or overflowed output waits for a keyframe
+    bool keyframe = m_primaryOutput.isKeyframeRequested();
+
+    //players switch between renditions at keyframes, so all encoders place them at the same pictures
+    if (!m_renditions.isEmpty() && m_videoFrameIndex % m_referenceInterval == 0)
+        keyframe = true;
+
+    picture->pict_type = keyframe ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
+    ++m_videoFrameIndex;
+
+    //the renditions are encoded on the pool while this thread encodes the full size picture
+    encodeRenditions(picture);
+
+    int ret = avcodec_send_frame(m_videoCodecContext, picture);
+
+    if (picture == m_inputFrame)
+        av_frame_unref(m_inputFrame);
+
+    if (ret >= 0) {
+        m_lastVideoPts = framePts;
+        if (pts > 0)
+            m_lastVideoTime.store(pts);
+        m_videoEncodingTime.addSample(clockUsecs() - encodingStart);
+        writePackets(m_videoCodecContext, m_videoStreamIndex);
+    }
+
+    m_renditionPool.waitForDone();
+}
+
+void EncoderPrivate::encodeAudioData(const QByteArray &data, int pts)
+{
+    if (m_audioResampler == NULL)
+        return;
+
+    if (pts >= 0)
+        m_lastAudioTime.store(pts);
+
+    //the input is interleaved, a planar frame takes one plane per channel
+    AVSampleFormat format = static_cast<AVSampleFormat>(m_audioFrame->format);
+    int planeCount = av_sample_fmt_is_planar(format) ? channelCount(m_audioCodecContext) : 1;
+    int outputSampleSize = av_get_bytes_per_sample(format) * channelCount(m_audioCodecContext) / planeCount;
+    QVarLengthArray<uint8_t *, AV_NUM_DATA_POINTERS> output(planeCount);
+
+    //the resampler keeps what does not fit into the frame, a non-NULL input of no samples drains it without flushing
+    const uint8_t *input = reinterpret_cast<const uint8_t *>(data.constData());
+    int inputSamples = data.size() / m_audioInputSampleSize;
+
+    while (true) {
+        //the codec releases the previous frame once it is encoded, so the same buffers are reused
+        if (m_audioFrameFill == 0 && av_frame_make_writable(m_audioFrame) < 0)
+            return;
+
+        for (int i = 0; i < planeCount; ++i)
+            output[i] = m_audioFrame->extended_data[i] + m_audioFrameFill * outputSampleSize;
+
+        int samples = swr_convert(m_audioResampler, output.data(), m_audioFrameSize - m_audioFrameFill, &input, inputSamples);
+        inputSamples = 0;
+        if (samples <= 0)
+            return;
+
+        m_audioFrameFill += samples;
+        if (m_audioFrameFill == m_audioFrameSize) {
+            m_audioFrameFill = 0;
+            if (!encodeAudioFrame(pts))
+                return;
+        }
+    }
+}
+
+bool EncoderPrivate::encodeAudioFrame(int pts)
+{
+    //audio pts count samples, the first frame is aligned to the capture clock
+    if (m_nextAudioPts == AV_NOPTS_VALUE)
+        m_nextAudioPts = av_rescale_q(qMax(pts, 0), av_make_q(1, 1000), m_audioCodecContext->time_base);
+
+    m_audioFrame->pts = m_nextAudioPts;
+    m_nextAudioPts += m_audioFrameSize;
+
+    qint64 encodingStart = clockUsecs();
+    if (avcodec_send_frame(m_audioCodecContext, m_audioFrame) < 0)
+        return true;
+
+    m_audioEncodingTime.addSample(clockUsecs() - encodingStart);
+
+    return writePackets(m_audioCodecContext, m_audioStreamIndex);
+}
+
+bool EncoderPrivate::writePackets(AVCodecContext *context, int streamIndex)
+{
+    //one input frame may produce no packet or several of them
+    while (avcodec_receive_packet(context, m_packet) >= 0) {
+        if (streamIndex == m_videoStreamIndex)
+            m_encodedFrameCount.ref();
+        else
+            m_encodedAudioDataSize.fetchAndAddRelaxed(m_audioSampleSize);
+
+        //all outputs share the packet data
+        m_primaryOutput.writePacket(m_packet, streamIndex, context->time_base);
+
+        for (int i = 0; i < m_outputWriters.size(); ++i)
+            m_outputWriters.at(i)->writePacket(m_packet, streamIndex, context->time_base);
+
+        if (m_recorder)
+            m_recorder->writePacket(m_packet, streamIndex, context->time_base);
+
+        //every rendition is published with the same audio
+        if (streamIndex == m_audioStreamIndex) {
+            for (int i = 0; i < m_renditions.size(); ++i)
+                m_renditions.at(i)->writeAudioPacket(m_packet, context->time_base);
+        }
+
+        av_packet_unref(m_packet);
+
+        //the writer thread reports the state of the output, it is checked with every packet
+        if (m_primaryOutput.hasFailed()) {
+            //the error cleans everything up, nothing may be touched afterwards
+            q_ptr->setError(Encoder::ConnectionLostError, QString(tr("Connection to %1 is lost.")).arg(filePath()));
+            return false;
+        }
+
+        bool connected = m_primaryOutput.isConnected();
+
+        if (m_primaryConnected && !connected)
+            Q_EMIT q_ptr->connectionLost();
+        else if (!m_primaryConnected && connected)
+            Q_EMIT q_ptr->connectionRestored();
+
+        m_primaryConnected = connected;
+    }
+
+    return true;
+}
+
+void EncoderPrivate::flushEncoders()
+{
+    if (m_videoCodecContext != NULL && avcodec_send_frame(m_videoCodecContext, NULL) >= 0) {
+        if (!writePackets(m_videoCodecContext, m_videoStreamIndex))
+            return;
+    }
+
+    for (int i = 0; i < m_renditions.size(); ++i)
+        m_renditions.at(i)->flush();
+
+    if (m_audioCodecContext != NULL && avcodec_send_frame(m_audioCodecContext, NULL) >= 0)
+        writePackets(m_audioCodecContext, m_audioStreamIndex);
+}
+
+void EncoderPrivate::startOutputWriters()
+{
+    QMutexLocker locker(&m_outputsMutex);
+
+    for (int i = 0; i < m_outputSettings.size(); ++i) {
+        const OutputSettings &settings = m_outputSettings.at(i);
+
+        OutputWriter *writer = new OutputWriter();
+        Muxer *muxer = writer->muxer();
+        muxer->setFormatName(formatName(settings.format, settings.url));
+        muxer->setUrl(settings.url);
+        muxer->setOptions(settings.options);
+        muxer->setMaximumReconnectAttempts(m_primaryOutput.muxer()->maximumReconnectAttempts());
+        muxer->setReconnectBufferDuration(m_primaryOutput.muxer()->reconnectBufferDuration());
+
+        //the streams are added in the order of the primary output, so the stream indexes match
+        if (m_videoCodecContext)
+            muxer->addStream(m_videoCodecContext);
+
+        if (m_audioCodecContext)
+            muxer->addStream(m_audioCodecContext);
+
+        writer->start();
+        m_outputWriters.append(writer);
+    }
+
+    if (m_recordingPath.isEmpty())
+        return;
+
+    //a recording is a segmented output, the same packets are archived without encoding them again
+    m_recorder = new OutputWriter();
+    m_recorder->setSegmentLimits(m_recordingSegmentDuration, m_recordingSegmentSize);
+
+    Muxer *muxer = m_recorder->muxer();
+    muxer->setFormatName(formatName(Encoder::AutoFormat, m_recordingPath));
+    muxer->setUrl(m_recordingPath);
+    muxer->setMaximumReconnectAttempts(m_primaryOutput.muxer()->maximumReconnectAttempts());
+    muxer->setReconnectBufferDuration(m_primaryOutput.muxer()->reconnectBufferDuration());
+
+    if (m_videoCodecContext)
+        muxer->addStream(m_videoCodecContext);
+
+    if (m_audioCodecContext)
+        muxer->addStream(m_audioCodecContext);
+
+    m_recorder->start();
+}
+
+void EncoderPrivate::stopOutputWriters()
+{
+    QMutexLocker locker(&m_outputsMutex);
+
+    //each writer stops after its queue is written, a stalled output delays only its own stop
+    for (int i = 0; i < m_outputWriters.size(); ++i)
+        m_outputWriters.at(i)->stop();
+
+    qDeleteAll(m_outputWriters);
+    m_outputWriters.clear();
+
+    //the last segment is finished with its trailer
+    delete m_recorder;
+    m_recorder = NULL;
+}
+
+bool EncoderPrivate::startRenditions()
+{
+    QMutexLocker locker(&m_outputsMutex);
+
+    m_videoFrameIndex = 0;
+
+    if (m_videoCodecContext == NULL)
+        return true;
+
+    for (int i = 0; i < m_renditionSettings.size(); ++i) {
+        const EncoderRendition &settings = m_renditionSettings.at(i);
+
+        AVCodecContext *context = avcodec_alloc_context3(m_videoCodec);
+        if (!context) {
+            locker.unlock();
+            q_ptr->setError(Encoder::InvalidVideoStreamError, tr("Unable to add video stream."));
+            return false;
+        }
+
+        //a rendition differs from the full size video in the picture size and bitrate only
+        context->codec_id = m_videoCodecContext->codec_id;
+        context->codec_type = AVMEDIA_TYPE_VIDEO;
+        context->width = settings.size.width();
+        context->height = settings.size.height();
+        context->pix_fmt = m_videoCodecContext->pix_fmt;
+        context->time_base = m_videoCodecContext->time_base;
+        context->framerate = m_videoCodecContext->framerate;
+
+        applyVideoCodecSettings(context);
+
+        if (m_videoSettings.sceneChangeThreshold() == -1)
+            disableSceneCut(context);
+
+        context->bit_rate = settings.bitrate;
+        if (context->rc_max_rate > 0)
+            context->rc_max_rate = settings.bitrate;
+
+        const AVOutputFormat *format = av_guess_format(formatName(settings.format, settings.url).toUtf8().constData(), NULL, NULL);
+        if (format && (format->flags & AVFMT_GLOBALHEADER))
+            context->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+        if (avcodec_open2(context, m_videoCodec, NULL) < 0) {
+            avcodec_free_context(&context);
+            locker.unlock();
+            q_ptr->setError(Encoder::InvalidVideoCodecError, tr("Unable to open video codec of the %1x%2 rendition.")
+                            .arg(settings.size.width()).arg(settings.size.height()));
+            return false;
+        }
+
+        RenditionEncoder *rendition = new RenditionEncoder();
+        Muxer *muxer = rendition->writer()->muxer();
+        muxer->setFormatName(formatName(settings.format, settings.url));
+        muxer->setUrl(settings.url);
+        muxer->setMaximumReconnectAttempts(m_primaryOutput.muxer()->maximumReconnectAttempts());
+        muxer->setReconnectBufferDuration(m_primaryOutput.muxer()->reconnectBufferDuration());
+
+        //the rendition takes over the codec context even if it fails
+        if (!rendition->open(context, m_audioCodecContext)) {
+            delete rendition;
+            locker.unlock();
+            q_ptr->setError(Encoder::InvalidVideoCodecError, tr("Unable to allocate video frame."));
+            return false;
+        }
+
+        m_renditions.append(rendition);
     }
 
-    avformat_write_header(m_formatContext, 0);
+    //every rendition has a worker, so all of them are encoded at the same time
+    if (!m_renditions.isEmpty())
+        m_renditionPool.setMaxThreadCount(m_renditions.size());
 
-    Q_EMIT q_ptr->started();
-    q_ptr->setState(Encoder::ActiveState);
+    return true;
 }
 
-void EncoderPrivate::stop()
+void EncoderPrivate::stopRenditions()
 {
-    Q_EMIT q_ptr->stopped();
-    q_ptr->setState(Encoder::StoppedState);
+    QMutexLocker locker(&m_outputsMutex);
 
-//    if (m_formatContext) {
-//        av_write_trailer(m_formatContext);
-//    }
+    m_renditionPool.waitForDone();
 
-    cleanup();
+    qDeleteAll(m_renditions);
+    m_renditions.clear();
 }
 
-void EncoderPrivate::encodeVideoFrame(const QImage &frame, int pts)
+void EncoderPrivate::encodeRenditions(const AVFrame *picture)
 {
-    if (pts && !frame.isNull()) { // if pts is -1(fixed fps) or greater than 0
-        if (convertImage(frame)) {
-            int outSize = avcodec_encode_video(m_videoCodecContext, m_videoBuffer, m_videoBufferSize, m_videoPicture);
-
-            if (outSize > 0) {
-                AVPacket pkt;
-                av_init_packet(&pkt);
-
-                pkt.pts = pts;
-                m_videoPicture->pts = pts;
+    //the scaling is shared: the largest rendition is scaled from the picture, each smaller one from the previous
+    const AVFrame *source = picture;
 
-                if(m_videoCodecContext->coded_frame->key_frame)
-                    pkt.flags |= AV_PKT_FLAG_KEY;
+    for (int i = 0; i < m_renditions.size(); ++i) {
+        RenditionEncoder *rendition = m_renditions.at(i);
+        if (!rendition->scale(source))
+            continue;
 
-                pkt.stream_index = m_videoStream->index;
-                pkt.data = m_videoBuffer;
-                pkt.size = outSize;
-                av_write_frame(m_formatContext, &pkt);
+        //a rendition only reads the picture the next one is scaled from
+        rendition->setFrame(picture->pts, picture->pict_type);
+        m_renditionPool.start(rendition);
 
-                QMutexLocker locker(&m_encodedFrameCountMutex);
-                ++m_encodedFrameCount;
-            }
-        }
+        source = rendition->picture();
     }
 }
 
-void EncoderPrivate::encodeAudioData(const QByteArray &data, int pts)
+void EncoderPrivate::startBitrateAdjustment()
 {
-    QByteArray bytesBuffer = data;
-    int bytesReady = data.size();
+    qint64 bytes, writeUsecs;
+    m_primaryOutput.muxer()->takeWriteStatistics(&bytes, &writeUsecs);
 
-    QByteArray samples;
+    m_currentBitrate.store(m_videoCodecContext ? static_cast<int>(m_videoCodecContext->bit_rate) : 0);
 
-    do
-    {
-        samples.clear();
-
-        if (m_audioInputBuffer.size() + bytesReady == m_audioSampleSize) {
-            samples.append(m_audioInputBuffer + bytesBuffer);
-            m_audioInputBuffer.clear();
-        } else if (m_audioInputBuffer.size() + bytesReady > m_audioSampleSize) {
-            m_audioInputBuffer.append(bytesBuffer);
-            samples.append(m_audioInputBuffer.left(m_audioSampleSize));
-            m_audioInputBuffer.remove(0, m_audioSampleSize);
-        } else if (m_audioInputBuffer.size() + bytesReady < m_audioSampleSize) {
-            m_audioInputBuffer.append(bytesBuffer);
-            return;
-        }
+    if (!m_adaptiveBitrate || !m_videoCodecContext)
+        return;
 
-        bytesReady = 0;
-        bytesBuffer.clear();
+    //by default the configured bitrate is the ceiling and a quarter of it the floor
+    int bitrate = static_cast<int>(m_videoCodecContext->bit_rate);
+    m_bitrateController.setRange(m_minimumBitrate != -1 ? m_minimumBitrate : bitrate / 4,
+                                 m_maximumBitrate != -1 ? m_maximumBitrate : bitrate);
+    m_bitrateController.reset(bitrate);
+
+    m_bitrateTimer.start();
+}
 
-        int got_output;
-        AVPacket pkt;
-        AVFrame* frame = av_frame_alloc();
-        av_init_packet(&pkt);
-        pkt.data = m_audioOutputBuffer; // packet data will be allocated by the encoder
-        pkt.size = m_audioOutputBufferSize;
+void EncoderPrivate::adjustBitrate()
+{
+    if (!m_adaptiveBitrate || !m_bitrateTimer.isValid() || m_bitrateTimer.elapsed() < BITRATE_ADJUSTMENT_INTERVAL)
+        return;
 
-        frame->nb_samples     = m_audioCodecContext->frame_size;
-        frame->format         = m_audioCodecContext->sample_fmt;
-        frame->channel_layout = m_audioCodecContext->channel_layout;
-        frame->sample_rate    = m_audioCodecContext->sample_rate;
+    qint64 interval = m_bitrateTimer.nsecsElapsed() / 1000;
+    m_bitrateTimer.restart();
 
-        int buffer_size = av_samples_get_buffer_size(NULL,
-                                                    m_audioCodecContext->channels,
-                                                    m_audioCodecContext->frame_size,
-                                                    m_audioCodecContext->sample_fmt,
-                                                    0);
+    qint64 bytes, writeUsecs;
+    m_primaryOutput.muxer()->takeWriteStatistics(&bytes, &writeUsecs);
 
-        int ret = avcodec_fill_audio_frame(frame, m_audioCodecContext->channels,
-                                           m_audioCodecContext->sample_fmt,
-                                           (const uint8_t*)samples.data(), buffer_size, 0);
+    //an outage is handled by reconnecting, it says nothing about the uplink capacity
+    if (!m_primaryOutput.isConnected())
+        return;
 
-        ret = avcodec_encode_audio2(m_audioStream->codec, &pkt, frame, &got_output);
+    if (m_bitrateController.update(bytes, writeUsecs, interval)) {
+        int bitrate = m_bitrateController.bitrate();
 
-        if (got_output) {
-            pkt.pts = m_videoPicture ? m_videoPicture->pts : pts;
-            pkt.flags |= AV_PKT_FLAG_KEY;
+        //encoders reconfiguring rate control at run time (libx264) pick the change up with the next frame
+        m_videoCodecContext->bit_rate = bitrate;
+        if (m_videoCodecContext->rc_max_rate > 0)
+            m_videoCodecContext->rc_max_rate = bitrate;
 
-            pkt.stream_index = m_audioStream->index;
-            av_write_frame(m_formatContext, &pkt);
+        m_currentBitrate.store(bitrate);
+        Q_EMIT q_ptr->bitrateChanged(bitrate);
+    }
+}
 
-            QMutexLocker locker(&m_encodedAudioDataSizeMutex);
-            m_encodedAudioDataSize += m_audioSampleSize;
+void EncoderPrivate::resetStatistics()
+{
+    m_encodedFrameCount.store(0);
+    m_encodedAudioDataSize.store(0);
+    m_lastVideoTime.store(0);
+    m_lastAudioTime.store(0);
 
-            av_free_packet(&pkt);
-        }
+    m_videoQueueLatency.reset();
+    m_audioQueueLatency.reset();
+    m_conversionTime.reset();
+    m_videoEncodingTime.reset();
+    m_audioEncodingTime.reset();
+}
 
-        av_frame_free(&frame);
-    } while (m_audioInputBuffer.size() > m_audioSampleSize);
+qint64 EncoderPrivate::clockUsecs() const
+{
+    return m_clock.nsecsElapsed() / 1000;
 }
 
 void EncoderPrivate::onError()
 {
+    closeQueues();
+
     q_ptr->setState(Encoder::StoppedState);
 
     cleanup();
@@ -479,31 +1496,44 @@ void EncoderPrivate::initData()
 
     m_fixedFrameRate = -1;
     m_encodingMode = Encoder::VideoAudioMode;
+    m_outputFormatType = Encoder::AutoFormat;
+
+    m_overflowPolicy = Encoder::DropOldest;
+    m_referenceInterval = 1;
+
+    m_adaptiveBitrate = false;
+    m_minimumBitrate = -1;
+    m_maximumBitrate = -1;
+
+    m_recordingSegmentDuration = DEFAULT_RECORDING_SEGMENT_DURATION;
+    m_recordingSegmentSize = 0;
 }
 
 void EncoderPrivate::initFfmpegStuff()
 {
-    m_pts = 0;
-    m_encodedFrameCount = 0;
-    m_encodedAudioDataSize = 0;
+    m_lastVideoPts = AV_NOPTS_VALUE;
+    m_nextAudioPts = AV_NOPTS_VALUE;
+    m_videoFrameIndex = 0;
+    m_primaryConnected = false;
 
     //video stuff
     m_outputFormat = NULL;
-    m_formatContext = NULL;
-    m_videoStream = NULL;
+    m_videoStreamIndex = -1;
     m_videoCodecContext = NULL;
     m_videoCodec = NULL;
-    m_videoBufferSize = 0;
-    m_videoBuffer = 0;
-    m_pictureBuffer = 0;
+    m_inputFrame = NULL;
+    m_packet = NULL;
 
     //audio stuff
-    m_audioStream = NULL;
+    m_audioStreamIndex = -1;
     m_audioCodecContext = NULL;
     m_audioCodec = NULL;
-    m_audioOutputBufferSize = 0;
+    m_audioFrameSize = 0;
+    m_audioFrameFill = 0;
     m_audioSampleSize = 0;
-    m_audioOutputBuffer = 0;
+    m_audioInputSampleSize = 0;
+    m_audioFrame = NULL;
+    m_audioResampler = NULL;
 
     m_imageConvertContext = NULL;
     m_videoPicture = NULL;
@@ -512,69 +1542,78 @@ void EncoderPrivate::initFfmpegStuff()
 void EncoderPrivate::cleanup()
 {
     //close codecs
-    if (m_videoCodecContext != NULL) {
-        avcodec_close(m_videoCodecContext);
-        av_free(m_videoCodecContext);
-    }
-
-    if (m_audioCodecContext != NULL) {
-        avcodec_close(m_audioCodecContext);
-        av_free(m_audioCodecContext);
-    }
+    if (m_videoCodecContext != NULL)
+        avcodec_free_context(&m_videoCodecContext);
 
-    if (m_videoStream != NULL)
-        av_free(m_videoStream);
-
-    if (m_audioStream != NULL)
-        av_free(m_audioStream);
+    if (m_audioCodecContext != NULL)
+        avcodec_free_context(&m_audioCodecContext);
 
     //remove subsidiary objects
     if (m_imageConvertContext != NULL)
         sws_freeContext(m_imageConvertContext);
 
-    if (m_videoBuffer)
-        delete[] m_videoBuffer;
+    if (m_videoPicture != NULL)
+        av_frame_free(&m_videoPicture);
 
-    if (m_pictureBuffer)
-        delete[] m_pictureBuffer;
+    if (m_inputFrame != NULL)
+        av_frame_free(&m_inputFrame);
 
-    if (m_audioOutputBuffer)
-        delete[] m_audioOutputBuffer;
+    if (m_audioFrame != NULL)
+        av_frame_free(&m_audioFrame);
 
-    if (m_videoPicture != NULL)
-        av_free(m_videoPicture);
+    if (m_audioResampler != NULL)
+        swr_free(&m_audioResampler);
 
-    if (m_formatContext != NULL) {
-        avio_close(m_formatContext->pb);
-        av_free(m_formatContext);
-    }
+    m_audioFrameFill = 0;
+
+    if (m_packet != NULL)
+        av_packet_free(&m_packet);
+
+    m_primaryOutput.stop();
+    m_primaryOutput.muxer()->reset();
+    stopOutputWriters();
+    stopRenditions();
+    m_bitrateTimer.invalidate();
 
     initFfmpegStuff();
 }
 
 bool EncoderPrivate::createVideoStream()
 {
-    m_videoStream = avformat_new_stream(m_formatContext, 0);
-    if(!m_videoStream ) {
-        q_ptr->setError(Encoder::InvalidVideoStreamError, tr("Unable to add video stream."));
+    AVCodecID codecId = (videoCodec() == EncoderGlobal::DEFAULT_VIDEO_CODEC) ? m_outputFormat->video_codec : static_cast<AVCodecID>(videoCodec());
+
+    m_videoCodec = avcodec_find_encoder(codecId);
+    if (!m_videoCodec) {
+        q_ptr->setError(Encoder::VideoEncoderNotFoundError, tr("Unable to find video encoder by codec id."));
         return false;
     }
 
     //set up codec
-    m_videoCodecContext = m_videoStream->codec;
-    m_videoCodecContext->codec_id = (videoCodec() == EncoderGlobal::DEFAULT_VIDEO_CODEC) ? m_outputFormat->video_codec : static_cast<AVCodecID>(videoCodec());
+    m_videoCodecContext = avcodec_alloc_context3(m_videoCodec);
+    if (!m_videoCodecContext) {
+        q_ptr->setError(Encoder::InvalidVideoStreamError, tr("Unable to add video stream."));
+        return false;
+    }
+
+    m_videoCodecContext->codec_id = codecId;
     m_videoCodecContext->codec_type = AVMEDIA_TYPE_VIDEO;
     m_videoCodecContext->width = videoSize().width();
     m_videoCodecContext->height = videoSize().height();
-    m_videoCodecContext->pix_fmt = static_cast<AVPixelFormat>(outputPixelFormat());
+    m_videoCodecContext->pix_fmt = toAVPixelFormat(outputPixelFormat());
 
     m_videoCodecContext->time_base.den = fixedFrameRate() != -1 ? fixedFrameRate() : 1000;
     m_videoCodecContext->time_base.num = 1;
 
-    m_videoStream->time_base.den = fixedFrameRate() != -1 ? fixedFrameRate() : 1000;
-    m_videoStream->time_base.num = 1;
+    if (isFixedFrameRate())
+        m_videoCodecContext->framerate = av_make_q(fixedFrameRate(), 1);
+
+    applyVideoCodecSettings(m_videoCodecContext);
+
+    if (!m_renditionSettings.isEmpty() && m_videoSettings.sceneChangeThreshold() == -1)
+        disableSceneCut(m_videoCodecContext);
 
-    applyVideoCodecSettings();
+    if (m_outputFormat->flags & AVFMT_GLOBALHEADER)
+        m_videoCodecContext->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
 
     return true;
 }
@@ -587,200 +1626,254 @@ bool EncoderPrivate::createAudioStream()
                 static_cast<AVCodecID>(audioCodec());
 
     /* find the encoder */
-    AVCodec *codec = avcodec_find_encoder(codec_id);
+    m_audioCodec = avcodec_find_encoder(codec_id);
 
-    if (!codec) {
+    if (!m_audioCodec) {
         q_ptr->setError(Encoder::InvalidAudioStreamError, tr("Unable to add audio stream."));
         return false;
     }
 
-    m_audioStream = avformat_new_stream(m_formatContext, codec);
-    if (!m_audioStream) {
+    //set up codec
+    m_audioCodecContext = avcodec_alloc_context3(m_audioCodec);
+    if (!m_audioCodecContext) {
         q_ptr->setError(Encoder::InvalidAudioStreamError, tr("Unable to add audio stream."));
         return false;
     }
 
-    //set up codec
-    m_audioCodecContext = m_audioStream->codec;
     m_audioCodecContext->codec_id = codec_id;
     m_audioCodecContext->codec_type = AVMEDIA_TYPE_AUDIO;
 
-//    m_audioStream->time_base = (AVRational){ 1, fixedFrameRate() * 2 };
-//    m_audioCodecContext->time_base = (AVRational){ 1, fixedFrameRate() * 2 };
-
     applyAudioCodecSettings();
 
+    //audio timestamps count samples
+    if (m_audioCodecContext->sample_rate > 0)
+        m_audioCodecContext->time_base = av_make_q(1, m_audioCodecContext->sample_rate);
+
+    if (m_outputFormat->flags & AVFMT_GLOBALHEADER)
+        m_audioCodecContext->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
     return true;
 }
 
 bool EncoderPrivate::openVideoStream()
 {
-    m_videoCodec = avcodec_find_encoder(m_videoCodecContext->codec_id);
-    if (!m_videoCodec) {
-        q_ptr->setError(Encoder::VideoEncoderNotFoundError, tr("Unable to find video encoder by codec id."));
-        return false;
-    }
-
     // open the codec
     if (avcodec_open2(m_videoCodecContext, m_videoCodec, NULL) < 0) {
         q_ptr->setError(Encoder::InvalidVideoCodecError, tr("Unable to open video codec."));
         return false;
     }
 
-    //allocate frame buffer
-    m_videoBufferSize = videoSize().width() * videoSize().height() * 1.5;
-    m_videoBuffer = new uint8_t[m_videoBufferSize];
+    m_videoStreamIndex = m_primaryOutput.muxer()->addStream(m_videoCodecContext);
 
-    //init frame
+    //m_videoPicture receives converted pictures, m_inputFrame wraps pictures already in the codec format
     m_videoPicture = av_frame_alloc();
+    m_videoPicture->format = m_videoCodecContext->pix_fmt;
+    m_videoPicture->width = m_videoCodecContext->width;
+    m_videoPicture->height = m_videoCodecContext->height;
 
-    int size = avpicture_get_size(m_videoCodecContext->pix_fmt, m_videoCodecContext->width, m_videoCodecContext->height);
-    m_pictureBuffer = new uint8_t[size];
+    if (av_frame_get_buffer(m_videoPicture, 32) < 0) {
+        q_ptr->setError(Encoder::InvalidVideoCodecError, tr("Unable to allocate video frame."));
+        return false;
+    }
 
-    // Setup the planes
-    avpicture_fill((AVPicture *)m_videoPicture, m_pictureBuffer,m_videoCodecContext->pix_fmt, m_videoCodecContext->width, m_videoCodecContext->height);
+    m_inputFrame = av_frame_alloc();
 
     return true;
 }
 
 bool EncoderPrivate::openAudioStream()
 {
-    m_audioCodec = avcodec_find_encoder(m_audioCodecContext->codec_id);
-    if (!m_audioCodec) {
-        q_ptr->setError(Encoder::AudioEncoderNotFoundError, tr("Unable to find audio encoder by codec id."));
-        return false;
-    }
-
     // open the codec
     if (avcodec_open2(m_audioCodecContext, m_audioCodec, NULL) < 0) {
         q_ptr->setError(Encoder::InvalidAudioCodecError, tr("Unable to open audio codec."));
         return false;
     }
 
-    m_audioOutputBufferSize = MAX_AUDIO_FRAME_SIZE;
-    m_audioOutputBuffer = new uint8_t[m_audioOutputBufferSize];
+    m_audioStreamIndex = m_primaryOutput.muxer()->addStream(m_audioCodecContext);
 
-    m_audioSampleSize = 2 * m_audioStream->codec->frame_size * m_audioStream->codec->channels;
+    //codecs accepting any frame size report 0
+    m_audioFrameSize = m_audioCodecContext->frame_size > 0 ? m_audioCodecContext->frame_size : DEFAULT_AUDIO_FRAME_SIZE;
+    m_audioSampleSize = av_samples_get_buffer_size(NULL, channelCount(m_audioCodecContext), m_audioFrameSize,
+                                                   m_audioCodecContext->sample_fmt, 1);
 
-    return true;
-}
+    //one frame is allocated here and reused for every encoded frame
+    m_audioFrame = av_frame_alloc();
+    m_audioFrame->nb_samples = m_audioFrameSize;
+    m_audioFrame->format = m_audioCodecContext->sample_fmt;
+    m_audioFrame->sample_rate = m_audioCodecContext->sample_rate;
+#ifdef ENCODER_CHANNEL_LAYOUT_API
+    av_channel_layout_copy(&m_audioFrame->ch_layout, &m_audioCodecContext->ch_layout);
+#else
+    m_audioFrame->channels = m_audioCodecContext->channels;
+    m_audioFrame->channel_layout = m_audioCodecContext->channel_layout;
+#endif
 
-bool EncoderPrivate::convertImage(const QImage &image)
-{
-    EncoderGlobal::EncoderPixelFormat inputFormat = convertImagePixelFormat(image.format());
-    if (inputFormat == EncoderGlobal::PIXEL_FORMAT_NONE) {
-        q_ptr->setError(Encoder::InvalidInputPixelFormat, tr("Could not convert input pixel format to the ffmpeg's format."));
+    if (av_frame_get_buffer(m_audioFrame, 0) < 0) {
+        q_ptr->setError(Encoder::InvalidAudioCodecError, tr("Unable to allocate audio frame."));
         return false;
     }
 
-    m_imageConvertContext = sws_getCachedContext(m_imageConvertContext, image.width(), image.height(),
-                         (AVPixelFormat)inputFormat, image.width(), image.height(),
-                                                 m_videoCodecContext->pix_fmt, SWS_BICUBIC, NULL, NULL, NULL);
+    return openAudioResampler();
+}
 
-    if (m_imageConvertContext == NULL) {
-        q_ptr->setError(Encoder::InvalidConversionContext, tr("Could not initialize conversion context."));
+bool EncoderPrivate::openAudioResampler()
+{
+    AVSampleFormat inputFormat = toAVSampleFormat(m_audioInputFormat.format());
+    if (inputFormat == AV_SAMPLE_FMT_NONE) {
+        q_ptr->setError(Encoder::InvalidAudioCodecError, tr("Unsupported audio input format."));
         return false;
     }
 
-    uint8_t *srcplanes[3];
-    srcplanes[0]=(uint8_t*)image.bits();
-    srcplanes[1]=0;
-    srcplanes[2]=0;
-
-    int srcstride[3];
-    srcstride[0]=image.bytesPerLine();
-    srcstride[1]=0;
-    srcstride[2]=0;
+    int inputRate = m_audioInputFormat.sampleRate() > 0 ? m_audioInputFormat.sampleRate()
+                                                        : m_audioCodecContext->sample_rate;
+    int inputChannels = m_audioInputFormat.channelCount() > 0 ? m_audioInputFormat.channelCount()
+                                                              : channelCount(m_audioCodecContext);
+    m_audioInputSampleSize = av_get_bytes_per_sample(inputFormat) * inputChannels;
+
+    //the resampler is cached for the whole session, it converts the format, rate and channels at once
+#ifdef ENCODER_CHANNEL_LAYOUT_API
+    AVChannelLayout inputLayout;
+    av_channel_layout_default(&inputLayout, inputChannels);
+    swr_alloc_set_opts2(&m_audioResampler, &m_audioCodecContext->ch_layout, m_audioCodecContext->sample_fmt,
+                        m_audioCodecContext->sample_rate, &inputLayout, inputFormat, inputRate, 0, NULL);
+    av_channel_layout_uninit(&inputLayout);
+#else
+    m_audioResampler = swr_alloc_set_opts(NULL, m_audioCodecContext->channel_layout, m_audioCodecContext->sample_fmt,
+                                          m_audioCodecContext->sample_rate, av_get_default_channel_layout(inputChannels),
+                                          inputFormat, inputRate, 0, NULL);
+#endif
 
-    sws_scale(m_imageConvertContext, srcplanes, srcstride,0, image.height(), m_videoPicture->data, m_videoPicture->linesize);
+    if (m_audioResampler == NULL || swr_init(m_audioResampler) < 0) {
+        q_ptr->setError(Encoder::InvalidAudioCodecError, tr("Unable to convert audio input format."));
+        return false;
+    }
 
     return true;
 }
 
-EncoderGlobal::EncoderPixelFormat EncoderPrivate::convertImagePixelFormat(QImage::Format format) const
+AVFrame *EncoderPrivate::fillPicture(const VideoFrame &frame)
 {
-    EncoderGlobal::EncoderPixelFormat newFormat;
+    AVPixelFormat inputFormat = toAVPixelFormat(frame.pixelFormat());
+    if (inputFormat == AV_PIX_FMT_NONE) {
+        q_ptr->setError(Encoder::InvalidInputPixelFormat, tr("Could not convert input pixel format to the ffmpeg's format."));
+        return NULL;
+    }
 
-    switch (format) {
-    case QImage::Format_ARGB32:
-    case QImage::Format_ARGB32_Premultiplied:
-    case QImage::Format_RGB32:
-        newFormat = EncoderGlobal::BGRA;
-        break;
+    //a frame already in the codec format and size is encoded from its own planes without any copy
+    if (inputFormat == m_videoCodecContext->pix_fmt
+            && frame.width() == m_videoCodecContext->width && frame.height() == m_videoCodecContext->height) {
+        m_inputFrame->format = inputFormat;
+        m_inputFrame->width = frame.width();
+        m_inputFrame->height = frame.height();
+
+        for (int i = 0; i < VIDEOFRAME_MAX_PLANES; ++i) {
+            m_inputFrame->data[i] = const_cast<uint8_t *>(frame.constBits(i));
+            m_inputFrame->linesize[i] = frame.bytesPerLine(i);
+        }
 
-    case QImage::Format_RGB16:
-        newFormat = EncoderGlobal::RGB565LE;
-        break;
+        //the codec may hold the picture for lookahead, the buffer keeps a frame copy until the codec releases it
+        m_inputFrame->buf[0] = av_buffer_create(m_inputFrame->data[0], frame.bytesPerLine(0) * frame.height(),
+                                                releaseVideoFrame, new VideoFrame(frame), AV_BUFFER_FLAG_READONLY);
 
-    case QImage::Format_RGB888:
-        newFormat = EncoderGlobal::RGB24;
-        break;
+        return m_inputFrame;
+    }
 
-    case QImage::Format_Mono:
-    case QImage::Format_MonoLSB:
-        newFormat = EncoderGlobal::MONOWHITE;
-        break;
+    //the codec may still refer to the previous picture, a new buffer is taken then
+    if (av_frame_make_writable(m_videoPicture) < 0)
+        return NULL;
 
-    default:
-        newFormat = EncoderGlobal::PIXEL_FORMAT_NONE;
-        break;
+    m_imageConvertContext = sws_getCachedContext(m_imageConvertContext, frame.width(), frame.height(),
+                         inputFormat, m_videoCodecContext->width, m_videoCodecContext->height,
+                                                 m_videoCodecContext->pix_fmt, SWS_BICUBIC, NULL, NULL, NULL);
+
+    if (m_imageConvertContext == NULL) {
+        q_ptr->setError(Encoder::InvalidConversionContext, tr("Could not initialize conversion context."));
+        return NULL;
+    }
+
+    const uint8_t *srcplanes[VIDEOFRAME_MAX_PLANES];
+    int srcstride[VIDEOFRAME_MAX_PLANES];
+    for (int i = 0; i < VIDEOFRAME_MAX_PLANES; ++i) {
+        srcplanes[i] = frame.constBits(i);
+        srcstride[i] = frame.bytesPerLine(i);
     }
 
-    return newFormat;
+    sws_scale(m_imageConvertContext, srcplanes, srcstride, 0, frame.height(), m_videoPicture->data, m_videoPicture->linesize);
+
+    return m_videoPicture;
 }
 
-void EncoderPrivate::applyVideoCodecSettings()
+void EncoderPrivate::applyVideoCodecSettings(AVCodecContext *context)
 {
-    setVideoCodecOption<int, int>(&AVCodecContext::bit_rate, &VideoCodecSettings::bitrate);
-    setVideoCodecOption<int, int>(&AVCodecContext::gop_size, &VideoCodecSettings::gopSize);
-    setVideoCodecOption<int, int>(&AVCodecContext::qmin, &VideoCodecSettings::minimumQuantizer);
-    setVideoCodecOption<int, int>(&AVCodecContext::qmax, &VideoCodecSettings::minimumQuantizer);
-    setVideoCodecOption<int, int>(&AVCodecContext::max_qdiff, &VideoCodecSettings::maximumQuantizerDifference);
-    setVideoCodecOption<int, EncoderGlobal::CoderType>(&AVCodecContext::coder_type, &VideoCodecSettings::coderType);
-    setVideoCodecOption<int, int>(&AVCodecContext::me_cmp, &VideoCodecSettings::motionEstimationComparison);
-    setVideoCodecOption<int, EncoderGlobal::MotionEstimationAlgorithm>(&AVCodecContext::me_method, &VideoCodecSettings::motionEstimationMethod);
-    setVideoCodecOption<int, int>(&AVCodecContext::me_subpel_quality, &VideoCodecSettings::subpixelMotionEstimationQuality);
-    setVideoCodecOption<int, int>(&AVCodecContext::me_range, &VideoCodecSettings::motionEstimationRange);
-    setVideoCodecOption<int, int>(&AVCodecContext::keyint_min, &VideoCodecSettings::minimumKeyframeInterval);
-    setVideoCodecOption<int, int>(&AVCodecContext::scenechange_threshold, &VideoCodecSettings::sceneChangeThreshold);
-    setVideoCodecOption<float, float>(&AVCodecContext::i_quant_factor, &VideoCodecSettings::iQuantFactor);
-    setVideoCodecOption<int, int>(&AVCodecContext::b_frame_strategy, &VideoCodecSettings::bFrameStrategy);
-    setVideoCodecOption<float, float>(&AVCodecContext::qcompress, &VideoCodecSettings::quantizerCurveCompressionFactor);
-    setVideoCodecOption<int, int>(&AVCodecContext::max_b_frames, &VideoCodecSettings::maximumBFrames);
-    setVideoCodecOption<int, int>(&AVCodecContext::refs, &VideoCodecSettings::referenceFrameCount);
-    setVideoCodecOption<int, int>(&AVCodecContext::trellis, &VideoCodecSettings::trellis);
-    setVideoCodecOption<int, EncoderGlobal::Flags>(&AVCodecContext::flags, &VideoCodecSettings::flags);
-    setVideoCodecOption<int, EncoderGlobal::Flags2>(&AVCodecContext::flags2, &VideoCodecSettings::flags2);
+    setVideoCodecOption<int64_t, int>(context, &AVCodecContext::bit_rate, &VideoCodecSettings::bitrate);
+    setVideoCodecOption<int, int>(context, &AVCodecContext::gop_size, &VideoCodecSettings::gopSize);
+    setVideoCodecOption<int, int>(context, &AVCodecContext::qmin, &VideoCodecSettings::minimumQuantizer);
+    setVideoCodecOption<int, int>(context, &AVCodecContext::qmax, &VideoCodecSettings::minimumQuantizer);
+    setVideoCodecOption<int, int>(context, &AVCodecContext::max_qdiff, &VideoCodecSettings::maximumQuantizerDifference);
+    setVideoCodecOption<int, int>(context, &AVCodecContext::me_cmp, &VideoCodecSettings::motionEstimationComparison);
+    setVideoCodecOption<int, int>(context, &AVCodecContext::me_subpel_quality, &VideoCodecSettings::subpixelMotionEstimationQuality);
+    setVideoCodecOption<int, int>(context, &AVCodecContext::me_range, &VideoCodecSettings::motionEstimationRange);
+    setVideoCodecOption<int, int>(context, &AVCodecContext::keyint_min, &VideoCodecSettings::minimumKeyframeInterval);
+    setVideoCodecOption<float, float>(context, &AVCodecContext::i_quant_factor, &VideoCodecSettings::iQuantFactor);
+    setVideoCodecOption<float, float>(context, &AVCodecContext::qcompress, &VideoCodecSettings::quantizerCurveCompressionFactor);
+    setVideoCodecOption<int, int>(context, &AVCodecContext::max_b_frames, &VideoCodecSettings::maximumBFrames);
+    setVideoCodecOption<int, int>(context, &AVCodecContext::refs, &VideoCodecSettings::referenceFrameCount);
+    setVideoCodecOption<int, int>(context, &AVCodecContext::trellis, &VideoCodecSettings::trellis);
+    setVideoCodecOption<int, EncoderGlobal::Flags>(context, &AVCodecContext::flags, &VideoCodecSettings::flags);
+    setVideoCodecOption<int, EncoderGlobal::Flags2>(context, &AVCodecContext::flags2, &VideoCodecSettings::flags2);
+
+    //these fields were moved from AVCodecContext to the private options of the encoders
+    setVideoCodecPrivateOption(context, "coder", m_videoSettings.coderType());
+    setVideoCodecPrivateOption(context, "sc_threshold", m_videoSettings.sceneChangeThreshold());
+    setVideoCodecPrivateOption(context, "b_strategy", m_videoSettings.bFrameStrategy());
+
+    if (m_videoSettings.motionEstimationMethod() != -1) {
+        const char *x264Method = motionEstimationName(m_videoSettings.motionEstimationMethod(), true);
+        const char *mpegMethod = motionEstimationName(m_videoSettings.motionEstimationMethod(), false);
 
-    av_opt_set(m_videoCodecContext->priv_data, "preset", "ultrafast", 1);
-    av_opt_set(m_videoCodecContext->priv_data, "tune", "zerolatency", 0);
+        if (x264Method)
+            av_opt_set(context, "motion-est", x264Method, AV_OPT_SEARCH_CHILDREN);
 
-    m_videoCodecContext->delay = 0;
-    m_videoCodecContext->debug_mv = 0;
-    m_videoCodecContext->thread_count = 1;
+        if (mpegMethod)
+            av_opt_set(context, "motion_est", mpegMethod, AV_OPT_SEARCH_CHILDREN);
+    }
+
+    av_opt_set(context->priv_data, "preset", "ultrafast", 1);
+    av_opt_set(context->priv_data, "tune", "zerolatency", 0);
+
+    //slice threading spreads every frame over all cores without adding the frame delay of frame threading
+    context->thread_count = QThread::idealThreadCount() > 0 ? QThread::idealThreadCount() : 0;
+    context->thread_type = FF_THREAD_SLICE;
+    setVideoCodecOption<int, int>(context, &AVCodecContext::thread_count, &VideoCodecSettings::threadCount);
+    setVideoCodecOption<int, EncoderGlobal::ThreadType>(context, &AVCodecContext::thread_type, &VideoCodecSettings::threadType);
 }
 
 template <class T1, class T2>
-void EncoderPrivate::setVideoCodecOption(T1 AVCodecContext::*option, T2 (VideoCodecSettings::*f)() const)
+void EncoderPrivate::setVideoCodecOption(AVCodecContext *context, T1 AVCodecContext::*option, T2 (VideoCodecSettings::*f)() const)
 {
     T2 value = (m_videoSettings.*f)();
     if (value != -1) {
-        m_videoCodecContext->*option = (m_videoSettings.*f)();
+        context->*option = (m_videoSettings.*f)();
     }
 }
 
+void EncoderPrivate::setVideoCodecPrivateOption(AVCodecContext *context, const char *name, int value)
+{
+    //encoders without the option ignore it
+    if (value != -1)
+        av_opt_set_int(context, name, value, AV_OPT_SEARCH_CHILDREN);
+}
+
 void EncoderPrivate::applyAudioCodecSettings()
 {
     if (m_audioSettings.sampleFormat() != -1) {
         m_audioCodecContext->sample_fmt = static_cast<AVSampleFormat>(m_audioSettings.sampleFormat());
     }
 
-    m_audioCodecContext->channel_layout = AV_CH_LAYOUT_MONO;
-    m_audioCodecContext->flags = CODEC_FLAG_GLOBAL_HEADER;
+    setChannelCount(m_audioCodecContext, m_audioSettings.channelCount() != -1 ? m_audioSettings.channelCount() : 1);
 
-    setAudioCodecOption<int, int>(&AVCodecContext::bit_rate, &AudioCodecSettings::bitrate);
+    setAudioCodecOption<int64_t, int>(&AVCodecContext::bit_rate, &AudioCodecSettings::bitrate);
     setAudioCodecOption<int, int>(&AVCodecContext::sample_rate, &AudioCodecSettings::sampleRate);
-    setAudioCodecOption<int, int>(&AVCodecContext::channels, &AudioCodecSettings::channelCount);
 }
 
 template <class T1, class T2>
@@ -802,14 +1895,21 @@ Encoder::Encoder(QObject *parent) :
     QObject(parent)
   , d_ptr(new EncoderPrivate(this))
   , m_encoderThread(new QThread(this))
+  , m_statisticsTimer(new QTimer(this))
   , m_state(Encoder::StoppedState)
   , m_error(Encoder::NoError)
 {
     qRegisterMetaType<Encoder::Error>("Encoder::Error");
     qRegisterMetaType<Encoder::State>("Encoder::State");
+    qRegisterMetaType<VideoFrame>("VideoFrame");
 
     d_ptr->moveToThread(m_encoderThread);
     m_encoderThread->start();
+
+    //the state is changed from the encoding thread, so the timer is started through a queued call
+    m_statisticsTimer->setInterval(DEFAULT_STATISTICS_INTERVAL);
+    connect(m_statisticsTimer, SIGNAL(timeout()), this, SLOT(emitStatistics()));
+    connect(this, SIGNAL(stateChanged(Encoder::State)), this, SLOT(updateStatisticsTimer()), Qt::QueuedConnection);
 }
 
 Encoder::~Encoder()
@@ -830,6 +1930,89 @@ QString Encoder::filePath() const
     return d_ptr->filePath();
 }
 
+void Encoder::setOutputFormat(Encoder::OutputFormat format)
+{
+    if (state() != Encoder::ActiveState)
+        d_ptr->setOutputFormat(format);
+}
+
+Encoder::OutputFormat Encoder::outputFormat() const
+{
+    return d_ptr->outputFormat();
+}
+
+void Encoder::setOutputOptions(const QVariantMap &options)
+{
+    if (state() != Encoder::ActiveState)
+        d_ptr->setOutputOptions(options);
+}
+
+QVariantMap Encoder::outputOptions() const
+{
+    return d_ptr->outputOptions();
+}
+
+void Encoder::addOutput(const QString &url, Encoder::OutputFormat format, const QVariantMap &options)
+{
+    if (state() != Encoder::ActiveState)
+        d_ptr->addOutput(url, format, options);
+}
+
+void Encoder::clearOutputs()
+{
+    if (state() != Encoder::ActiveState)
+        d_ptr->clearOutputs();
+}
+
+QStringList Encoder::outputUrls() const
+{
+    return d_ptr->outputUrls();
+}
+
+void Encoder::setRecordingPath(const QString &path)
+{
+    if (state() != Encoder::ActiveState)
+        d_ptr->setRecordingPath(path);
+}
+
+QString Encoder::recordingPath() const
+{
+    return d_ptr->recordingPath();
+}
+
+void Encoder::setRecordingSegmentLimits(int msecs, qint64 bytes)
+{
+    if (state() != Encoder::ActiveState)
+        d_ptr->setRecordingSegmentLimits(msecs, bytes);
+}
+
+int Encoder::recordingSegmentDuration() const
+{
+    return d_ptr->recordingSegmentDuration();
+}
+
+qint64 Encoder::recordingSegmentSize() const
+{
+    return d_ptr->recordingSegmentSize();
+}
+
+void Encoder::addRendition(const QSize &size, int bitrate, const QString &url, Encoder::OutputFormat format)
+{
+    if (state() != Encoder::ActiveState)
+        d_ptr->addRendition(size, bitrate, url, format);
+}
+
+void Encoder::clearRenditions()
+{
+    if (state() != Encoder::ActiveState)
+        d_ptr->clearRenditions();
+}
+
+int Encoder::renditionCount() const
+{
+    return d_ptr->renditionCount();
+}
+
 void Encoder::setVideoSize(const QSize &size)
 {
     if (state() != Encoder::ActiveState)
@@ -918,6 +2101,125 @@ AudioCodecSettings Encoder::audioCodecSettings() const
     return d_ptr->audioCodecSettings();
 }
 
+void Encoder::setAudioInputFormat(const AudioFormat &format)
+{
+    if (state() != Encoder::ActiveState)
+        d_ptr->setAudioInputFormat(format);
+}
+
+AudioFormat Encoder::audioInputFormat() const
+{
+    return d_ptr->audioInputFormat();
+}
+
+void Encoder::setVideoQueueCapacity(int capacity)
+{
+    if (state() != Encoder::ActiveState)
+        d_ptr->setVideoQueueCapacity(capacity);
+}
+
+int Encoder::videoQueueCapacity() const
+{
+    return d_ptr->videoQueueCapacity();
+}
+
+void Encoder::setAudioQueueCapacity(int capacity)
+{
+    if (state() != Encoder::ActiveState)
+        d_ptr->setAudioQueueCapacity(capacity);
+}
+
+int Encoder::audioQueueCapacity() const
+{
+    return d_ptr->audioQueueCapacity();
+}
+
+void Encoder::setOutputQueueCapacity(int capacity)
+{
+    if (state() != Encoder::ActiveState)
+        d_ptr->setOutputQueueCapacity(capacity);
+}
+
+int Encoder::outputQueueCapacity() const
+{
+    return d_ptr->outputQueueCapacity();
+}
+
+void Encoder::setOverflowPolicy(Encoder::OverflowPolicy policy)
+{
+    if (state() != Encoder::ActiveState)
+        d_ptr->setOverflowPolicy(policy);
+}
+
+Encoder::OverflowPolicy Encoder::overflowPolicy() const
+{
+    return d_ptr->overflowPolicy();
+}
+
+int Encoder::droppedVideoFrameCount() const
+{
+    return d_ptr->droppedVideoFrameCount();
+}
+
+int Encoder::droppedAudioChunkCount() const
+{
+    return d_ptr->droppedAudioChunkCount();
+}
+
+void Encoder::setMaximumReconnectAttempts(int count)
+{
+    if (state() != Encoder::ActiveState)
+        d_ptr->setMaximumReconnectAttempts(count);
+}
+
+int Encoder::maximumReconnectAttempts() const
+{
+    return d_ptr->maximumReconnectAttempts();
+}
+
+void Encoder::setReconnectBufferDuration(int msecs)
+{
+    if (state() != Encoder::ActiveState)
+        d_ptr->setReconnectBufferDuration(msecs);
+}
+
+int Encoder::reconnectBufferDuration() const
+{
+    return d_ptr->reconnectBufferDuration();
+}
+
+void Encoder::setAdaptiveBitrateEnabled(bool enabled)
+{
+    if (state() != Encoder::ActiveState)
+        d_ptr->setAdaptiveBitrateEnabled(enabled);
+}
+
+bool Encoder::isAdaptiveBitrateEnabled() const
+{
+    return d_ptr->isAdaptiveBitrateEnabled();
+}
+
+void Encoder::setBitrateRange(int minimum, int maximum)
+{
+    if (state() != Encoder::ActiveState)
+        d_ptr->setBitrateRange(minimum, maximum);
+}
+
+int Encoder::minimumBitrate() const
+{
+    return d_ptr->minimumBitrate();
+}
+
+int Encoder::maximumBitrate() const
+{
+    return d_ptr->maximumBitrate();
+}
+
+int Encoder::currentBitrate() const
+{
+    return d_ptr->currentBitrate();
+}
+
 int Encoder::encodedFrameCount() const
 {
     return d_ptr->encodedFrameCount();
@@ -928,6 +2230,24 @@ int Encoder::encodedAudioDataSize() const
     return d_ptr->encodedAudioDataSize();
 }
 
+void Encoder::setStatisticsInterval(int msecs)
+{
+    if (statisticsInterval() != msecs) {
+        m_statisticsTimer->setInterval(qMax(msecs, 0));
+        updateStatisticsTimer();
+    }
+}
+
+int Encoder::statisticsInterval() const
+{
+    return m_statisticsTimer->interval();
+}
+
+QVariantMap Encoder::statistics() const
+{
+    return d_ptr->statistics();
+}
+
 Encoder::State Encoder::state() const
 {
     return m_state;
@@ -964,12 +2284,19 @@ void Encoder::stop()
 }
 
 void Encoder::encodeVideoFrame(const QImage &frame, int pts)
+{
+    //images in formats unknown to the encoder are converted once here
+    if (!frame.isNull() && VideoFrame::pixelFormat(frame) == EncoderGlobal::PIXEL_FORMAT_NONE)
+        encodeVideoFrame(VideoFrame(frame.convertToFormat(QImage::Format_RGB32)), pts);
+    else
+        encodeVideoFrame(VideoFrame(frame), pts);
+}
+
+void Encoder::encodeVideoFrame(const VideoFrame &frame, int pts)
 {
     if (state() == Encoder::ActiveState
             && (encodingMode() == Encoder::VideoMode || encodingMode() == Encoder::VideoAudioMode)) {
-        QMetaObject::invokeMethod(d_ptr, "encodeVideoFrame", Qt::QueuedConnection,
-                                  Q_ARG(QImage, frame),
-                                  Q_ARG(int, pts));
+        d_ptr->enqueueVideoFrame(frame, pts);
     }
 }
 
@@ -977,9 +2304,25 @@ void Encoder::encodeAudioData(const QByteArray &data, int pts)
 {
     if (state() == Encoder::ActiveState
             && (encodingMode() == Encoder::AudioMode || encodingMode() == Encoder::VideoAudioMode)) {
-        QMetaObject::invokeMethod(d_ptr, "encodeAudioData", Qt::QueuedConnection,
-                                  Q_ARG(QByteArray, data),
-                                  Q_ARG(int, pts));
+        d_ptr->enqueueAudioData(data, pts);
+    }
+}
+
+void Encoder::emitStatistics()
+{
+    Q_EMIT statisticsUpdated(statistics());
+}
+
+void Encoder::updateStatisticsTimer()
+{
+    if (state() == Encoder::ActiveState && statisticsInterval() > 0) {
+        if (!m_statisticsTimer->isActive())
+            m_statisticsTimer->start();
+    } else if (m_statisticsTimer->isActive()) {
+        m_statisticsTimer->stop();
+
+        //the last snapshot covers the whole session
+        emitStatistics();
     }
 }
 
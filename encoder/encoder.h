@@ -22,14 +22,19 @@
 #include "encoderglobal.h"
 #include "videocodecsettings.h"
 #include "audiocodecsettings.h"
+#include "videoframe.h"
+#include "audioformat.h"
 #include <QObject>
 #include <QSize>
 #include <QImage>
+#include <QStringList>
+#include <QVariantMap>
 
 #define MAX_AUDIO_FRAME_SIZE 192000
 
 class EncoderPrivate;
 class QThread;
+class QTimer;
 
 //! The Encoder class represents a media encoder.
 /*!
@@ -49,6 +54,8 @@ class QThread;
 class Encoder : public QObject
 {
     Q_OBJECT
+    Q_PROPERTY(QVariantMap statistics READ statistics NOTIFY statisticsUpdated)
+    Q_PROPERTY(int statisticsInterval READ statisticsInterval WRITE setStatisticsInterval)
 
     friend class EncoderPrivate;
 
@@ -68,7 +75,8 @@ public:
         InvalidAudioCodecError, /*!< Could not open audio codec. */
         FileOpenError, /*!< Could not open a file. */
         InvalidConversionContext, /*!< Could not initialize conversion context. */
-        InvalidInputPixelFormat /*!< Could not convert input pixel format to the ffmpeg's format. */
+        InvalidInputPixelFormat, /*!< Could not convert input pixel format to the ffmpeg's format. */
+        ConnectionLostError /*!< Writing to the output failed and it could not be reopened. */
     };
 
     /*! This enum describes the state of the encoder. */
@@ -84,6 +92,22 @@ public:
         VideoAudioMode /*!< Encode video and audio streams. */
     };
 
+    /*! This enum describes what happens when the encoder can not keep up with incoming frames. */
+    enum OverflowPolicy {
+        DropOldest = 0, /*!< The oldest queued frame is dropped. */
+        DropNonReference, /*!< New frames are dropped, except for every VideoCodecSettings::gopSize()-th frame, which replaces the oldest queued frame. Audio drops the oldest chunk. */
+        BlockProducer /*!< The grabber thread waits until the encoder frees a slot. */
+    };
+
+    /*! This enum describes the container written to the output. */
+    enum OutputFormat {
+        AutoFormat = 0, /*!< Chosen by the file path: MPEG-TS for udp://, srt:// and .ts, MPEG-TS in RTP for rtp://, HLS for .m3u8, fragmented MP4 for .mp4, FLV otherwise. */
+        FlvFormat, /*!< FLV, the container of RTMP. */
+        MpegTsFormat, /*!< MPEG transport stream, over UDP it is written in datagrams of 7 TS packets, over RTP with RTP headers. */
+        FragmentedMp4Format, /*!< MP4 fragmented at keyframes, playable while it is written. */
+        HlsFormat /*!< An HLS playlist at the file path with MPEG-TS segments of 2 seconds next to it. */
+    };
+
     /*! Constructs an encoder with the given parent. */
     explicit Encoder(QObject *parent = 0);
     /*! Destroys the encoder. */
@@ -100,6 +124,71 @@ public:
     */
     QString filePath() const;
 
+    /*!
+      Sets the container written to filePath(). The default value is Encoder::AutoFormat.
+      \sa outputFormat()
+    */
+    void setOutputFormat(Encoder::OutputFormat format);
+    Encoder::OutputFormat outputFormat() const;
+
+    /*!
+      Sets FFmpeg muxer and protocol options, e.g. "hls_time" or "pkt_size", which override the defaults of the
+      output format. Values are passed as strings.
+      \sa outputOptions()
+    */
+    void setOutputOptions(const QVariantMap &options);
+    QVariantMap outputOptions() const;
+
+    /*!
+      Adds an output which receives the same encoded packets as filePath(), e.g. a second ingest server or a local
+      recording, so nothing is encoded twice. Each added output is written on a thread of its own with its own
+      reconnect buffer, see OutputWriter. A slow or lost added output never stalls encoding or the other outputs,
+      and it does not report Encoder::ConnectionLostError. Outputs can only be added while the encoder is stopped.
+      \sa clearOutputs()
+    */
+    void addOutput(const QString &url, Encoder::OutputFormat format = Encoder::AutoFormat,
+                   const QVariantMap &options = QVariantMap());
+    /*! Removes all outputs added by addOutput(). */
+    void clearOutputs();
+    /*! Returns the urls of the outputs added by addOutput(). */
+    QStringList outputUrls() const;
+
+    /*!
+      Records the encoded streams to local files while streaming, nothing is encoded twice. The container follows
+      the extension of \a path, e.g. fragmented MP4 for .mp4 or FLV for .flv, both stay readable up to the last
+      written group of pictures after a crash. The recording is split into segments with their own trailers, see
+      setRecordingSegmentLimits(), and it is written on a thread of its own like an added output. An empty path, the
+      default, disables recording. The path can only be changed while the encoder is stopped.
+      \sa recordingPath()
+    */
+    void setRecordingPath(const QString &path);
+    QString recordingPath() const;
+
+    /*!
+      Sets the longest duration in milliseconds and the largest size in bytes of a recording segment, 0 disables
+      a limit. A new segment starts at the first video keyframe past a limit. The default values are 600000 and 0.
+      \sa OutputWriter::setSegmentLimits()
+    */
+    void setRecordingSegmentLimits(int msecs, qint64 bytes);
+    int recordingSegmentDuration() const;
+    qint64 recordingSegmentSize() const;
+
+    /*!
+      Adds a simulcast rendition: the video is also encoded in \a size at \a bitrate bits per second and written to
+      \a url, together with the audio. All other settings are those of the full size video.
+
+      Each captured picture is converted once. The largest rendition is scaled from the full size picture and each
+      smaller one from the rendition before it, e.g. 1080p to 720p to 360p. The renditions are encoded in parallel on
+      a thread pool while the encoder thread encodes the full size video. Keyframes are aligned across all renditions:
+      they are forced every VideoCodecSettings::gopSize() pictures, and H.264 scene cut detection is disabled unless
+      a scene change threshold is set. Renditions can only be added while the encoder is stopped.
+      \sa clearRenditions()
+    */
+    void addRendition(const QSize &size, int bitrate, const QString &url, Encoder::OutputFormat format = Encoder::AutoFormat);
+    /*! Removes all renditions added by addRendition(). */
+    void clearRenditions();
+    int renditionCount() const;
+
     void setVideoSize(const QSize &size);
     QSize videoSize() const;
 
@@ -124,6 +213,95 @@ public:
     void setAudioCodecSettings(const AudioCodecSettings &settings);
     AudioCodecSettings audioCodecSettings() const;
 
+    /*!
+      Sets the format of the interleaved samples passed to encodeAudioData(). They are converted to the sample format,
+      rate and channel count of the audio codec. A rate or channel count that is not set is taken from the codec.
+      Encoder::start() fails for a sample format that can not be converted.
+      \sa audioInputFormat()
+    */
+    void setAudioInputFormat(const AudioFormat &format);
+    AudioFormat audioInputFormat() const;
+
+    /*!
+      Sets the maximum number of video frames waiting for encoding. The default value is 8.
+      \sa videoQueueCapacity()
+    */
+    void setVideoQueueCapacity(int capacity);
+    int videoQueueCapacity() const;
+
+    /*!
+      Sets the maximum number of audio chunks waiting for encoding. The default value is 64.
+      \sa audioQueueCapacity()
+    */
+    void setAudioQueueCapacity(int capacity);
+    int audioQueueCapacity() const;
+
+    /*!
+      Sets the maximum number of encoded packets waiting for the output. The output is written on a thread of its own,
+      so a stalled network never blocks encoding. When the output falls this far behind, packets are dropped up to
+      the next video keyframe, which the encoder produces at once. The default value is 1024.
+      \sa outputQueueCapacity()
+    */
+    void setOutputQueueCapacity(int capacity);
+    int outputQueueCapacity() const;
+
+    /*!
+      Sets the policy applied when the video or audio queue is full. The default value is Encoder::DropOldest.
+      The audio queue applies Encoder::DropOldest instead of Encoder::DropNonReference.
+      \sa overflowPolicy()
+    */
+    void setOverflowPolicy(Encoder::OverflowPolicy policy);
+    Encoder::OverflowPolicy overflowPolicy() const;
+
+    /*!
+      Returns count of video frames dropped because the video queue was full.
+    */
+    int droppedVideoFrameCount() const;
+    /*!
+      Returns count of audio chunks dropped because the audio queue was full.
+    */
+    int droppedAudioChunkCount() const;
+
+    /*!
+      Sets how many times a failed output is reopened before Encoder::ConnectionLostError is reported.
+      Attempts are made with an exponentially growing delay. 0 disables reconnecting, the default value -1 retries forever.
+      \sa maximumReconnectAttempts()
+    */
+    void setMaximumReconnectAttempts(int count);
+    int maximumReconnectAttempts() const;
+
+    /*!
+      Sets how many milliseconds of encoded data are kept while the output is reconnecting. The default value is 5000.
+      After reconnecting, the kept data is sent starting from the first video keyframe.
+      \sa reconnectBufferDuration()
+    */
+    void setReconnectBufferDuration(int msecs);
+    int reconnectBufferDuration() const;
+
+    /*!
+      Enables adapting the video bitrate to the uplink. The time writes to the output block its writer thread is
+      measured every second: a congested output lowers the bitrate, an idle one raises it again, within the range set
+      by setBitrateRange().
+      The encoder must support rate control changes while encoding, like libx264 does. Disabled by default.
+      \sa currentBitrate()
+    */
+    void setAdaptiveBitrateEnabled(bool enabled);
+    bool isAdaptiveBitrateEnabled() const;
+
+    /*!
+      Sets the bounds of the adaptive bitrate in bits per second. By default -1 is set for both, which means
+      a quarter of VideoCodecSettings::bitrate() and VideoCodecSettings::bitrate().
+    */
+    void setBitrateRange(int minimum, int maximum);
+    int minimumBitrate() const;
+    int maximumBitrate() const;
+
+    /*!
+      Returns the video bitrate the encoder currently targets.
+      \sa bitrateChanged()
+    */
+    int currentBitrate() const;
+
     /*!
       Returns count of encoded video frames.
     */
@@ -133,6 +311,28 @@ public:
     */
     int encodedAudioDataSize() const;
 
+    /*!
+      Sets how often statisticsUpdated() is emitted while encoding, in milliseconds. The default value is 1000, 0 disables the signal.
+      \sa statistics()
+    */
+    void setStatisticsInterval(int msecs);
+    int statisticsInterval() const;
+
+    /*!
+      Returns a snapshot of the encoding statistics. Reading it never blocks the encoding thread.
+      The map holds the counters (encodedFrameCount, encodedAudioDataSize, droppedVideoFrameCount, droppedAudioChunkCount,
+      videoQueueDepth, audioQueueDepth, outputQueueDepth, droppedPacketCount, bytesWritten, pendingPacketCount,
+      reconnectCount, bitrate), the A/V drift avDrift in milliseconds and per stage latency maps (videoQueueLatency,
+      audioQueueLatency, conversionTime, videoEncodingTime, audioEncodingTime, writeTime) with count, average, p50,
+      p95, p99 and max in microseconds.
+      The list outputs holds the OutputWriter::statistics() of every output added by addOutput(), the list renditions
+      the RenditionEncoder::statistics() of every rendition and the map recording the OutputWriter::statistics() of
+      the recording, it is empty unless recordingPath() is set.
+      Everything is reset by start().
+      \sa statisticsUpdated()
+    */
+    QVariantMap statistics() const;
+
     /*!
       Returns the state of the encoder.
       \sa stateChanged()
@@ -158,13 +358,23 @@ public Q_SLOTS:
     void stop();
 
     /*!
-      Encodes a video frame. If encoding thread is in Encoder::StoppedState nothing happens.
+      Queues a video frame for encoding. If encoding thread is in Encoder::StoppedState nothing happens.
+      The function is thread-safe, so it can be called directly from a grabber thread.
       \param frame an image is to be encoded.
       \param pts presentation time stamp.
+      \sa setOverflowPolicy()
     */
     void encodeVideoFrame(const QImage &frame, int pts = -1);
     /*!
-      Encodes audio data from passed byte array. If encoding thread is in Encoder::StoppedState nothing happens.
+      Queues a video frame for encoding. A frame in the output pixel format and the video size is encoded
+      from its own planes, other frames are converted.
+      \param frame a frame is to be encoded.
+      \param pts presentation time stamp.
+    */
+    void encodeVideoFrame(const VideoFrame &frame, int pts = -1);
+    /*!
+      Queues audio data from passed byte array for encoding. If encoding thread is in Encoder::StoppedState nothing happens.
+      The function is thread-safe, so it can be called directly from a grabber thread.
     */
     void encodeAudioData(const QByteArray &data, int pts);
 
@@ -175,6 +385,18 @@ Q_SIGNALS:
     void stateChanged(Encoder::State state);
     /*! This signal is emitted when an error occurs. */
     void error(Encoder::Error errorCode);
+    /*! This signal is emitted from the encoding thread when writing to the output fails and reconnecting starts. */
+    void connectionLost();
+    /*! This signal is emitted from the encoding thread when the output has been reopened. */
+    void connectionRestored();
+    /*! This signal is emitted from the encoding thread when the adaptive bitrate has changed. */
+    void bitrateChanged(int bitrate);
+    /*! This signal is emitted every statisticsInterval() milliseconds while encoding, and once more when encoding stops. */
+    void statisticsUpdated(const QVariantMap &statistics);
+
+private Q_SLOTS:
+    void emitStatistics();
+    void updateStatisticsTimer();
 
 private:
     void setState(Encoder::State state);
@@ -183,6 +405,7 @@ private:
 
     EncoderPrivate *d_ptr;
     QThread *m_encoderThread;
+    QTimer *m_statisticsTimer;
 
     Encoder::State m_state;
     Encoder::Error m_error;
@@ -228,6 +228,11 @@ enum EncoderPixelFormat {
     Y400A /*!< 8bit gray, 8bit alpha */
 };
 
+enum ThreadType {
+    FrameThreading = 0x0001, /*!< Decode/encode more than one frame at once, adds one frame of delay per thread. */
+    SliceThreading = 0x0002 /*!< Decode/encode more than one part of a single frame at once, adds no delay. */
+};
+
 enum CoderType {
     Vlc = 0,
     Ac,
@@ -0,0 +1,585 @@
+/****************************************************************************
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License as published by the Free Software Foundation; either
+** version 2.1 of the License, or (at your option) any later version.
+**
+** This library is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public
+** License along with this library; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**
+****************************************************************************/
+
+
+#include "muxer.h"
+
+#define INITIAL_RECONNECT_DELAY 500
+#define MAXIMUM_RECONNECT_DELAY 30000
+#define OPEN_TIMEOUT 5000
+#define DEFAULT_RECONNECT_BUFFER_DURATION 5000
+//7 TS packets of 188 bytes fill an ethernet frame without fragmentation
+#define TS_DATAGRAM_SIZE 1316
+//whole datagrams, a full buffer never splits a TS packet
+#define WRITE_BUFFER_SIZE (TS_DATAGRAM_SIZE * 199)
+
+Muxer::Muxer()
+    : m_formatName("flv")
+    , m_maximumReconnectAttempts(-1)
+    , m_reconnectBufferDuration(DEFAULT_RECONNECT_BUFFER_DURATION)
+    , m_formatContext(NULL)
+    , m_output(NULL)
+    , m_connected(false)
+    , m_aborted(false)
+    , m_waitingForKeyframe(false)
+    , m_reconnectAttempts(0)
+    , m_reconnectDelay(INITIAL_RECONNECT_DELAY)
+    , m_writtenBytes(0)
+    , m_writeTime(0)
+    , m_totalWrittenBytes(0)
+    , m_pendingPacketCount(0)
+    , m_reconnectCount(0)
+{
+    m_retainedPacket = av_packet_alloc();
+}
+
+Muxer::~Muxer()
+{
+    reset();
+    av_packet_free(&m_retainedPacket);
+}
+
+void Muxer::setFormatName(const QString &name)
+{
+    m_formatName = name;
+}
+
+QString Muxer::formatName() const
+{
+    return m_formatName;
+}
+
+QString Muxer::formatNameForUrl(const QString &url)
+{
+    QString scheme = url.section(':', 0, 0).toLower();
+    QString path = url.section('?', 0, 0).toLower();
+
+    //RTP receivers expect an RTP header in front of the TS packets, the rtp protocol adds none
+    if (scheme == "rtp")
+        return "rtp_mpegts";
+
+    if (scheme == "udp" || scheme == "srt" || path.endsWith(".ts"))
+        return "mpegts";
+
+    if (path.endsWith(".m3u8"))
+        return "hls";
+
+    if (path.endsWith(".mp4") || path.endsWith(".m4v") || path.endsWith(".mov"))
+        return "mp4";
+
+    return "flv";
+}
+
+void Muxer::setOptions(const QVariantMap &options)
+{
+    m_options = options;
+}
+
+QVariantMap Muxer::options() const
+{
+    return m_options;
+}
+
+void Muxer::setUrl(const QString &url)
+{
+    m_url = url;
+}
+
+QString Muxer::url() const
+{
+    return m_url;
+}
+
+void Muxer::setMaximumReconnectAttempts(int count)
+{
+    m_maximumReconnectAttempts = count;
+}
+
+int Muxer::maximumReconnectAttempts() const
+{
+    return m_maximumReconnectAttempts;
+}
+
+void Muxer::setReconnectBufferDuration(int msecs)
+{
+    m_reconnectBufferDuration = msecs;
+}
+
+int Muxer::reconnectBufferDuration() const
+{
+    return m_reconnectBufferDuration;
+}
+
+const AVOutputFormat *Muxer::outputFormat() const
+{
+    return av_guess_format(m_formatName.toUtf8().constData(), NULL, NULL);
+}
+
+int Muxer::addStream(const AVCodecContext *context)
+{
+    Stream stream;
+    stream.parameters = avcodec_parameters_alloc();
+    stream.timeBase = context->time_base;
+    avcodec_parameters_from_context(stream.parameters, context);
+
+    m_streams.append(stream);
+
+    return m_streams.size() - 1;
+}
+
+bool Muxer::open()
+{
+    close(false);
+
+    if (avformat_alloc_output_context2(&m_formatContext, NULL, m_formatName.toUtf8().constData(),
+                                       m_url.toUtf8().constData()) < 0) {
+        return false;
+    }
+
+    //a dead server must not block the encoder thread for the whole network timeout
+    m_formatContext->interrupt_callback.callback = &Muxer::interruptCallback;
+    m_formatContext->interrupt_callback.opaque = this;
+    m_openTimer.start();
+
+    for (int i = 0; i < m_streams.size(); ++i) {
+        AVStream *stream = avformat_new_stream(m_formatContext, NULL);
+        if (!stream || avcodec_parameters_copy(stream->codecpar, m_streams.at(i).parameters) < 0) {
+            close(false);
+            return false;
+        }
+
+        stream->time_base = m_streams.at(i).timeBase;
+    }
+
+    //the protocol and the muxer take the options they know from their own copy
+    AVDictionary *protocolOptions = createOptions();
+    AVDictionary *formatOptions = createOptions();
+
+    bool opened = (m_formatContext->oformat->flags & AVFMT_NOFILE) || openOutput(&protocolOptions);
+
+    opened = opened && avformat_write_header(m_formatContext, &formatOptions) >= 0;
+
+    av_dict_free(&protocolOptions);
+    av_dict_free(&formatOptions);
+
+    if (!opened) {
+        close(false);
+        return false;
+    }
+
+    m_openTimer.invalidate();
+    m_connected = true;
+
+    return true;
+}
+
+void Muxer::close(bool writeTrailer)
+{
+    if (m_formatContext == NULL)
+        return;
+
+    if (m_connected && writeTrailer && !m_aborted.load())
+        av_write_trailer(m_formatContext);
+
+    if (!(m_formatContext->oformat->flags & AVFMT_NOFILE)) {
+        if (m_formatContext->pb == m_output) {
+            m_formatContext->pb = NULL;
+        } else if (m_formatContext->pb != NULL) {
+            //a failed output is not written again, it would only block once more
+            if (m_connected && m_formatContext->pb->error >= 0 && !m_aborted.load())
+                avio_flush(m_formatContext->pb);
+
+            av_freep(&m_formatContext->pb->buffer);
+            avio_context_free(&m_formatContext->pb);
+        }
+
+        avio_closep(&m_output);
+    }
+
+    avformat_free_context(m_formatContext);
+    m_formatContext = NULL;
+    m_connected = false;
+}
+
+void Muxer::setAborted(bool aborted)
+{
+    m_aborted.store(aborted);
+}
+
+bool Muxer::isAborted() const
+{
+    return m_aborted.load();
+}
+
+void Muxer::reset()
+{
+    close(false);
+    clearBuffer();
+
+    for (int i = 0; i < m_streams.size(); ++i)
+        avcodec_parameters_free(&m_streams[i].parameters);
+
+    m_streams.clear();
+
+    m_waitingForKeyframe = false;
+    m_reconnectAttempts = 0;
+    m_reconnectDelay = INITIAL_RECONNECT_DELAY;
+}
+
+bool Muxer::isConnected() const
+{
+    return m_connected;
+}
+
+Muxer::Status Muxer::writePacket(AVPacket *packet, int streamIndex, AVRational timeBase)
+{
+    if (m_connected) {
+        if (write(packet, streamIndex, timeBase))
+            return Muxer::Written;
+
+        disconnect();
+    }
+
+    if (m_maximumReconnectAttempts == 0) {
+        av_packet_unref(packet);
+        return Muxer::Failed;
+    }
+
+    bufferPacket(packet, streamIndex, timeBase);
+
+    //an output which failed to open at all is tried again at once
+    if (m_reconnectTimer.isValid() && m_reconnectTimer.elapsed() < m_reconnectDelay)
+        return Muxer::Buffered;
+
+    if (reconnect()) {
+        writeBufferedPackets();
+        return m_connected ? Muxer::Written : Muxer::Buffered;
+    }
+
+    if (m_maximumReconnectAttempts > 0 && m_reconnectAttempts >= m_maximumReconnectAttempts) {
+        clearBuffer();
+        return Muxer::Failed;
+    }
+
+    return Muxer::Buffered;
+}
+
+void Muxer::flush()
+{
+    if (!m_connected || m_formatContext->pb == NULL)
+        return;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    avio_flush(m_formatContext->pb);
+    if (m_formatContext->pb != m_output)
+        avio_flush(m_output);
+
+    qint64 elapsed = timer.nsecsElapsed();
+    m_writeTime.fetchAndAddRelaxed(elapsed);
+    m_writeLatency.addSample(elapsed / 1000);
+
+    //the next packet reconnects, as if its own write had failed
+    if (m_formatContext->pb->error < 0 || m_output->error < 0)
+        disconnect();
+}
+
+bool Muxer::isKeyframeRequested() const
+{
+    return m_waitingForKeyframe;
+}
+
+void Muxer::takeWriteStatistics(qint64 *bytes, qint64 *writeUsecs)
+{
+    *bytes = m_writtenBytes.fetchAndStoreRelaxed(0);
+    *writeUsecs = m_writeTime.fetchAndStoreRelaxed(0) / 1000;
+}
+
+void Muxer::resetStatistics()
+{
+    m_totalWrittenBytes.store(0);
+    m_reconnectCount.store(0);
+    m_writeLatency.reset();
+}
+
+qint64 Muxer::totalWrittenBytes() const
+{
+    return m_totalWrittenBytes.load();
+}
+
+int Muxer::pendingPacketCount() const
+{
+    return m_pendingPacketCount.load();
+}
+
+int Muxer::reconnectCount() const
+{
+    return m_reconnectCount.load();
+}
+
+const LatencyHistogram &Muxer::writeLatency() const
+{
+    return m_writeLatency;
+}
+
+AVDictionary *Muxer::createOptions() const
+{
+    AVDictionary *options = NULL;
+    QString scheme = m_url.section(':', 0, 0).toLower();
+
+    //the buffer goes out when it is full or flush() is called, not after every packet
+    av_dict_set(&options, "flush_packets", "0", 0);
+
+    if (m_formatName == "flv") {
+        //a live stream has no duration and no file size to seek back to
+        av_dict_set(&options, "flvflags", "no_duration_filesize", 0);
+    } else if (m_formatName == "mpegts") {
+        //TS packets are batched into whole datagrams instead of one write per packet
+        if (scheme == "udp" || scheme == "srt")
+            av_dict_set_int(&options, "pkt_size", TS_DATAGRAM_SIZE, 0);
+    } else if (m_formatName == "mp4") {
+        //without fragments nothing is playable before the trailer, and the output can not seek
+        av_dict_set(&options, "movflags", "frag_keyframe+empty_moov+default_base_moof", 0);
+    } else if (m_formatName == "hls") {
+        av_dict_set(&options, "hls_time", "2", 0);
+        av_dict_set(&options, "hls_list_size", "6", 0);
+        av_dict_set(&options, "hls_flags", "delete_segments+independent_segments", 0);
+    }
+
+    for (QVariantMap::const_iterator it = m_options.constBegin(); it != m_options.constEnd(); ++it)
+        av_dict_set(&options, it.key().toUtf8().constData(), it.value().toString().toUtf8().constData(), 0);
+
+    return options;
+}
+
+bool Muxer::write(AVPacket *packet, int streamIndex, AVRational timeBase)
+{
+    //after a reconnect the viewers can only start decoding at a keyframe
+    if (m_waitingForKeyframe) {
+        if (!isVideoKeyframe(packet, streamIndex)) {
+            av_packet_unref(packet);
+            return true;
+        }
+
+        m_waitingForKeyframe = false;
+    }
+
+    //the reference gives a failed packet back to the caller with its original timestamps
+    bool retained = av_packet_ref(m_retainedPacket, packet) >= 0;
+
+    AVStream *stream = m_formatContext->streams[streamIndex];
+
+    av_packet_rescale_ts(packet, timeBase, stream->time_base);
+    packet->stream_index = streamIndex;
+
+    m_writtenBytes.fetchAndAddRelaxed(packet->size);
+    m_totalWrittenBytes.fetchAndAddRelaxed(packet->size);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    //the muxer takes over the packet data and resets the packet
+    bool written = av_interleaved_write_frame(m_formatContext, packet) >= 0;
+    qint64 elapsed = timer.nsecsElapsed();
+    m_writeTime.fetchAndAddRelaxed(elapsed);
+    m_writeLatency.addSample(elapsed / 1000);
+
+    if (!written && retained) {
+        av_packet_unref(packet);
+        av_packet_move_ref(packet, m_retainedPacket);
+    }
+
+    av_packet_unref(m_retainedPacket);
+
+    return written;
+}
+
+bool Muxer::openOutput(AVDictionary **options)
+{
+    if (avio_open2(&m_output, m_url.toUtf8().constData(), AVIO_FLAG_WRITE,
+                   &m_formatContext->interrupt_callback, options) < 0) {
+        return false;
+    }
+
+    //RTP packets must reach the protocol one by one, they are not batched
+    if (m_formatName.startsWith("rtp")) {
+        m_formatContext->pb = m_output;
+        return true;
+    }
+
+    //a protocol with a packet size splits the batches into datagrams in its own buffer, others take them directly
+    if (m_output->max_packet_size == 0)
+        m_output->direct = 1;
+
+    unsigned char *buffer = static_cast<unsigned char *>(av_malloc(WRITE_BUFFER_SIZE));
+    if (buffer == NULL)
+        return false;
+
+    m_formatContext->pb = avio_alloc_context(buffer, WRITE_BUFFER_SIZE, 1, this, NULL,
+                                             &Muxer::writeCallback, &Muxer::seekCallback);
+    if (m_formatContext->pb == NULL) {
+        av_free(buffer);
+        return false;
+    }
+
+    //muxers seek back only into files, e.g. for a duration in the header
+    m_formatContext->pb->seekable = m_output->seekable;
+
+    return true;
+}
+
+void Muxer::disconnect()
+{
+    close(false);
+
+    m_reconnectAttempts = 0;
+    m_reconnectDelay = INITIAL_RECONNECT_DELAY;
+    m_reconnectTimer.start();
+}
+
+bool Muxer::reconnect()
+{
+    ++m_reconnectAttempts;
+
+    if (open()) {
+        m_reconnectAttempts = 0;
+        m_reconnectDelay = INITIAL_RECONNECT_DELAY;
+        m_waitingForKeyframe = true;
+        m_reconnectCount.ref();
+        return true;
+    }
+
+    m_reconnectDelay = qMin(m_reconnectDelay * 2, MAXIMUM_RECONNECT_DELAY);
+    m_reconnectTimer.start();
+
+    return false;
+}
+
+void Muxer::bufferPacket(AVPacket *packet, int streamIndex, AVRational timeBase)
+{
+    //a packet without data or timestamps can neither be resent nor placed in the window
+    if (packet->data == NULL || packet->size <= 0
+            || (packet->dts == AV_NOPTS_VALUE && packet->pts == AV_NOPTS_VALUE)) {
+        av_packet_unref(packet);
+        return;
+    }
+
+    PendingPacket pending;
+    pending.packet = av_packet_alloc();
+    pending.streamIndex = streamIndex;
+    pending.timeBase = timeBase;
+    av_packet_move_ref(pending.packet, packet);
+
+    m_pendingPackets.enqueue(pending);
+
+    //the window is measured on the newest packet, the oldest packets are dropped first
+    int64_t newest = av_rescale_q(pending.packet->dts != AV_NOPTS_VALUE ? pending.packet->dts : pending.packet->pts,
+                                  timeBase, av_make_q(1, 1000));
+
+    while (m_pendingPackets.size() > 1) {
+        const PendingPacket &oldest = m_pendingPackets.head();
+        int64_t oldestTime = av_rescale_q(oldest.packet->dts != AV_NOPTS_VALUE ? oldest.packet->dts : oldest.packet->pts,
+                                          oldest.timeBase, av_make_q(1, 1000));
+
+        if (newest - oldestTime <= m_reconnectBufferDuration)
+            break;
+
+        PendingPacket dropped = m_pendingPackets.dequeue();
+        av_packet_free(&dropped.packet);
+    }
+
+    m_pendingPacketCount.store(m_pendingPackets.size());
+}
+
+void Muxer::writeBufferedPackets()
+{
+    while (!m_pendingPackets.isEmpty() && m_connected) {
+        PendingPacket pending = m_pendingPackets.dequeue();
+
+        //a failed packet goes back to the front and is resent after the next reconnect
+        if (!write(pending.packet, pending.streamIndex, pending.timeBase)) {
+            disconnect();
+
+            if (pending.packet->data != NULL) {
+                m_pendingPackets.prepend(pending);
+                break;
+            }
+        }
+
+        av_packet_free(&pending.packet);
+    }
+
+    m_pendingPacketCount.store(m_pendingPackets.size());
+}
+
+void Muxer::clearBuffer()
+{
+    while (!m_pendingPackets.isEmpty()) {
+        PendingPacket pending = m_pendingPackets.dequeue();
+        av_packet_free(&pending.packet);
+    }
+
+    m_pendingPacketCount.store(0);
+}
+
+bool Muxer::isVideoKeyframe(const AVPacket *packet, int streamIndex) const
+{
+    //streams without video have no keyframes to wait for
+    bool hasVideo = false;
+    for (int i = 0; i < m_streams.size(); ++i) {
+        if (m_streams.at(i).parameters->codec_type == AVMEDIA_TYPE_VIDEO)
+            hasVideo = true;
+    }
+
+    if (!hasVideo)
+        return true;
+
+    return m_streams.at(streamIndex).parameters->codec_type == AVMEDIA_TYPE_VIDEO
+            && (packet->flags & AV_PKT_FLAG_KEY);
+}
+
+int Muxer::interruptCallback(void *opaque)
+{
+    Muxer *muxer = static_cast<Muxer *>(opaque);
+    return muxer->m_aborted.load() || (muxer->m_openTimer.isValid() && muxer->m_openTimer.elapsed() > OPEN_TIMEOUT);
+}
+
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+int Muxer::writeCallback(void *opaque, const uint8_t *buffer, int size)
+#else
+int Muxer::writeCallback(void *opaque, uint8_t *buffer, int size)
+#endif
+{
+    Muxer *muxer = static_cast<Muxer *>(opaque);
+
+    //flush() decides when the protocol sends a partly filled datagram
+    avio_write(muxer->m_output, buffer, size);
+
+    return muxer->m_output->error < 0 ? muxer->m_output->error : size;
+}
+
+int64_t Muxer::seekCallback(void *opaque, int64_t offset, int whence)
+{
+    Muxer *muxer = static_cast<Muxer *>(opaque);
+
+    if (whence == AVSEEK_SIZE)
+        return avio_size(muxer->m_output);
+
+    return avio_seek(muxer->m_output, offset, whence & ~AVSEEK_FORCE);
+}
@@ -0,0 +1,220 @@
+/****************************************************************************
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License as published by the Free Software Foundation; either
+** version 2.1 of the License, or (at your option) any later version.
+**
+** This library is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public
+** License along with this library; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**
+****************************************************************************/
+
+
+#ifndef MUXER_H
+#define MUXER_H
+
+#ifndef INT64_C
+#define INT64_C(c) (c ## LL)
+#define UINT64_C(c) (c ## ULL)
+#endif
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#include "helpers/latencyhistogram.h"
+
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QList>
+#include <QQueue>
+#include <QString>
+#include <QVariantMap>
+
+//! The Muxer class writes encoded packets to the output and keeps the output alive.
+/*!
+  When writing fails, the output is closed and reopened with an exponentially growing delay, while packets are kept
+  in a buffer bounded by reconnectBufferDuration(). After a reconnect the stream header is written again and output
+  restarts at a video keyframe, so viewers only see a short gap.
+
+  Reconnect attempts are made from writePacket(), no timer or thread is involved.
+
+  The muxer does not write to the protocol after every packet. Its output collects in a large buffer, which is passed
+  to the protocol when it is full or flush() is called. Protocols without a packet size, e.g. TCP or files, take it
+  in one write. Protocols with a packet size, e.g. UDP, copy it into their own buffer and send it in datagrams of
+  that size. An OutputWriter flushes whenever its queue runs empty, so a congested output is written in few large
+  batches instead of many small writes. RTP packets are not batched.
+
+  The container is chosen by setFormatName(). Each format is opened with options tuned for live output, e.g. MPEG-TS
+  over UDP or SRT is written in datagrams of 7 TS packets and MP4 is fragmented at keyframes. setOptions()
+  overrides or extends them. MPEG-TS over RTP needs the "rtp_mpegts" muxer, which adds the RTP headers.
+*/
+class Muxer
+{
+public:
+    /*! This enum describes the result of writePacket(). */
+    enum Status {
+        Written = 0, /*!< The packet has been passed to the output. */
+        Buffered, /*!< The output is disconnected, the packet is kept until it reconnects. */
+        Failed /*!< The output is disconnected and all reconnect attempts have failed. */
+    };
+
+    Muxer();
+    ~Muxer();
+
+    /*! Sets the short name of the FFmpeg muxer, e.g. "flv", "mpegts", "mp4" or "hls". The default value is "flv". */
+    void setFormatName(const QString &name);
+    QString formatName() const;
+
+    /*!
+      Returns the format name fitting the protocol or file extension of \a url, "flv" if nothing fits.
+      rtp:// urls get "rtp_mpegts".
+    */
+    static QString formatNameForUrl(const QString &url);
+
+    /*!
+      Sets muxer and protocol options passed to FFmpeg when the output is opened, they override the defaults of the
+      format. Options neither the muxer nor the protocol knows are ignored.
+    */
+    void setOptions(const QVariantMap &options);
+    QVariantMap options() const;
+
+    void setUrl(const QString &url);
+    QString url() const;
+
+    /*! Sets the count of reconnect attempts, 0 disables reconnecting and -1 makes it unlimited. */
+    void setMaximumReconnectAttempts(int count);
+    int maximumReconnectAttempts() const;
+
+    /*! Sets how many milliseconds of packets are kept while the output is disconnected. */
+    void setReconnectBufferDuration(int msecs);
+    int reconnectBufferDuration() const;
+
+    /*! Returns the output format matching formatName() or NULL. */
+    const AVOutputFormat *outputFormat() const;
+
+    /*! Adds a stream with the parameters of an opened codec and returns its index. */
+    int addStream(const AVCodecContext *context);
+
+    /*! Opens the output and writes the stream header. */
+    bool open();
+    /*!
+      Closes the output, the trailer is only written to a connected output if \a writeTrailer is true and the muxer
+      is not aborted.
+    */
+    void close(bool writeTrailer);
+    /*!
+      Sets the abort flag. While it is set, blocking opens and writes return at once and nothing more is written.
+      It may be called from any thread, e.g. to stop a writer thread stuck on a dead server.
+      \sa isAborted()
+    */
+    void setAborted(bool aborted);
+    bool isAborted() const;
+    /*! Closes the output and removes all streams. */
+    void reset();
+
+    bool isConnected() const;
+
+    /*!
+      Writes \a packet with timestamps in \a timeBase to the stream \a streamIndex. The packet data is taken over
+      and \a packet is reset.
+    */
+    Muxer::Status writePacket(AVPacket *packet, int streamIndex, AVRational timeBase);
+    /*! Writes the buffered output to the protocol. A failing write disconnects the output like writePacket() does. */
+    void flush();
+
+    /*! Returns true while the output waits for a video keyframe, the encoder should produce one. */
+    bool isKeyframeRequested() const;
+
+    /*! Returns true if \a packet is a keyframe of a video stream, or for any packet if there is no video stream. */
+    bool isVideoKeyframe(const AVPacket *packet, int streamIndex) const;
+
+    /*!
+      Returns the count of bytes written and the time spent in writes since the last call, then resets both.
+      Writes block while the network can not take more data, so a growing write time shows a congested uplink.
+      It may be called from any thread.
+    */
+    void takeWriteStatistics(qint64 *bytes, qint64 *writeUsecs);
+
+    /*!
+      Resets the totals below. The totals and writeLatency() may be read from any thread while packets are written.
+    */
+    void resetStatistics();
+    /*! Returns count of bytes passed to the output. */
+    qint64 totalWrittenBytes() const;
+    /*! Returns count of packets kept while the output is disconnected. */
+    int pendingPacketCount() const;
+    /*! Returns how many times the output has been reopened. */
+    int reconnectCount() const;
+    /*! Returns the histogram of the time spent in each packet write and flush. */
+    const LatencyHistogram &writeLatency() const;
+
+private:
+    Q_DISABLE_COPY(Muxer)
+
+    struct Stream {
+        AVCodecParameters *parameters;
+        AVRational timeBase;
+    };
+
+    struct PendingPacket {
+        AVPacket *packet;
+        int streamIndex;
+        AVRational timeBase;
+    };
+
+    AVDictionary *createOptions() const;
+    bool openOutput(AVDictionary **options);
+    bool write(AVPacket *packet, int streamIndex, AVRational timeBase);
+    void disconnect();
+    bool reconnect();
+    void bufferPacket(AVPacket *packet, int streamIndex, AVRational timeBase);
+    void writeBufferedPackets();
+    void clearBuffer();
+
+    static int interruptCallback(void *opaque);
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+    static int writeCallback(void *opaque, const uint8_t *buffer, int size);
+#else
+    static int writeCallback(void *opaque, uint8_t *buffer, int size);
+#endif
+    static int64_t seekCallback(void *opaque, int64_t offset, int whence);
+
+    QString m_formatName;
+    QVariantMap m_options;
+    QString m_url;
+    int m_maximumReconnectAttempts;
+    int m_reconnectBufferDuration;
+
+    AVFormatContext *m_formatContext;
+    //the protocol, the format context writes to it through a buffer of its own
+    AVIOContext *m_output;
+    QList<Stream> m_streams;
+    QQueue<PendingPacket> m_pendingPackets;
+    AVPacket *m_retainedPacket;
+
+    bool m_connected;
+    QAtomicInt m_aborted;
+    bool m_waitingForKeyframe;
+    int m_reconnectAttempts;
+    int m_reconnectDelay;
+    QElapsedTimer m_reconnectTimer;
+    QElapsedTimer m_openTimer;
+
+    QAtomicInteger<qint64> m_writtenBytes;
+    QAtomicInteger<qint64> m_writeTime;
+
+    QAtomicInteger<qint64> m_totalWrittenBytes;
+    QAtomicInt m_pendingPacketCount;
+    QAtomicInt m_reconnectCount;
+    LatencyHistogram m_writeLatency;
+};
+
+#endif // MUXER_H
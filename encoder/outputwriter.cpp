@@ -0,0 +1,334 @@
+/****************************************************************************
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License as published by the Free Software Foundation; either
+** version 2.1 of the License, or (at your option) any later version.
+**
+** This library is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public
+** License along with this library; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**
+****************************************************************************/
+
+
+#include "outputwriter.h"
+
+#include <QDateTime>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QThread>
+
+#define DEFAULT_QUEUE_CAPACITY 1024
+#define PACKET_WAIT 10
+//time a stopping writer gets for the queued packets and the trailer before its output is aborted
+#define STOP_TIMEOUT 3000
+
+class OutputWriterThread : public QThread
+{
+public:
+    explicit OutputWriterThread(OutputWriter *writer)
+        : m_writer(writer)
+    {
+    }
+
+protected:
+    void run()
+    {
+        m_writer->run();
+    }
+
+private:
+    OutputWriter *m_writer;
+};
+
+OutputWriter::OutputWriter()
+    : m_queue(DEFAULT_QUEUE_CAPACITY)
+    , m_thread(new OutputWriterThread(this))
+    , m_segmentDuration(0)
+    , m_segmentSize(0)
+    , m_segmentStartTime(AV_NOPTS_VALUE)
+    , m_segmentStartBytes(0)
+    , m_waitingForKeyframe(false)
+    , m_connected(false)
+    , m_keyframeRequested(false)
+    , m_failed(false)
+    , m_droppedPacketCount(0)
+    , m_segmentCount(0)
+{
+}
+
+OutputWriter::~OutputWriter()
+{
+    stop();
+    delete m_thread;
+}
+
+Muxer *OutputWriter::muxer()
+{
+    return &m_muxer;
+}
+
+const Muxer *OutputWriter::muxer() const
+{
+    return &m_muxer;
+}
+
+void OutputWriter::setQueueCapacity(int capacity)
+{
+    if (!m_thread->isRunning())
+        m_queue.setCapacity(capacity);
+}
+
+int OutputWriter::queueCapacity() const
+{
+    return m_queue.capacity();
+}
+
+void OutputWriter::setSegmentLimits(int msecs, qint64 bytes)
+{
+    if (m_thread->isRunning())
+        return;
+
+    m_segmentDuration = qMax(msecs, 0);
+    m_segmentSize = qMax<qint64>(bytes, 0);
+}
+
+int OutputWriter::segmentDuration() const
+{
+    return m_segmentDuration;
+}
+
+qint64 OutputWriter::segmentSize() const
+{
+    return m_segmentSize;
+}
+
+void OutputWriter::start()
+{
+    if (m_thread->isRunning())
+        return;
+
+    m_waitingForKeyframe = false;
+    //a muxer opened by the caller is connected before the thread runs
+    m_connected.store(m_muxer.isConnected());
+    m_keyframeRequested.store(false);
+    m_failed.store(false);
+    m_droppedPacketCount.store(0);
+    m_segmentCount.store(0);
+    m_muxer.resetStatistics();
+
+    m_url = m_muxer.url();
+
+    //segments of a restarted recording never overwrite the earlier ones
+    if (isSegmented()) {
+        int extension = m_url.lastIndexOf('.');
+        if (extension <= m_url.lastIndexOf('/'))
+            extension = m_url.size();
+
+        QString prefix = m_url.left(extension) + QDateTime::currentDateTime().toString("-yyyyMMdd-hhmmsszzz");
+        m_segmentSuffix = m_url.mid(extension);
+
+        //the clock may repeat after an adjustment, an existing recording gets a numbered name next to it
+        m_segmentPrefix = prefix;
+        for (int i = 1; QFileInfo::exists(segmentUrl(1)); ++i)
+            m_segmentPrefix = prefix + QString("-%1").arg(i);
+        m_segmentStartTime = AV_NOPTS_VALUE;
+        m_segmentStartBytes = 0;
+
+        m_muxer.setUrl(segmentUrl(1));
+        m_segmentCount.store(1);
+    }
+
+    m_queue.open();
+    m_thread->start();
+}
+
+void OutputWriter::stop()
+{
+    if (!m_thread->isRunning())
+        return;
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_queue.close();
+        m_packetAvailable.wakeOne();
+    }
+
+    //a dead server would block the writes up to the network timeout, the output is closed without the trailer then
+    if (!m_thread->wait(STOP_TIMEOUT)) {
+        m_muxer.setAborted(true);
+        m_thread->wait();
+        m_muxer.setAborted(false);
+    }
+
+    clearQueue();
+
+    m_muxer.setUrl(m_url);
+}
+
+void OutputWriter::writePacket(const AVPacket *packet, int streamIndex, AVRational timeBase)
+{
+    //after an overflow the output continues at a keyframe, so its viewers can decode again
+    if (m_waitingForKeyframe && !m_muxer.isVideoKeyframe(packet, streamIndex)) {
+        m_droppedPacketCount.ref();
+        return;
+    }
+
+    //the encoded data is shared with the other outputs, only a reference is taken
+    Packet item;
+    item.packet = av_packet_clone(packet);
+    item.streamIndex = streamIndex;
+    item.timeBase = timeBase;
+
+    if (!item.packet)
+        return;
+
+    if (!m_queue.tryEnqueue(item)) {
+        av_packet_free(&item.packet);
+        m_droppedPacketCount.ref();
+        m_waitingForKeyframe = true;
+        return;
+    }
+
+    m_waitingForKeyframe = false;
+
+    QMutexLocker locker(&m_mutex);
+    m_packetAvailable.wakeOne();
+}
+
+bool OutputWriter::isConnected() const
+{
+    return m_connected.load();
+}
+
+bool OutputWriter::isKeyframeRequested() const
+{
+    return m_waitingForKeyframe || m_keyframeRequested.load();
+}
+
+bool OutputWriter::hasFailed() const
+{
+    return m_failed.load();
+}
+
+int OutputWriter::droppedPacketCount() const
+{
+    return m_droppedPacketCount.load();
+}
+
+int OutputWriter::queueDepth() const
+{
+    return m_queue.size();
+}
+
+QVariantMap OutputWriter::statistics() const
+{
+    QVariantMap statistics;
+    statistics["url"] = m_url;
+    statistics["connected"] = isConnected();
+    statistics["failed"] = hasFailed();
+    statistics["bytesWritten"] = m_muxer.totalWrittenBytes();
+    statistics["pendingPacketCount"] = m_muxer.pendingPacketCount();
+    statistics["reconnectCount"] = m_muxer.reconnectCount();
+    statistics["droppedPacketCount"] = droppedPacketCount();
+    statistics["queueDepth"] = queueDepth();
+    statistics["segmentCount"] = m_segmentCount.load();
+    statistics["writeTime"] = m_muxer.writeLatency().toVariantMap();
+
+    return statistics;
+}
+
+void OutputWriter::run()
+{
+    //a destination which is down at start is reconnected by the muxer with the first packets
+    m_connected.store(m_muxer.isConnected() || m_muxer.open());
+
+    Packet item;
+
+    //an aborted output drops what is left in the queue
+    while (!m_muxer.isAborted()) {
+        if (!m_queue.tryDequeue(&item)) {
+            //packets queued before stop() are still written
+            if (!m_queue.isOpen() && m_queue.isEmpty())
+                break;
+
+            QMutexLocker locker(&m_mutex);
+            if (m_queue.isOpen() && m_queue.isEmpty())
+                m_packetAvailable.wait(&m_mutex, PACKET_WAIT);
+
+            continue;
+        }
+
+        if (!m_failed.load()) {
+            if (isSegmented() && m_muxer.isVideoKeyframe(item.packet, item.streamIndex))
+                startSegmentAt(item);
+
+            if (m_muxer.writePacket(item.packet, item.streamIndex, item.timeBase) == Muxer::Failed)
+                m_failed.store(true);
+        }
+
+        av_packet_free(&item.packet);
+
+        //everything queued while the last write blocked goes out together
+        if (!isSegmented() && m_queue.isEmpty())
+            m_muxer.flush();
+
+        m_connected.store(m_muxer.isConnected());
+        m_keyframeRequested.store(m_muxer.isKeyframeRequested());
+    }
+
+    if (m_muxer.isConnected())
+        m_muxer.close(true);
+
+    m_connected.store(false);
+}
+
+void OutputWriter::clearQueue()
+{
+    Packet item;
+
+    while (m_queue.tryDequeue(&item))
+        av_packet_free(&item.packet);
+}
+
+bool OutputWriter::isSegmented() const
+{
+    return m_segmentDuration > 0 || m_segmentSize > 0;
+}
+
+void OutputWriter::startSegmentAt(const Packet &item)
+{
+    int64_t time = av_rescale_q(item.packet->dts != AV_NOPTS_VALUE ? item.packet->dts : item.packet->pts,
+                                item.timeBase, av_make_q(1, 1000));
+
+    if (m_segmentStartTime == AV_NOPTS_VALUE)
+        m_segmentStartTime = time;
+
+    bool full = (m_segmentDuration > 0 && time - m_segmentStartTime >= m_segmentDuration)
+            || (m_segmentSize > 0 && m_muxer.totalWrittenBytes() - m_segmentStartBytes >= m_segmentSize);
+
+    //the group of pictures before the keyframe is complete, a crash loses at most the one being written
+    if (!full || !m_muxer.isConnected()) {
+        m_muxer.flush();
+        return;
+    }
+
+    //a failing open is retried by the muxer like a lost connection
+    m_muxer.close(true);
+    m_muxer.setUrl(segmentUrl(m_segmentCount.fetchAndAddRelaxed(1) + 1));
+    m_muxer.open();
+
+    m_segmentStartTime = time;
+    m_segmentStartBytes = m_muxer.totalWrittenBytes();
+}
+
+QString OutputWriter::segmentUrl(int index) const
+{
+    return m_segmentPrefix + QString("-%1").arg(index, 5, 10, QChar('0')) + m_segmentSuffix;
+}
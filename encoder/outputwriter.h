@@ -0,0 +1,149 @@
+/****************************************************************************
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License as published by the Free Software Foundation; either
+** version 2.1 of the License, or (at your option) any later version.
+**
+** This library is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public
+** License along with this library; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**
+****************************************************************************/
+
+
+#ifndef OUTPUTWRITER_H
+#define OUTPUTWRITER_H
+
+#include "muxer.h"
+#include "helpers/boundedqueue.h"
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QVariantMap>
+#include <QWaitCondition>
+
+class QThread;
+
+//! The OutputWriter class writes encoded packets to one output on a thread of its own.
+/*!
+  writePacket() only takes a reference to the packet data and queues it, so the encoder thread never waits for the
+  output. The thread of the writer passes the packets to its Muxer, which has its own reconnect buffer and reconnect
+  attempts. A slow or broken output therefore affects only its own viewers. Whenever the queue runs empty the muxer
+  is flushed, so packets queued while the network was stalled go out in one large write.
+
+  If the queue is full, the output can not keep up. The new packet is dropped, and so is everything after it up to
+  the next video keyframe, so that viewers can decode again.
+
+  A recording is split into segments by setSegmentLimits(). Each segment is a complete file with its own header and
+  trailer, so a crash loses at most the segment being written. Segments start at video keyframes, and instead of
+  on an empty queue the muxer is flushed at every keyframe, so the files are written in whole groups of pictures.
+
+  The Muxer is configured through muxer() before start().
+*/
+class OutputWriter
+{
+public:
+    OutputWriter();
+    ~OutputWriter();
+
+    /*! Returns the muxer of the output, its settings may only be changed while the writer is stopped. */
+    Muxer *muxer();
+    const Muxer *muxer() const;
+
+    /*! Sets how many packets may wait for the output. The default value is 1024. */
+    void setQueueCapacity(int capacity);
+    int queueCapacity() const;
+
+    /*!
+      Splits the output into segments of at most \a msecs and \a bytes, 0 disables a limit and the default 0 for both
+      writes a single file. A new segment starts at the first video keyframe past a limit. The segments are named
+      after the url of the muxer with the start time of the recording in milliseconds and the segment number
+      inserted before the extension, e.g. "recording-20240131-142500123-00001.mp4". If such a file exists already,
+      a number is appended to the start time. It may only be called while the writer is stopped.
+    */
+    void setSegmentLimits(int msecs, qint64 bytes);
+    int segmentDuration() const;
+    qint64 segmentSize() const;
+
+    /*!
+      Starts the thread, which opens the output unless the muxer is open already. An output failing to open is
+      reconnected like a lost one.
+    */
+    void start();
+    /*!
+      Writes the queued packets and the trailer, then stops the thread. If the output does not finish within a few
+      seconds, its blocking writes are interrupted and it is closed without the trailer.
+    */
+    void stop();
+
+    /*! Queues \a packet with timestamps in \a timeBase for the stream \a streamIndex, \a packet is not changed. */
+    void writePacket(const AVPacket *packet, int streamIndex, AVRational timeBase);
+
+    bool isConnected() const;
+    /*!
+      Returns true while the output waits for a video keyframe, after an overflow of the queue or a reconnect.
+      It is called from the thread calling writePacket().
+    */
+    bool isKeyframeRequested() const;
+    /*! Returns true if the output has given up after its reconnect attempts, later packets are discarded. */
+    bool hasFailed() const;
+    /*! Returns count of packets dropped because the queue was full. */
+    int droppedPacketCount() const;
+    /*! Returns count of packets waiting for the output. */
+    int queueDepth() const;
+
+    /*!
+      Returns the statistics of the output: url, connected, failed, bytesWritten, pendingPacketCount, reconnectCount,
+      droppedPacketCount, queueDepth, segmentCount and the latency map writeTime. It may be called from any thread.
+    */
+    QVariantMap statistics() const;
+
+private:
+    Q_DISABLE_COPY(OutputWriter)
+
+    friend class OutputWriterThread;
+
+    struct Packet {
+        AVPacket *packet;
+        int streamIndex;
+        AVRational timeBase;
+    };
+
+    void run();
+    void clearQueue();
+
+    bool isSegmented() const;
+    void startSegmentAt(const Packet &item);
+    QString segmentUrl(int index) const;
+
+    Muxer m_muxer;
+    BoundedQueue<Packet> m_queue;
+    QMutex m_mutex;
+    QWaitCondition m_packetAvailable;
+    QThread *m_thread;
+    QString m_url;
+
+    int m_segmentDuration;
+    qint64 m_segmentSize;
+    QString m_segmentPrefix;
+    QString m_segmentSuffix;
+    int64_t m_segmentStartTime;
+    qint64 m_segmentStartBytes;
+
+    //producer side
+    bool m_waitingForKeyframe;
+
+    QAtomicInt m_connected;
+    QAtomicInt m_keyframeRequested;
+    QAtomicInt m_failed;
+    QAtomicInt m_droppedPacketCount;
+    QAtomicInt m_segmentCount;
+};
+
+#endif // OUTPUTWRITER_H
@@ -0,0 +1,187 @@
+/****************************************************************************
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License as published by the Free Software Foundation; either
+** version 2.1 of the License, or (at your option) any later version.
+**
+** This library is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public
+** License along with this library; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**
+****************************************************************************/
+
+
+#include "renditionencoder.h"
+
+extern "C" {
+#include <libswscale/swscale.h>
+}
+
+#include <QElapsedTimer>
+
+RenditionEncoder::RenditionEncoder()
+    : m_codecContext(NULL)
+    , m_picture(NULL)
+    , m_packet(NULL)
+    , m_scaleContext(NULL)
+    , m_videoStreamIndex(-1)
+    , m_audioStreamIndex(-1)
+    , m_encodedFrameCount(0)
+{
+    //the encoder thread owns the renditions and queues them for every picture
+    setAutoDelete(false);
+}
+
+RenditionEncoder::~RenditionEncoder()
+{
+    close();
+}
+
+bool RenditionEncoder::open(AVCodecContext *videoContext, const AVCodecContext *audioContext)
+{
+    close();
+
+    m_codecContext = videoContext;
+    m_packet = av_packet_alloc();
+
+    m_picture = av_frame_alloc();
+    if (!m_packet || !m_picture)
+        return false;
+
+    m_picture->format = m_codecContext->pix_fmt;
+    m_picture->width = m_codecContext->width;
+    m_picture->height = m_codecContext->height;
+
+    if (av_frame_get_buffer(m_picture, 32) < 0)
+        return false;
+
+    m_videoStreamIndex = m_writer.muxer()->addStream(m_codecContext);
+    m_audioStreamIndex = audioContext ? m_writer.muxer()->addStream(audioContext) : -1;
+
+    m_encodedFrameCount.store(0);
+    m_conversionTime.reset();
+    m_encodingTime.reset();
+
+    m_writer.start();
+
+    return true;
+}
+
+void RenditionEncoder::close()
+{
+    m_writer.stop();
+    m_writer.muxer()->reset();
+
+    if (m_codecContext != NULL)
+        avcodec_free_context(&m_codecContext);
+
+    if (m_picture != NULL)
+        av_frame_free(&m_picture);
+
+    if (m_packet != NULL)
+        av_packet_free(&m_packet);
+
+    sws_freeContext(m_scaleContext);
+    m_scaleContext = NULL;
+
+    m_videoStreamIndex = -1;
+    m_audioStreamIndex = -1;
+}
+
+AVCodecContext *RenditionEncoder::codecContext() const
+{
+    return m_codecContext;
+}
+
+OutputWriter *RenditionEncoder::writer()
+{
+    return &m_writer;
+}
+
+bool RenditionEncoder::scale(const AVFrame *source)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    //the codec may still refer to the previous picture, a new buffer is taken then
+    if (av_frame_make_writable(m_picture) < 0)
+        return false;
+
+    //averaging the covered area is the right filter for downscaling and cheaper than bicubic
+    m_scaleContext = sws_getCachedContext(m_scaleContext, source->width, source->height,
+                                          static_cast<AVPixelFormat>(source->format),
+                                          m_picture->width, m_picture->height,
+                                          static_cast<AVPixelFormat>(m_picture->format), SWS_AREA, NULL, NULL, NULL);
+
+    if (m_scaleContext == NULL)
+        return false;
+
+    sws_scale(m_scaleContext, source->data, source->linesize, 0, source->height, m_picture->data, m_picture->linesize);
+    m_conversionTime.addSample(timer.nsecsElapsed() / 1000);
+
+    return true;
+}
+
+const AVFrame *RenditionEncoder::picture() const
+{
+    return m_picture;
+}
+
+void RenditionEncoder::setFrame(int64_t pts, AVPictureType type)
+{
+    m_picture->pts = pts;
+    m_picture->pict_type = type;
+}
+
+void RenditionEncoder::run()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    if (avcodec_send_frame(m_codecContext, m_picture) < 0)
+        return;
+
+    m_encodingTime.addSample(timer.nsecsElapsed() / 1000);
+    writePackets();
+}
+
+void RenditionEncoder::flush()
+{
+    if (m_codecContext != NULL && avcodec_send_frame(m_codecContext, NULL) >= 0)
+        writePackets();
+}
+
+void RenditionEncoder::writeAudioPacket(const AVPacket *packet, AVRational timeBase)
+{
+    if (m_audioStreamIndex >= 0)
+        m_writer.writePacket(packet, m_audioStreamIndex, timeBase);
+}
+
+QVariantMap RenditionEncoder::statistics() const
+{
+    QVariantMap statistics;
+    statistics["width"] = m_codecContext ? m_codecContext->width : 0;
+    statistics["height"] = m_codecContext ? m_codecContext->height : 0;
+    statistics["bitrate"] = m_codecContext ? static_cast<qint64>(m_codecContext->bit_rate) : 0;
+    statistics["encodedFrameCount"] = m_encodedFrameCount.load();
+    statistics["conversionTime"] = m_conversionTime.toVariantMap();
+    statistics["encodingTime"] = m_encodingTime.toVariantMap();
+    statistics["output"] = m_writer.statistics();
+
+    return statistics;
+}
+
+void RenditionEncoder::writePackets()
+{
+    while (avcodec_receive_packet(m_codecContext, m_packet) >= 0) {
+        m_encodedFrameCount.ref();
+        m_writer.writePacket(m_packet, m_videoStreamIndex, m_codecContext->time_base);
+        av_packet_unref(m_packet);
+    }
+}
@@ -0,0 +1,107 @@
+/****************************************************************************
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License as published by the Free Software Foundation; either
+** version 2.1 of the License, or (at your option) any later version.
+**
+** This library is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public
+** License along with this library; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**
+****************************************************************************/
+
+
+#ifndef RENDITIONENCODER_H
+#define RENDITIONENCODER_H
+
+#ifndef INT64_C
+#define INT64_C(c) (c ## LL)
+#define UINT64_C(c) (c ## ULL)
+#endif
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+#include "outputwriter.h"
+#include "helpers/latencyhistogram.h"
+
+#include <QAtomicInt>
+#include <QRunnable>
+#include <QVariantMap>
+
+struct SwsContext;
+
+//! The RenditionEncoder class encodes one additional resolution of the video for simulcast.
+/*!
+  The encoder thread scales each captured picture into the rendition with scale(). Then it queues the rendition on a
+  thread pool, and run() encodes the picture while the other renditions are encoded on other workers. The packets go
+  to the OutputWriter of the rendition. That writer also receives the audio packets through writeAudioPacket().
+
+  The rendition never decides about keyframes itself, setFrame() passes the picture type chosen for all renditions.
+*/
+class RenditionEncoder : public QRunnable
+{
+public:
+    RenditionEncoder();
+    ~RenditionEncoder();
+
+    /*!
+      Takes over \a videoContext, an opened video encoder, allocates the picture in its size and pixel format, and
+      adds the streams to the writer. \a audioContext may be NULL.
+    */
+    bool open(AVCodecContext *videoContext, const AVCodecContext *audioContext);
+    /*! Stops the writer and frees the encoder. */
+    void close();
+
+    AVCodecContext *codecContext() const;
+    /*! Returns the writer of the rendition, its muxer is configured before open(). */
+    OutputWriter *writer();
+
+    /*! Scales \a source into the picture of the rendition, \a source may be the picture of a larger rendition. */
+    bool scale(const AVFrame *source);
+    /*! Returns the picture filled by scale(). */
+    const AVFrame *picture() const;
+
+    /*! Sets the pts in the codec time base and the forced picture type of the picture to be encoded by run(). */
+    void setFrame(int64_t pts, AVPictureType type);
+
+    /*! Encodes the scaled picture and queues the packets to the writer. */
+    void run();
+    /*! Encodes the pictures held back by the codec, at the end of the stream. */
+    void flush();
+
+    /*! Queues an audio packet with timestamps in \a timeBase to the writer, \a packet is not changed. */
+    void writeAudioPacket(const AVPacket *packet, AVRational timeBase);
+
+    /*!
+      Returns the statistics of the rendition: width, height, bitrate, encodedFrameCount, the latency maps
+      conversionTime and encodingTime, and the OutputWriter::statistics() as output.
+    */
+    QVariantMap statistics() const;
+
+private:
+    Q_DISABLE_COPY(RenditionEncoder)
+
+    void writePackets();
+
+    AVCodecContext *m_codecContext;
+    AVFrame *m_picture;
+    AVPacket *m_packet;
+    SwsContext *m_scaleContext;
+    OutputWriter m_writer;
+    int m_videoStreamIndex;
+    int m_audioStreamIndex;
+
+    QAtomicInt m_encodedFrameCount;
+    LatencyHistogram m_conversionTime;
+    LatencyHistogram m_encodingTime;
+};
+
+#endif // RENDITIONENCODER_H
@@ -43,6 +43,8 @@ VideoCodecSettings::VideoCodecSettings()
     m_trellis = -1;
     m_weightedPPred = static_cast<EncoderGlobal::WeightedPredictionMethod>(-1);
     m_rcLookahead = -1;
+    m_threadCount = -1;
+    m_threadType = static_cast<EncoderGlobal::ThreadType>(-1);
     m_flags = static_cast<EncoderGlobal::Flags>(-1);
     m_flags2 = static_cast<EncoderGlobal::Flags2>(-1);
 }
@@ -277,6 +279,26 @@ int VideoCodecSettings::rcLookahead() const
     return m_rcLookahead;
 }
 
+void VideoCodecSettings::setThreadCount(int count)
+{
+    m_threadCount = count;
+}
+
+int VideoCodecSettings::threadCount() const
+{
+    return m_threadCount;
+}
+
+void VideoCodecSettings::setThreadType(EncoderGlobal::ThreadType type)
+{
+    m_threadType = type;
+}
+
+EncoderGlobal::ThreadType VideoCodecSettings::threadType() const
+{
+    return m_threadType;
+}
+
 void VideoCodecSettings::setFlags(EncoderGlobal::Flags flags)
 {
     m_flags = flags;
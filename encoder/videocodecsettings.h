@@ -165,6 +165,20 @@ public:
     void setRcLookahead(int value);
     int rcLookahead() const;
 
+    /*!
+     * \brief Number of encoding threads, 0 lets the codec choose. It is equal to the thread_count parameter in AVCodecContext.
+     * If it is not set the encoder uses one thread per CPU core.
+     */
+    void setThreadCount(int count);
+    int threadCount() const;
+
+    /*!
+     * \brief Threading method. It is equal to the thread_type parameter in AVCodecContext.
+     * If it is not set the encoder uses EncoderGlobal::SliceThreading which does not add frame delay.
+     */
+    void setThreadType(EncoderGlobal::ThreadType type);
+    EncoderGlobal::ThreadType threadType() const;
+
     /*!
      * \brief It is equal to the flags parameter in AVCodecContext.
      */
@@ -201,6 +215,8 @@ private:
     int m_trellis; /*!< Trellis RD quantization. */
     EncoderGlobal::WeightedPredictionMethod m_weightedPPred; /*!< Explicit P-frame weighted prediction analysis method. */
     int m_rcLookahead; /*!< RC lookahead Number of frames for frametype and ratecontrol lookahead. */
+    int m_threadCount; /*!< Number of encoding threads. */
+    EncoderGlobal::ThreadType m_threadType; /*!< Threading method. */
     EncoderGlobal::Flags m_flags; /*!< */
     EncoderGlobal::Flags2 m_flags2; /*!< */
 };
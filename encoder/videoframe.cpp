@@ -0,0 +1,357 @@
+/****************************************************************************
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License as published by the Free Software Foundation; either
+** version 2.1 of the License, or (at your option) any later version.
+**
+** This library is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public
+** License along with this library; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**
+****************************************************************************/
+
+#include "videoframe.h"
+
+#include <QSharedData>
+
+#define VIDEOFRAME_ALIGNMENT 32
+
+class VideoFrameData : public QSharedData
+{
+public:
+    VideoFrameData();
+    ~VideoFrameData();
+
+    QSize size;
+    EncoderGlobal::EncoderPixelFormat format;
+    int planeCount;
+    uchar *planes[VIDEOFRAME_MAX_PLANES];
+    int bytesPerLine[VIDEOFRAME_MAX_PLANES];
+
+    //only one of the owners below is set
+    QImage image;
+    uchar *buffer;
+    VideoFrame::ReleaseFunction release;
+    void *opaque;
+};
+
+VideoFrameData::VideoFrameData()
+    : format(EncoderGlobal::PIXEL_FORMAT_NONE)
+    , planeCount(0)
+    , buffer(0)
+    , release(0)
+    , opaque(0)
+{
+    for (int i = 0; i < VIDEOFRAME_MAX_PLANES; ++i) {
+        planes[i] = 0;
+        bytesPerLine[i] = 0;
+    }
+}
+
+VideoFrameData::~VideoFrameData()
+{
+    if (buffer)
+        qFreeAligned(buffer);
+
+    if (release)
+        release(opaque);
+}
+
+static int alignedBytes(int bytes)
+{
+    return (bytes + VIDEOFRAME_ALIGNMENT - 1) & ~(VIDEOFRAME_ALIGNMENT - 1);
+}
+
+//fills line sizes and line counts of every plane, returns count of planes or 0 for unsupported formats
+static int planeLayout(EncoderGlobal::EncoderPixelFormat format, int width, int height, int bytesPerLine[], int lines[])
+{
+    int chromaWidth = (width + 1) / 2;
+    int chromaHeight = (height + 1) / 2;
+
+    switch (format) {
+    case EncoderGlobal::YUV420P:
+    case EncoderGlobal::YUVJ420P:
+        bytesPerLine[0] = width; lines[0] = height;
+        bytesPerLine[1] = chromaWidth; lines[1] = chromaHeight;
+        bytesPerLine[2] = chromaWidth; lines[2] = chromaHeight;
+        return 3;
+
+    case EncoderGlobal::YUV422P:
+    case EncoderGlobal::YUVJ422P:
+        bytesPerLine[0] = width; lines[0] = height;
+        bytesPerLine[1] = chromaWidth; lines[1] = height;
+        bytesPerLine[2] = chromaWidth; lines[2] = height;
+        return 3;
+
+    case EncoderGlobal::YUV444P:
+    case EncoderGlobal::YUVJ444P:
+        bytesPerLine[0] = width; lines[0] = height;
+        bytesPerLine[1] = width; lines[1] = height;
+        bytesPerLine[2] = width; lines[2] = height;
+        return 3;
+
+    case EncoderGlobal::NV12:
+    case EncoderGlobal::NV21:
+        bytesPerLine[0] = width; lines[0] = height;
+        bytesPerLine[1] = chromaWidth * 2; lines[1] = chromaHeight;
+        return 2;
+
+    case EncoderGlobal::GRAY8:
+        bytesPerLine[0] = width; lines[0] = height;
+        return 1;
+
+    case EncoderGlobal::YUYV422:
+    case EncoderGlobal::UYVY422:
+    case EncoderGlobal::RGB565LE:
+    case EncoderGlobal::BGR565LE:
+        bytesPerLine[0] = width * 2; lines[0] = height;
+        return 1;
+
+    case EncoderGlobal::RGB24:
+    case EncoderGlobal::BGR24:
+        bytesPerLine[0] = width * 3; lines[0] = height;
+        return 1;
+
+    case EncoderGlobal::ARGB:
+    case EncoderGlobal::RGBA:
+    case EncoderGlobal::ABGR:
+    case EncoderGlobal::BGRA:
+        bytesPerLine[0] = width * 4; lines[0] = height;
+        return 1;
+
+    default:
+        return 0;
+    }
+}
+
+VideoFrame::VideoFrame()
+{
+}
+
+VideoFrame::VideoFrame(const QImage &image)
+{
+    EncoderGlobal::EncoderPixelFormat format = VideoFrame::pixelFormat(image);
+    if (image.isNull() || format == EncoderGlobal::PIXEL_FORMAT_NONE)
+        return;
+
+    d = new VideoFrameData;
+    d->size = image.size();
+    d->format = format;
+    d->image = image;
+    d->planeCount = 1;
+    //the encoder only reads the pixels, so the image is never detached
+    d->planes[0] = const_cast<uchar *>(image.constBits());
+    d->bytesPerLine[0] = image.bytesPerLine();
+}
+
+VideoFrame::VideoFrame(const QSize &size, EncoderGlobal::EncoderPixelFormat format)
+{
+    int bytesPerLine[VIDEOFRAME_MAX_PLANES];
+    int lines[VIDEOFRAME_MAX_PLANES];
+    int planeCount = planeLayout(format, size.width(), size.height(), bytesPerLine, lines);
+
+    if (size.isEmpty() || planeCount == 0)
+        return;
+
+    int bufferSize = 0;
+    for (int i = 0; i < planeCount; ++i)
+        bufferSize += alignedBytes(bytesPerLine[i]) * lines[i];
+
+    d = new VideoFrameData;
+    d->size = size;
+    d->format = format;
+    d->planeCount = planeCount;
+    d->buffer = static_cast<uchar *>(qMallocAligned(bufferSize, VIDEOFRAME_ALIGNMENT));
+
+    uchar *plane = d->buffer;
+    for (int i = 0; i < planeCount; ++i) {
+        d->planes[i] = plane;
+        d->bytesPerLine[i] = alignedBytes(bytesPerLine[i]);
+        plane += d->bytesPerLine[i] * lines[i];
+    }
+}
+
+VideoFrame::VideoFrame(const QSize &size, EncoderGlobal::EncoderPixelFormat format, uchar *const planes[], const int bytesPerLine[],
+                       int planeCount, ReleaseFunction release, void *opaque)
+{
+    d = new VideoFrameData;
+    d->size = size;
+    d->format = format;
+    d->planeCount = qMin(planeCount, VIDEOFRAME_MAX_PLANES);
+    d->release = release;
+    d->opaque = opaque;
+
+    for (int i = 0; i < d->planeCount; ++i) {
+        d->planes[i] = planes[i];
+        d->bytesPerLine[i] = bytesPerLine[i];
+    }
+}
+
+VideoFrame::VideoFrame(const VideoFrame &other)
+    : d(other.d)
+{
+}
+
+VideoFrame::~VideoFrame()
+{
+}
+
+VideoFrame &VideoFrame::operator=(const VideoFrame &other)
+{
+    d = other.d;
+    return *this;
+}
+
+bool VideoFrame::isNull() const
+{
+    return !d;
+}
+
+bool VideoFrame::isShared() const
+{
+    return d && d->ref.load() > 1;
+}
+
+QSize VideoFrame::size() const
+{
+    return d ? d->size : QSize();
+}
+
+int VideoFrame::width() const
+{
+    return size().width();
+}
+
+int VideoFrame::height() const
+{
+    return size().height();
+}
+
+EncoderGlobal::EncoderPixelFormat VideoFrame::pixelFormat() const
+{
+    return d ? d->format : EncoderGlobal::PIXEL_FORMAT_NONE;
+}
+
+int VideoFrame::planeCount() const
+{
+    return d ? d->planeCount : 0;
+}
+
+uchar *VideoFrame::bits(int plane)
+{
+    return (d && plane >= 0 && plane < d->planeCount) ? d->planes[plane] : 0;
+}
+
+const uchar *VideoFrame::constBits(int plane) const
+{
+    return (d && plane >= 0 && plane < d->planeCount) ? d->planes[plane] : 0;
+}
+
+int VideoFrame::bytesPerLine(int plane) const
+{
+    return (d && plane >= 0 && plane < d->planeCount) ? d->bytesPerLine[plane] : 0;
+}
+
+QImage VideoFrame::toImage() const
+{
+    if (!d)
+        return QImage();
+
+    if (!d->image.isNull())
+        return d->image;
+
+    //BGR24 has no QImage counterpart, so it is swapped into RGB888
+    if (d->format == EncoderGlobal::BGR24) {
+        return QImage(d->planes[0], d->size.width(), d->size.height(), d->bytesPerLine[0],
+                      QImage::Format_RGB888).rgbSwapped();
+    }
+
+    QImage::Format format = VideoFrame::imageFormat(d->format);
+    if (format == QImage::Format_Invalid)
+        return QImage();
+
+    QImage image(d->planes[0], d->size.width(), d->size.height(), d->bytesPerLine[0], format);
+
+    if (d->format == EncoderGlobal::MONOWHITE)
+        image.setColorTable(QVector<QRgb>() << qRgb(255, 255, 255) << qRgb(0, 0, 0));
+
+    return image.copy();
+}
+
+QImage::Format VideoFrame::imageFormat(EncoderGlobal::EncoderPixelFormat format)
+{
+    switch (format) {
+    case EncoderGlobal::BGRA:
+        return QImage::Format_ARGB32;
+
+    case EncoderGlobal::RGBA:
+        return QImage::Format_RGBA8888;
+
+    case EncoderGlobal::RGB565LE:
+        return QImage::Format_RGB16;
+
+    case EncoderGlobal::RGB24:
+        return QImage::Format_RGB888;
+
+    case EncoderGlobal::MONOWHITE:
+        return QImage::Format_Mono;
+
+    default:
+        return QImage::Format_Invalid;
+    }
+}
+
+EncoderGlobal::EncoderPixelFormat VideoFrame::pixelFormat(QImage::Format format)
+{
+    EncoderGlobal::EncoderPixelFormat newFormat;
+
+    switch (format) {
+    case QImage::Format_ARGB32:
+    case QImage::Format_ARGB32_Premultiplied:
+    case QImage::Format_RGB32:
+        newFormat = EncoderGlobal::BGRA;
+        break;
+
+    case QImage::Format_RGBA8888:
+    case QImage::Format_RGBA8888_Premultiplied:
+    case QImage::Format_RGBX8888:
+        newFormat = EncoderGlobal::RGBA;
+        break;
+
+    case QImage::Format_RGB16:
+        newFormat = EncoderGlobal::RGB565LE;
+        break;
+
+    case QImage::Format_RGB888:
+        newFormat = EncoderGlobal::RGB24;
+        break;
+
+    //MONOWHITE is MSB first, MonoLSB images are converted by the caller
+    case QImage::Format_Mono:
+        newFormat = EncoderGlobal::MONOWHITE;
+        break;
+
+    default:
+        newFormat = EncoderGlobal::PIXEL_FORMAT_NONE;
+        break;
+    }
+
+    return newFormat;
+}
+
+EncoderGlobal::EncoderPixelFormat VideoFrame::pixelFormat(const QImage &image)
+{
+    //MONOWHITE stores white as 0 and black as 1, other color tables are converted by the caller
+    if (image.format() == QImage::Format_Mono
+            && (image.colorCount() != 2 || qGray(image.color(0)) != 255 || qGray(image.color(1)) != 0)) {
+        return EncoderGlobal::PIXEL_FORMAT_NONE;
+    }
+
+    return VideoFrame::pixelFormat(image.format());
+}
@@ -0,0 +1,109 @@
+/****************************************************************************
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License as published by the Free Software Foundation; either
+** version 2.1 of the License, or (at your option) any later version.
+**
+** This library is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public
+** License along with this library; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**
+****************************************************************************/
+
+#ifndef VIDEOFRAME_H
+#define VIDEOFRAME_H
+
+#include "encoderglobal.h"
+
+#include <QExplicitlySharedDataPointer>
+#include <QImage>
+#include <QMetaType>
+#include <QSize>
+
+#define VIDEOFRAME_MAX_PLANES 4
+
+class VideoFrameData;
+
+//! The VideoFrame class holds a raw video picture in packed or planar pixel format.
+/*!
+  VideoFrame is explicitly shared: copies refer to the same pixels, which are released when the last copy is destroyed.
+  It lets grabbers pass pictures in their native pixel format (for example YUV420P or NV12) to the Encoder, which uses the planes
+  directly when they already match the codec format, so no QImage and no colorspace conversion is involved.
+
+  Here is an example of the VideoFrame usage:
+  @code
+  VideoFrame frame(QSize(1920, 1080), EncoderGlobal::NV12);
+  memcpy(frame.bits(0), lumaData, frame.bytesPerLine(0) * frame.height());
+  memcpy(frame.bits(1), chromaData, frame.bytesPerLine(1) * frame.height() / 2);
+  encoder->encodeVideoFrame(frame, pts);
+  @endcode
+*/
+class VideoFrame
+{
+public:
+    /*! Prototype of the function releasing external planes passed to the VideoFrame constructor. */
+    typedef void (*ReleaseFunction)(void *opaque);
+
+    /*! Constructs a null frame. */
+    VideoFrame();
+    /*! Constructs a frame sharing the pixels of \a image. No pixel data is copied. */
+    VideoFrame(const QImage &image);
+    /*!
+      Constructs a frame with allocated planes of the given size and pixel format.
+      If the format is not supported by planeCount() the frame is null.
+    */
+    VideoFrame(const QSize &size, EncoderGlobal::EncoderPixelFormat format);
+    /*!
+      Constructs a frame referring to external planes. The frame does not copy the pixels, instead \a release is called
+      with \a opaque when the last copy of the frame is destroyed.
+    */
+    VideoFrame(const QSize &size, EncoderGlobal::EncoderPixelFormat format, uchar *const planes[], const int bytesPerLine[],
+               int planeCount, ReleaseFunction release, void *opaque);
+    VideoFrame(const VideoFrame &other);
+    ~VideoFrame();
+
+    VideoFrame &operator=(const VideoFrame &other);
+
+    bool isNull() const;
+    /*! Returns true if the pixels are referred to by another VideoFrame copy. */
+    bool isShared() const;
+
+    QSize size() const;
+    int width() const;
+    int height() const;
+    EncoderGlobal::EncoderPixelFormat pixelFormat() const;
+
+    int planeCount() const;
+    uchar *bits(int plane);
+    const uchar *constBits(int plane) const;
+    int bytesPerLine(int plane) const;
+
+    /*!
+      Returns the frame as a QImage. It is shallow for frames constructed from a QImage and a copy for packed RGB formats.
+      A null image is returned for YUV formats.
+    */
+    QImage toImage() const;
+
+    /*! Returns the QImage pixel format matching \a format or QImage::Format_Invalid. */
+    static QImage::Format imageFormat(EncoderGlobal::EncoderPixelFormat format);
+    /*!
+      Returns the pixel format matching the QImage \a format or EncoderGlobal::PIXEL_FORMAT_NONE.
+      QImage::Format_Mono is assumed to have a white and black color table.
+    */
+    static EncoderGlobal::EncoderPixelFormat pixelFormat(QImage::Format format);
+    /*! Returns the pixel format matching \a image, which also depends on the color table of a mono image. */
+    static EncoderGlobal::EncoderPixelFormat pixelFormat(const QImage &image);
+
+private:
+    QExplicitlySharedDataPointer<VideoFrameData> d;
+};
+
+Q_DECLARE_METATYPE(VideoFrame)
+
+#endif // VIDEOFRAME_H
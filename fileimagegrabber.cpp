@@ -0,0 +1,381 @@
+/****************************************************************************
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License as published by the Free Software Foundation; either
+** version 2.1 of the License, or (at your option) any later version.
+**
+** This library is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public
+** License along with this library; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**
+****************************************************************************/
+#include "fileimagegrabber.h"
+
+#ifndef INT64_C
+#define INT64_C(c) (c ## LL)
+#define UINT64_C(c) (c ## ULL)
+#endif
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libswscale/swscale.h>
+}
+
+#include <QElapsedTimer>
+#include <QMetaMethod>
+#include <QMutexLocker>
+#include <QThread>
+
+#define FRAME_POOL_SIZE 4
+#define DEFAULT_FRAME_DURATION 40
+#define MAXIMUM_SLEEP 10
+
+//releases the decoder reference held by a frame passed on without copying
+static void releaseFrame(void *opaque)
+{
+    AVFrame *frame = static_cast<AVFrame *>(opaque);
+    av_frame_free(&frame);
+}
+
+FileImageGrabber::FileImageGrabber(QObject *parent)
+    : AbstractImageGrabber(parent)
+    , m_pacing(FileImageGrabber::RealTimePacing)
+    , m_looping(true)
+    , m_formatContext(NULL)
+    , m_codecContext(NULL)
+    , m_packet(NULL)
+    , m_frame(NULL)
+    , m_scaleContext(NULL)
+    , m_streamIndex(-1)
+    , m_frameTime(0)
+    , m_loopOffset(0)
+    , m_lastFrameTime(-1)
+{
+    //there is no device to wait for
+    setInitializationTime(0);
+}
+
+FileImageGrabber::~FileImageGrabber()
+{
+    //grab() holds the mutex until it returns
+    setStopRequest(true);
+
+    QMutexLocker locker(&m_fileMutex);
+    closeFile();
+}
+
+void FileImageGrabber::setFileName(const QString &fileName)
+{
+    if (state() == AbstractGrabber::StoppedState)
+        m_fileName = fileName;
+}
+
+QString FileImageGrabber::fileName() const
+{
+    return m_fileName;
+}
+
+void FileImageGrabber::setPacing(FileImageGrabber::Pacing pacing)
+{
+    m_pacing = pacing;
+}
+
+FileImageGrabber::Pacing FileImageGrabber::pacing() const
+{
+    return m_pacing;
+}
+
+void FileImageGrabber::setLooping(bool looping)
+{
+    m_looping = looping;
+}
+
+bool FileImageGrabber::isLooping() const
+{
+    return m_looping;
+}
+
+QSize FileImageGrabber::videoSize(const QString &fileName)
+{
+#if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58, 9, 100)
+    av_register_all();
+#endif
+
+    AVFormatContext *context = NULL;
+    if (avformat_open_input(&context, fileName.toUtf8().constData(), NULL, NULL) < 0)
+        return QSize();
+
+    QSize size;
+    if (avformat_find_stream_info(context, NULL) >= 0) {
+        int index = av_find_best_stream(context, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+        if (index >= 0)
+            size = QSize(context->streams[index]->codecpar->width, context->streams[index]->codecpar->height);
+    }
+
+    avformat_close_input(&context);
+
+    return size;
+}
+
+bool FileImageGrabber::start()
+{
+    if (state() != AbstractGrabber::StoppedState)
+        return false;
+
+    if (!openFile()) {
+        setError(AbstractGrabber::DeviceOpenError, tr("Unable to decode the video stream of %1.").arg(m_fileName));
+        return false;
+    }
+
+    return AbstractImageGrabber::start();
+}
+
+void FileImageGrabber::grab()
+{
+    QMutexLocker locker(&m_fileMutex);
+
+    QElapsedTimer clock;
+    clock.start();
+
+    qint64 firstFrameTime = -1;
+    int pts = -1;
+
+    Q_FOREVER {
+        if (isStopRequest() || isPauseRequest())
+            break;
+
+        VideoFrame frame = captureVideoFrame();
+
+        //the end of a file which is not looped, or a broken file
+        if (frame.isNull()) {
+            setStopRequest(true);
+            break;
+        }
+
+        setGrabbedFrameCount(grabbedFrameCount() + 1);
+
+        //after a resume the clock starts over at the next frame
+        if (firstFrameTime == -1)
+            firstFrameTime = m_frameTime;
+
+        if (m_pacing == FileImageGrabber::RealTimePacing) {
+            qint64 delay;
+            while ((delay = m_frameTime - firstFrameTime - clock.elapsed()) > 0 && !isStopRequest() && !isPauseRequest())
+                QThread::msleep(qMin<qint64>(delay, MAXIMUM_SLEEP));
+        }
+
+        //the encoder ignores frames stamped 0
+        pts = static_cast<int>(m_frameTime) + 1;
+        Q_EMIT videoFrameAvailable(frame, pts);
+
+        if (isSignalConnected(QMetaMethod::fromSignal(&AbstractImageGrabber::frameAvailable)))
+            Q_EMIT frameAvailable(frame.toImage(), pts);
+    }
+
+    bool stopped = isStopRequest();
+    if (stopped)
+        closeFile();
+
+    setState(stopped ? AbstractGrabber::StoppedState : AbstractGrabber::SuspendedState);
+
+    //reset stop and pause flags
+    setStopRequest(false);
+    setPauseRequest(false);
+
+    Q_EMIT videoFrameAvailable(VideoFrame(), pts);
+    Q_EMIT frameAvailable(QImage(), pts);
+}
+
+QImage FileImageGrabber::captureFrame()
+{
+    return captureVideoFrame().toImage();
+}
+
+VideoFrame FileImageGrabber::captureVideoFrame()
+{
+    if (!m_formatContext)
+        return VideoFrame();
+
+    if (!decodeFrame()) {
+        if (!m_looping || !rewind() || !decodeFrame())
+            return VideoFrame();
+    }
+
+    AVStream *stream = m_formatContext->streams[m_streamIndex];
+    int64_t timestamp = m_frame->best_effort_timestamp;
+    int64_t startTime = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+
+    qint64 frameTime = timestamp != AV_NOPTS_VALUE ?
+                av_rescale_q(timestamp - startTime, stream->time_base, av_make_q(1, 1000)) + m_loopOffset :
+                m_lastFrameTime + DEFAULT_FRAME_DURATION;
+
+    //timestamps must grow for the encoder, even in broken files
+    m_frameTime = qMax(frameTime, m_lastFrameTime + 1);
+    m_lastFrameTime = m_frameTime;
+
+    return convertFrame();
+}
+
+bool FileImageGrabber::openFile()
+{
+    closeFile();
+
+#if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58, 9, 100)
+    av_register_all();
+#endif
+
+    if (avformat_open_input(&m_formatContext, m_fileName.toUtf8().constData(), NULL, NULL) < 0)
+        return false;
+
+    if (avformat_find_stream_info(m_formatContext, NULL) < 0) {
+        closeFile();
+        return false;
+    }
+
+    m_streamIndex = av_find_best_stream(m_formatContext, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    if (m_streamIndex < 0) {
+        closeFile();
+        return false;
+    }
+
+    const AVCodecParameters *parameters = m_formatContext->streams[m_streamIndex]->codecpar;
+    const AVCodec *codec = avcodec_find_decoder(parameters->codec_id);
+    if (!codec) {
+        closeFile();
+        return false;
+    }
+
+    m_codecContext = avcodec_alloc_context3(codec);
+    if (!m_codecContext
+            || avcodec_parameters_to_context(m_codecContext, parameters) < 0
+            || avcodec_open2(m_codecContext, codec, NULL) < 0) {
+        closeFile();
+        return false;
+    }
+
+    m_packet = av_packet_alloc();
+    m_frame = av_frame_alloc();
+
+    m_frameTime = 0;
+    m_loopOffset = 0;
+    m_lastFrameTime = -1;
+
+    return m_packet && m_frame;
+}
+
+void FileImageGrabber::closeFile()
+{
+    if (m_codecContext)
+        avcodec_free_context(&m_codecContext);
+
+    if (m_formatContext)
+        avformat_close_input(&m_formatContext);
+
+    av_packet_free(&m_packet);
+    av_frame_free(&m_frame);
+
+    sws_freeContext(m_scaleContext);
+    m_scaleContext = NULL;
+
+    m_streamIndex = -1;
+    m_framePool.clear();
+}
+
+bool FileImageGrabber::rewind()
+{
+    if (av_seek_frame(m_formatContext, m_streamIndex, m_formatContext->streams[m_streamIndex]->start_time != AV_NOPTS_VALUE ?
+                      m_formatContext->streams[m_streamIndex]->start_time : 0, AVSEEK_FLAG_BACKWARD) < 0) {
+        return false;
+    }
+
+    avcodec_flush_buffers(m_codecContext);
+
+    //the next loop starts one frame after the last frame of this one
+    AVRational frameRate = m_formatContext->streams[m_streamIndex]->avg_frame_rate;
+    m_loopOffset = m_lastFrameTime + (frameRate.num > 0 && frameRate.den > 0 ?
+                                          av_rescale_q(1, av_inv_q(frameRate), av_make_q(1, 1000)) : DEFAULT_FRAME_DURATION);
+
+    return true;
+}
+
+bool FileImageGrabber::decodeFrame()
+{
+    Q_FOREVER {
+        int ret = avcodec_receive_frame(m_codecContext, m_frame);
+        if (ret >= 0)
+            return true;
+
+        if (ret != AVERROR(EAGAIN))
+            return false;
+
+        //the decoder needs more input, at the end of the file it is drained
+        if (av_read_frame(m_formatContext, m_packet) < 0) {
+            avcodec_send_packet(m_codecContext, NULL);
+            continue;
+        }
+
+        if (m_packet->stream_index == m_streamIndex)
+            avcodec_send_packet(m_codecContext, m_packet);
+
+        av_packet_unref(m_packet);
+    }
+}
+
+VideoFrame FileImageGrabber::convertFrame()
+{
+    QSize size(m_frame->width, m_frame->height);
+
+    //the frame takes over the reference to the decoded picture, so no pixel is copied
+    if (m_frame->format == AV_PIX_FMT_YUV420P) {
+        AVFrame *reference = av_frame_alloc();
+        if (reference) {
+            av_frame_move_ref(reference, m_frame);
+            return VideoFrame(size, EncoderGlobal::YUV420P, reference->data, reference->linesize, 3, releaseFrame, reference);
+        }
+    }
+
+    m_scaleContext = sws_getCachedContext(m_scaleContext,
+                                          m_frame->width, m_frame->height, static_cast<AVPixelFormat>(m_frame->format),
+                                          m_frame->width, m_frame->height, AV_PIX_FMT_YUV420P,
+                                          SWS_BILINEAR, NULL, NULL, NULL);
+
+    VideoFrame frame;
+    if (m_scaleContext) {
+        frame = pooledFrame(size);
+
+        uint8_t *planes[3];
+        int bytesPerLine[3];
+        for (int i = 0; i < 3; ++i) {
+            planes[i] = frame.bits(i);
+            bytesPerLine[i] = frame.bytesPerLine(i);
+        }
+
+        sws_scale(m_scaleContext, m_frame->data, m_frame->linesize, 0, m_frame->height, planes, bytesPerLine);
+    }
+
+    av_frame_unref(m_frame);
+
+    return frame;
+}
+
+VideoFrame FileImageGrabber::pooledFrame(const QSize &size)
+{
+    //a frame is free again as soon as the encoder has released its copy
+    for (int i = 0; i < m_framePool.count(); ++i) {
+        if (!m_framePool.at(i).isShared() && m_framePool.at(i).size() == size)
+            return m_framePool.at(i);
+    }
+
+    VideoFrame frame(size, EncoderGlobal::YUV420P);
+    if (m_framePool.count() < FRAME_POOL_SIZE)
+        m_framePool.append(frame);
+
+    return frame;
+}
@@ -0,0 +1,120 @@
+/****************************************************************************
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License as published by the Free Software Foundation; either
+** version 2.1 of the License, or (at your option) any later version.
+**
+** This library is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public
+** License along with this library; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**
+****************************************************************************/
+#ifndef FILEIMAGEGRABBER_H
+#define FILEIMAGEGRABBER_H
+
+#include "abstractimagegrabber.h"
+
+#include <QList>
+#include <QMutex>
+#include <QString>
+
+struct AVFormatContext;
+struct AVCodecContext;
+struct AVPacket;
+struct AVFrame;
+struct SwsContext;
+
+//! The FileImageGrabber class decodes the video stream of a local media file instead of capturing a device.
+/*!
+  Frames keep the timestamps of the file. With FileImageGrabber::RealTimePacing they are emitted when they are due, like
+  a camera would deliver them; with FileImageGrabber::AsFastAsPossiblePacing they are emitted as soon as they are decoded,
+  which should be combined with Encoder::BlockProducer so that no frame is dropped.
+
+  YUV420P pictures are passed to the Encoder without copying, other pixel formats are converted to YUV420P once.
+  frameAvailable() carries null images, as frames are not RGB.
+
+  AbstractImageGrabber::setLatency() is not used, the pacing follows the file.
+*/
+class FileImageGrabber : public AbstractImageGrabber
+{
+    Q_OBJECT
+
+public:
+    /*! This enum describes when decoded frames are emitted. */
+    enum Pacing {
+        RealTimePacing = 0, /*!< Frames are emitted at the rate they were recorded. */
+        AsFastAsPossiblePacing /*!< Frames are emitted as fast as they are decoded. */
+    };
+
+    FileImageGrabber(QObject *parent = 0);
+    virtual ~FileImageGrabber();
+
+    /*!
+      Sets the media file to be decoded. It can only be changed while the grabber is stopped.
+      \sa fileName()
+    */
+    void setFileName(const QString &fileName);
+    QString fileName() const;
+
+    /*!
+      Sets the pacing of emitted frames. The default value is FileImageGrabber::RealTimePacing.
+      \sa pacing()
+    */
+    void setPacing(FileImageGrabber::Pacing pacing);
+    FileImageGrabber::Pacing pacing() const;
+
+    /*!
+      Enables starting over at the end of the file, timestamps keep growing. Enabled by default.
+      When disabled, the grabber stops at the end of the file.
+      \sa isLooping()
+    */
+    void setLooping(bool looping);
+    bool isLooping() const;
+
+    /*!
+      Returns the size of the video stream of \a fileName, or an invalid size if the file has no video stream.
+    */
+    static QSize videoSize(const QString &fileName);
+
+public Q_SLOTS:
+    bool start();
+
+protected:
+    void grab();
+    QImage captureFrame();
+    VideoFrame captureVideoFrame();
+
+private:
+    bool openFile();
+    void closeFile();
+    bool rewind();
+    bool decodeFrame();
+    VideoFrame convertFrame();
+    VideoFrame pooledFrame(const QSize &size);
+
+    QString m_fileName;
+    Pacing m_pacing;
+    bool m_looping;
+
+    AVFormatContext *m_formatContext;
+    AVCodecContext *m_codecContext;
+    AVPacket *m_packet;
+    AVFrame *m_frame;
+    SwsContext *m_scaleContext;
+    int m_streamIndex;
+    QList<VideoFrame> m_framePool;
+    QMutex m_fileMutex;
+
+    //timestamps are milliseconds, shifted by the duration of the previous loops
+    qint64 m_frameTime;
+    qint64 m_loopOffset;
+    qint64 m_lastFrameTime;
+};
+
+#endif // FILEIMAGEGRABBER_H
@@ -0,0 +1,361 @@
+/****************************************************************************
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License as published by the Free Software Foundation; either
+** version 2.1 of the License, or (at your option) any later version.
+**
+** This library is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public
+** License along with this library; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**
+****************************************************************************/
+
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+
+//! The BoundedQueueBase class holds the definitions shared by all BoundedQueue instantiations.
+class BoundedQueueBase
+{
+public:
+    /*! This enum describes what happens when an item is enqueued into a full queue. */
+    enum OverflowPolicy {
+        DropOldest = 0, /*!< The oldest queued item is discarded to make room for the new one. */
+        DropNonReference, /*!< A new non-reference item is discarded, a new reference item discards the oldest queued item. */
+        BlockProducer /*!< The producer waits until the consumer frees a slot or the queue is closed. */
+    };
+};
+
+//! The BoundedQueue class is a fixed-capacity lock-free FIFO queue.
+/*!
+  The queue is safe to use from any number of producer and consumer threads. The fast path (tryEnqueue() and tryDequeue())
+  never takes a lock, a mutex is only touched by producers waiting in BoundedQueueBase::BlockProducer mode.
+
+  The capacity is rounded up to a power of two. Dropped items are counted and can be read with droppedCount().
+
+  Here is an example of the BoundedQueue usage:
+  @code
+  BoundedQueue<QImage> queue(8);
+  queue.setOverflowPolicy(BoundedQueueBase::DropOldest);
+  queue.open();
+
+  //producer thread
+  queue.enqueue(image);
+
+  //consumer thread
+  QImage frame;
+  while (queue.tryDequeue(&frame))
+      process(frame);
+  @endcode
+*/
+template <class T>
+class BoundedQueue : public BoundedQueueBase
+{
+public:
+    /*! Constructs a closed queue that can hold \a capacity items. */
+    explicit BoundedQueue(int capacity = 32);
+    /*! Destroys the queue and all items left in it. */
+    ~BoundedQueue();
+
+    /*!
+      Reallocates the queue storage, all queued items are discarded.
+      Must not be called while producers or consumers use the queue.
+      \sa capacity()
+    */
+    void setCapacity(int capacity);
+    /*!
+      Returns the maximum number of items the queue can hold.
+      \sa setCapacity()
+    */
+    int capacity() const;
+
+    void setOverflowPolicy(BoundedQueueBase::OverflowPolicy policy);
+    BoundedQueueBase::OverflowPolicy overflowPolicy() const;
+
+    /*! Returns an approximate count of queued items. */
+    int size() const;
+    bool isEmpty() const;
+
+    /*! Lets the queue accept items and resets the dropped items counter. */
+    void open();
+    /*! Makes the queue reject new items and wakes up blocked producers. */
+    void close();
+    bool isOpen() const;
+
+    /*!
+      Enqueues \a item according to overflowPolicy(). Returns false if the item was not queued:
+      the queue is closed or the item has been dropped.
+    */
+    bool enqueue(const T &item, bool reference = false);
+
+    /*! Enqueues \a item if there is a free slot. Never blocks and never drops queued items. */
+    bool tryEnqueue(const T &item);
+    /*! Takes the oldest item. Returns false if the queue is empty. */
+    bool tryDequeue(T *item);
+
+    /*! Discards all queued items. */
+    void clear();
+
+    /*! Returns count of items dropped since the last open(). */
+    int droppedCount() const;
+
+private:
+    Q_DISABLE_COPY(BoundedQueue)
+
+    struct Cell {
+        QAtomicInteger<quint32> sequence;
+        T data;
+    };
+
+    void allocate(int capacity);
+    void wakeProducers();
+
+    Cell *m_buffer;
+    quint32 m_mask;
+    QAtomicInteger<quint32> m_enqueuePos;
+    QAtomicInteger<quint32> m_dequeuePos;
+
+    QAtomicInt m_open;
+    QAtomicInt m_droppedCount;
+    QAtomicInt m_waitingProducers;
+    BoundedQueueBase::OverflowPolicy m_policy;
+
+    QMutex m_waitMutex;
+    QWaitCondition m_notFull;
+};
+
+template <class T>
+BoundedQueue<T>::BoundedQueue(int capacity)
+    : m_buffer(0)
+    , m_mask(0)
+    , m_open(0)
+    , m_droppedCount(0)
+    , m_waitingProducers(0)
+    , m_policy(BoundedQueueBase::DropOldest)
+{
+    allocate(capacity);
+}
+
+template <class T>
+BoundedQueue<T>::~BoundedQueue()
+{
+    close();
+    delete[] m_buffer;
+}
+
+template <class T>
+void BoundedQueue<T>::setCapacity(int capacity)
+{
+    if (this->capacity() != capacity)
+        allocate(capacity);
+}
+
+template <class T>
+int BoundedQueue<T>::capacity() const
+{
+    return m_mask + 1;
+}
+
+template <class T>
+void BoundedQueue<T>::setOverflowPolicy(BoundedQueueBase::OverflowPolicy policy)
+{
+    m_policy = policy;
+}
+
+template <class T>
+BoundedQueueBase::OverflowPolicy BoundedQueue<T>::overflowPolicy() const
+{
+    return m_policy;
+}
+
+template <class T>
+int BoundedQueue<T>::size() const
+{
+    qint32 size = static_cast<qint32>(m_enqueuePos.load() - m_dequeuePos.load());
+    return qBound<qint32>(0, size, capacity());
+}
+
+template <class T>
+bool BoundedQueue<T>::isEmpty() const
+{
+    return size() == 0;
+}
+
+template <class T>
+void BoundedQueue<T>::open()
+{
+    m_droppedCount.store(0);
+    m_open.storeRelease(1);
+}
+
+template <class T>
+void BoundedQueue<T>::close()
+{
+    m_open.storeRelease(0);
+
+    QMutexLocker locker(&m_waitMutex);
+    m_notFull.wakeAll();
+}
+
+template <class T>
+bool BoundedQueue<T>::isOpen() const
+{
+    return m_open.loadAcquire() != 0;
+}
+
+template <class T>
+bool BoundedQueue<T>::enqueue(const T &item, bool reference)
+{
+    if (!isOpen())
+        return false;
+
+    if (tryEnqueue(item))
+        return true;
+
+    switch (m_policy) {
+    case BoundedQueueBase::DropNonReference:
+        if (!reference) {
+            m_droppedCount.ref();
+            return false;
+        }
+        //fall through, a reference item replaces the oldest one
+    case BoundedQueueBase::DropOldest: {
+        T oldest;
+        while (!tryEnqueue(item)) {
+            if (!isOpen())
+                return false;
+
+            if (tryDequeue(&oldest))
+                m_droppedCount.ref();
+        }
+        return true;
+    }
+
+    case BoundedQueueBase::BlockProducer:
+        m_waitingProducers.ref();
+        while (!tryEnqueue(item)) {
+            if (!isOpen()) {
+                m_waitingProducers.deref();
+                return false;
+            }
+
+            //the timeout guards against a wake up sent between tryEnqueue() and wait()
+            QMutexLocker locker(&m_waitMutex);
+            m_notFull.wait(&m_waitMutex, 10);
+        }
+        m_waitingProducers.deref();
+        return true;
+    }
+
+    return false;
+}
+
+template <class T>
+bool BoundedQueue<T>::tryEnqueue(const T &item)
+{
+    Cell *cell;
+    quint32 pos = m_enqueuePos.load();
+
+    Q_FOREVER {
+        cell = &m_buffer[pos & m_mask];
+        qint32 diff = static_cast<qint32>(cell->sequence.loadAcquire() - pos);
+
+        if (diff == 0) {
+            if (m_enqueuePos.testAndSetRelaxed(pos, pos + 1))
+                break;
+        } else if (diff < 0) {
+            return false; //full
+        }
+
+        pos = m_enqueuePos.load();
+    }
+
+    cell->data = item;
+    cell->sequence.storeRelease(pos + 1);
+
+    return true;
+}
+
+template <class T>
+bool BoundedQueue<T>::tryDequeue(T *item)
+{
+    Cell *cell;
+    quint32 pos = m_dequeuePos.load();
+
+    Q_FOREVER {
+        cell = &m_buffer[pos & m_mask];
+        qint32 diff = static_cast<qint32>(cell->sequence.loadAcquire() - (pos + 1));
+
+        if (diff == 0) {
+            if (m_dequeuePos.testAndSetRelaxed(pos, pos + 1))
+                break;
+        } else if (diff < 0) {
+            return false; //empty
+        }
+
+        pos = m_dequeuePos.load();
+    }
+
+    *item = cell->data;
+    //release implicitly shared data as soon as possible
+    cell->data = T();
+    cell->sequence.storeRelease(pos + m_mask + 1);
+
+    wakeProducers();
+
+    return true;
+}
+
+template <class T>
+void BoundedQueue<T>::clear()
+{
+    T item;
+    while (tryDequeue(&item)) {
+    }
+}
+
+template <class T>
+int BoundedQueue<T>::droppedCount() const
+{
+    return m_droppedCount.load();
+}
+
+template <class T>
+void BoundedQueue<T>::allocate(int capacity)
+{
+    quint32 size = 2;
+    while (size < static_cast<quint32>(qMax(capacity, 2)))
+        size <<= 1;
+
+    delete[] m_buffer;
+    m_buffer = new Cell[size];
+    m_mask = size - 1;
+
+    for (quint32 i = 0; i < size; ++i)
+        m_buffer[i].sequence.store(i);
+
+    m_enqueuePos.store(0);
+    m_dequeuePos.store(0);
+}
+
+template <class T>
+void BoundedQueue<T>::wakeProducers()
+{
+    if (m_waitingProducers.load() > 0) {
+        QMutexLocker locker(&m_waitMutex);
+        m_notFull.wakeAll();
+    }
+}
+
+#endif // BOUNDEDQUEUE_H
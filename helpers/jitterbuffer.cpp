@@ -0,0 +1,379 @@
+/****************************************************************************
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License as published by the Free Software Foundation; either
+** version 2.1 of the License, or (at your option) any later version.
+**
+** This library is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public
+** License along with this library; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**
+****************************************************************************/
+#include "jitterbuffer.h"
+
+#include <string.h>
+
+#define DEFAULT_TARGET_DELAY 200
+//pts are rounded to milliseconds, smaller deviations from the timeline are ignored
+#define TIMELINE_TOLERANCE 15
+//larger jumps are a restart of the stream rather than lost or late packets
+#define TIMELINE_DISCONTINUITY 1000
+#define CONCEAL_FADE_FRAMES 64
+#define DEFAULT_MAXIMUM_DELAY 1000
+//the playout delay covers this many times the mean deviation of arrival times
+#define JITTER_DELAY_FACTOR 3
+//one frame of this many is removed or repeated at most, 0.5% speed change is not audible
+#define COMPENSATION_RATIO 200
+//the buffered duration may deviate this much from the playout delay before it is corrected
+#define COMPENSATION_TOLERANCE 20
+#define LEVEL_SMOOTHING 0.05
+#define MAX_STRETCH_FRAMES 16384
+
+JitterBuffer::JitterBuffer()
+    : m_frameBytes(0)
+    , m_targetDelay(DEFAULT_TARGET_DELAY)
+    , m_maximumDelay(DEFAULT_MAXIMUM_DELAY)
+    , m_writtenFrames(0)
+    , m_hasTimeline(false)
+    , m_lastArrival(-1)
+    , m_lastPts(0)
+    , m_jitter(0)
+    , m_playing(false)
+    , m_smoothedLevel(0)
+    , m_compensationPhase(0)
+    , m_basePts(-1)
+    , m_readFrames(0)
+    , m_underrunCount(0)
+    , m_droppedFrames(0)
+    , m_jitterMsecs(0)
+    , m_compensatedFrames(0)
+{
+}
+
+JitterBuffer::~JitterBuffer()
+{
+}
+
+void JitterBuffer::setFormat(const AudioFormat &format, int capacityMsecs)
+{
+    m_format = format;
+    m_frameBytes = format.channelCount() * format.bytesPerSample();
+    m_ringBuffer.setCapacity(bytesForMsecs(capacityMsecs));
+    m_lastFrame.fill('\0', m_frameBytes);
+    m_stretchBuffer.fill('\0', MAX_STRETCH_FRAMES * m_frameBytes);
+
+    clear();
+}
+
+AudioFormat JitterBuffer::format() const
+{
+    return m_format;
+}
+
+void JitterBuffer::setTargetDelay(int msecs)
+{
+    m_targetDelay.store(qMax(msecs, 0));
+}
+
+int JitterBuffer::targetDelay() const
+{
+    return m_targetDelay.load();
+}
+
+void JitterBuffer::setMaximumDelay(int msecs)
+{
+    m_maximumDelay.store(qMax(msecs, 0));
+}
+
+int JitterBuffer::maximumDelay() const
+{
+    return m_maximumDelay.load();
+}
+
+int JitterBuffer::playoutDelay() const
+{
+    int delay = qMax(m_targetDelay.load(), JITTER_DELAY_FACTOR * m_jitterMsecs.load());
+    return qMin(delay, qMax(m_maximumDelay.load(), m_targetDelay.load()));
+}
+
+void JitterBuffer::write(const char *data, int size, qint64 pts)
+{
+    if (m_frameBytes == 0)
+        return;
+
+    size -= size % m_frameBytes;
+    if (size <= 0)
+        return;
+
+    //the interarrival jitter estimate of RFC 3550, the deviation of arrival times from the pts spacing
+    qint64 arrival = m_arrivalClock.elapsed();
+    if (m_lastArrival >= 0) {
+        qint64 deviation = (arrival - m_lastArrival) - (pts - m_lastPts);
+        if (qAbs(deviation) < TIMELINE_DISCONTINUITY) {
+            m_jitter += (qAbs(deviation) - m_jitter) / 16.0;
+            m_jitterMsecs.store(qRound(m_jitter));
+        }
+    }
+
+    m_lastArrival = arrival;
+    m_lastPts = pts;
+
+    qint64 expectedPts = m_basePts.load() + m_writtenFrames * 1000 / m_format.sampleRate();
+    qint64 offset = pts - expectedPts;
+
+    if (!m_hasTimeline || qAbs(offset) > TIMELINE_DISCONTINUITY) {
+        //the timeline starts over, buffered samples keep playing in front of the new ones
+        m_basePts.store(pts - m_writtenFrames * 1000 / m_format.sampleRate());
+        m_hasTimeline = true;
+    } else if (offset > TIMELINE_TOLERANCE) {
+        //a lost packet is replaced with silence, so the following samples keep their time
+        writeSilence(bytesForMsecs(offset));
+    } else if (offset < -TIMELINE_TOLERANCE) {
+        //the beginning of the chunk has been buffered already
+        int overlap = bytesForMsecs(-offset);
+        if (overlap >= size) {
+            m_droppedFrames.fetchAndAddRelaxed(size / m_frameBytes);
+            return;
+        }
+
+        m_droppedFrames.fetchAndAddRelaxed(overlap / m_frameBytes);
+        data += overlap;
+        size -= overlap;
+    }
+
+    //the timeline advances even if the buffer is full, the samples are lost like a late packet
+    if (m_ringBuffer.freeSpace() >= size)
+        m_ringBuffer.write(data, size);
+    else
+        m_droppedFrames.fetchAndAddRelaxed(size / m_frameBytes);
+
+    m_writtenFrames += size / m_frameBytes;
+}
+
+void JitterBuffer::restartTimeline()
+{
+    m_hasTimeline = false;
+
+    //the arrival times of another stream say nothing about the jitter of this one
+    m_lastArrival = -1;
+}
+
+void JitterBuffer::read(char *data, int size)
+{
+    if (m_frameBytes == 0) {
+        memset(data, 0, size);
+        return;
+    }
+
+    int available = m_ringBuffer.bytesAvailable();
+
+    if (!m_playing) {
+        if (available < bytesForMsecs(playoutDelay()) || available == 0) {
+            memset(data, 0, size);
+            return;
+        }
+
+        m_playing = true;
+        m_smoothedLevel = available;
+    }
+
+    int frameCount = size / m_frameBytes;
+    int adjustment = compensation(available, frameCount);
+    int sourceFrames = frameCount - adjustment;
+    int count;
+
+    if (adjustment != 0 && sourceFrames > 0 && sourceFrames * m_frameBytes <= m_stretchBuffer.size()
+            && m_ringBuffer.bytesAvailable() >= sourceFrames * m_frameBytes) {
+        count = m_ringBuffer.read(m_stretchBuffer.data(), sourceFrames * m_frameBytes);
+        stretch(m_stretchBuffer.constData(), sourceFrames, data, frameCount);
+
+        m_compensatedFrames.fetchAndAddRelaxed(adjustment);
+        m_readFrames.fetchAndAddRelaxed(sourceFrames);
+        count = size;
+    } else {
+        count = m_ringBuffer.read(data, size);
+        m_readFrames.fetchAndAddRelaxed(count / m_frameBytes);
+    }
+
+    if (count >= m_frameBytes)
+        memcpy(m_lastFrame.data(), data + count - m_frameBytes, m_frameBytes);
+
+    if (count < size) {
+        m_playing = false;
+        m_underrunCount.ref();
+
+        conceal(data + count, size - count);
+    }
+}
+
+int JitterBuffer::bufferedDuration() const
+{
+    if (m_frameBytes == 0)
+        return 0;
+
+    return static_cast<int>(static_cast<qint64>(m_ringBuffer.bytesAvailable() / m_frameBytes) * 1000 / m_format.sampleRate());
+}
+
+qint64 JitterBuffer::playbackPosition() const
+{
+    qint64 basePts = m_basePts.load();
+    if (basePts < 0 || m_frameBytes == 0)
+        return -1;
+
+    return basePts + m_readFrames.load() * 1000 / m_format.sampleRate();
+}
+
+int JitterBuffer::underrunCount() const
+{
+    return m_underrunCount.load();
+}
+
+int JitterBuffer::droppedDuration() const
+{
+    if (m_frameBytes == 0)
+        return 0;
+
+    return static_cast<int>(static_cast<qint64>(m_droppedFrames.load()) * 1000 / m_format.sampleRate());
+}
+
+int JitterBuffer::jitter() const
+{
+    return m_jitterMsecs.load();
+}
+
+int JitterBuffer::compensatedFrames() const
+{
+    return m_compensatedFrames.load();
+}
+
+int JitterBuffer::clockDrift() const
+{
+    qint64 readFrames = m_readFrames.load();
+    if (readFrames == 0)
+        return 0;
+
+    //removed frames mean the sender produces more samples than the sound card plays
+    return static_cast<int>(-static_cast<qint64>(m_compensatedFrames.load()) * 1000000 / readFrames);
+}
+
+void JitterBuffer::clear()
+{
+    m_ringBuffer.clear();
+    m_lastFrame.fill('\0');
+
+    m_writtenFrames = 0;
+    m_hasTimeline = false;
+    m_arrivalClock.start();
+    m_lastArrival = -1;
+    m_lastPts = 0;
+    m_jitter = 0;
+
+    m_playing = false;
+    m_smoothedLevel = 0;
+    m_compensationPhase = 0;
+
+    m_basePts.store(-1);
+    m_readFrames.store(0);
+    m_underrunCount.store(0);
+    m_droppedFrames.store(0);
+    m_jitterMsecs.store(0);
+    m_compensatedFrames.store(0);
+}
+
+int JitterBuffer::bytesForMsecs(qint64 msecs) const
+{
+    return static_cast<int>(msecs * m_format.sampleRate() / 1000) * m_frameBytes;
+}
+
+void JitterBuffer::writeSilence(int size)
+{
+    static const char silence[4096] = { 0 };
+
+    //silence must not push out real samples
+    size = qMin(size, m_ringBuffer.freeSpace() - m_ringBuffer.freeSpace() % m_frameBytes);
+
+    m_writtenFrames += size / m_frameBytes;
+
+    while (size > 0) {
+        int count = qMin(size, static_cast<int>(sizeof(silence)) - static_cast<int>(sizeof(silence)) % m_frameBytes);
+        m_ringBuffer.write(silence, count);
+        size -= count;
+    }
+}
+
+int JitterBuffer::compensation(int available, int frameCount)
+{
+    //the level follows the arrival of packets in steps, only its average is controlled
+    m_smoothedLevel += (available - m_smoothedLevel) * LEVEL_SMOOTHING;
+
+    m_compensationPhase += frameCount;
+    int maximumAdjustment = m_compensationPhase / COMPENSATION_RATIO;
+    m_compensationPhase %= COMPENSATION_RATIO;
+
+    int delay = playoutDelay();
+    int tolerance = bytesForMsecs(qMax(COMPENSATION_TOLERANCE, m_jitterMsecs.load()));
+
+    if (m_smoothedLevel > bytesForMsecs(delay) + tolerance)
+        return -maximumAdjustment;
+
+    if (m_smoothedLevel < bytesForMsecs(delay) - tolerance)
+        return maximumAdjustment;
+
+    return 0;
+}
+
+void JitterBuffer::stretch(const char *source, int sourceFrames, char *data, int frameCount) const
+{
+    //frames are picked at evenly spaced positions, so single frames are repeated or skipped all over the buffer
+    for (int i = 0; i < frameCount; ++i) {
+        int sourceFrame = static_cast<int>(static_cast<qint64>(i) * sourceFrames / frameCount);
+        memcpy(data + i * m_frameBytes, source + sourceFrame * m_frameBytes, m_frameBytes);
+    }
+}
+
+template <typename T>
+static void fadeOut(T *data, const T *lastFrame, int channelCount, int frameCount)
+{
+    for (int i = 0; i < frameCount; ++i) {
+        double gain = i < CONCEAL_FADE_FRAMES ? 1.0 - static_cast<double>(i + 1) / CONCEAL_FADE_FRAMES : 0.0;
+
+        for (int channel = 0; channel < channelCount; ++channel)
+            *data++ = static_cast<T>(lastFrame[channel] * gain);
+    }
+}
+
+void JitterBuffer::conceal(char *data, int size)
+{
+    //a short ramp from the last played samples avoids the click of a hard cut to silence
+    int frameCount = size / m_frameBytes;
+
+    switch (m_format.format()) {
+    case AudioFormat::SignedInt16:
+        fadeOut(reinterpret_cast<qint16 *>(data), reinterpret_cast<const qint16 *>(m_lastFrame.constData()),
+                m_format.channelCount(), frameCount);
+        break;
+
+    case AudioFormat::SignedInt32:
+        fadeOut(reinterpret_cast<qint32 *>(data), reinterpret_cast<const qint32 *>(m_lastFrame.constData()),
+                m_format.channelCount(), frameCount);
+        break;
+
+    case AudioFormat::Float32:
+        fadeOut(reinterpret_cast<float *>(data), reinterpret_cast<const float *>(m_lastFrame.constData()),
+                m_format.channelCount(), frameCount);
+        break;
+
+    default:
+        frameCount = 0;
+        break;
+    }
+
+    memset(data + frameCount * m_frameBytes, 0, size - frameCount * m_frameBytes);
+    m_lastFrame.fill('\0');
+}
@@ -0,0 +1,141 @@
+/****************************************************************************
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License as published by the Free Software Foundation; either
+** version 2.1 of the License, or (at your option) any later version.
+**
+** This library is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public
+** License along with this library; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**
+****************************************************************************/
+#ifndef JITTERBUFFER_H
+#define JITTERBUFFER_H
+
+#include "audioformat.h"
+#include "ringbuffer.h"
+
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include <QByteArray>
+#include <QElapsedTimer>
+
+//! The JitterBuffer class smooths the arrival of timestamped PCM for playback.
+/*!
+  Samples are kept in a preallocated RingBuffer along a continuous timeline: write() fills gaps between the
+  pts of consecutive chunks with silence and trims chunks overlapping already buffered samples, so every read byte
+  has a known pts.
+
+  Playback starts when playoutDelay() milliseconds are buffered. When the buffer runs dry read() conceals the
+  underrun by fading the last played samples out and waits for the playout delay again.
+
+  The playout delay adapts to the network: it is a multiple of the interarrival jitter estimated by write(), at
+  least targetDelay() and at most maximumDelay(). read() holds the buffered duration at the playout delay by removing
+  or repeating single frames, at most one of every 200. This also compensates the drift between the sender clock and
+  the clock of the sound card, which would otherwise slowly drain or overfill the buffer.
+
+  One producer thread and one consumer thread may use the buffer at the same time without locking: write() is the
+  producer side, read() is the consumer side and can be called from a real-time audio callback.
+*/
+class JitterBuffer
+{
+public:
+    JitterBuffer();
+    ~JitterBuffer();
+
+    /*!
+      Allocates the buffer for samples in \a format, holding at most \a capacityMsecs milliseconds.
+      Buffered samples are discarded. Must not be called while the buffer is used by other threads.
+    */
+    void setFormat(const AudioFormat &format, int capacityMsecs);
+    AudioFormat format() const;
+
+    /*! Sets the lowest playout delay in milliseconds. The default value is 200. */
+    void setTargetDelay(int msecs);
+    int targetDelay() const;
+
+    /*! Sets the highest playout delay in milliseconds, however large the jitter is. The default value is 1000. */
+    void setMaximumDelay(int msecs);
+    int maximumDelay() const;
+
+    /*! Returns the current playout delay in milliseconds. */
+    int playoutDelay() const;
+
+    /*! Adds \a size bytes of interleaved samples, \a pts is the time of the first sample in milliseconds. */
+    void write(const char *data, int size, qint64 pts);
+
+    /*!
+      Lets the next write() start a new timeline whatever its pts, e.g. when the samples come from another stream.
+      Buffered samples keep playing in front of the new ones. Belongs to the producer side like write().
+    */
+    void restartTimeline();
+
+    /*! Fills \a data with exactly \a size bytes, with silence or concealment if not enough samples are buffered. */
+    void read(char *data, int size);
+
+    /*! Returns the duration of buffered samples in milliseconds. */
+    int bufferedDuration() const;
+    /*! Returns the pts of the next sample to be played, -1 before the first write(). */
+    qint64 playbackPosition() const;
+    /*! Returns how many times playback ran dry. */
+    int underrunCount() const;
+    /*! Returns the duration of samples dropped because they arrived late or the buffer was full, in milliseconds. */
+    int droppedDuration() const;
+    /*! Returns the estimated interarrival jitter in milliseconds. */
+    int jitter() const;
+    /*! Returns the count of repeated frames minus the count of removed frames. */
+    int compensatedFrames() const;
+    /*!
+      Returns the estimated drift of the sender clock against the playback clock in parts per million,
+      positive if the sender is faster.
+    */
+    int clockDrift() const;
+
+    /*! Discards buffered samples and resets the counters. Must not be called while the buffer is used by other threads. */
+    void clear();
+
+private:
+    Q_DISABLE_COPY(JitterBuffer)
+
+    int bytesForMsecs(qint64 msecs) const;
+    void writeSilence(int size);
+    int compensation(int available, int frameCount);
+    void stretch(const char *source, int sourceFrames, char *data, int frameCount) const;
+    void conceal(char *data, int size);
+
+    AudioFormat m_format;
+    int m_frameBytes;
+    RingBuffer m_ringBuffer;
+    QAtomicInt m_targetDelay;
+    QAtomicInt m_maximumDelay;
+
+    //producer side
+    qint64 m_writtenFrames;
+    bool m_hasTimeline;
+    QElapsedTimer m_arrivalClock;
+    qint64 m_lastArrival;
+    qint64 m_lastPts;
+    double m_jitter;
+
+    //consumer side
+    bool m_playing;
+    QByteArray m_lastFrame;
+    QByteArray m_stretchBuffer;
+    double m_smoothedLevel;
+    int m_compensationPhase;
+
+    QAtomicInteger<qint64> m_basePts;
+    QAtomicInteger<qint64> m_readFrames;
+    QAtomicInt m_underrunCount;
+    QAtomicInt m_droppedFrames;
+    QAtomicInt m_jitterMsecs;
+    QAtomicInt m_compensatedFrames;
+};
+
+#endif // JITTERBUFFER_H
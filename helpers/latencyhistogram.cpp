@@ -0,0 +1,105 @@
+/****************************************************************************
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License as published by the Free Software Foundation; either
+** version 2.1 of the License, or (at your option) any later version.
+**
+** This library is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public
+** License along with this library; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**
+****************************************************************************/
+
+#include "latencyhistogram.h"
+
+LatencyHistogram::LatencyHistogram()
+{
+}
+
+void LatencyHistogram::addSample(qint64 usecs)
+{
+    if (usecs < 0)
+        return;
+
+    int bucket = 0;
+    while (bucket < LATENCY_HISTOGRAM_BUCKETS - 1 && (usecs >> (bucket + 1)) > 0)
+        ++bucket;
+
+    m_buckets[bucket].fetchAndAddRelaxed(1);
+    m_sum.fetchAndAddRelaxed(usecs);
+    m_count.fetchAndAddRelease(1);
+
+    qint64 maximum = m_maximum.loadAcquire();
+    while (usecs > maximum && !m_maximum.testAndSetOrdered(maximum, usecs, maximum)) {
+    }
+}
+
+void LatencyHistogram::reset()
+{
+    for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; ++i)
+        m_buckets[i].store(0);
+
+    m_count.store(0);
+    m_sum.store(0);
+    m_maximum.store(0);
+}
+
+int LatencyHistogram::count() const
+{
+    return m_count.loadAcquire();
+}
+
+qint64 LatencyHistogram::average() const
+{
+    int samples = count();
+    return samples > 0 ? m_sum.loadAcquire() / samples : 0;
+}
+
+qint64 LatencyHistogram::maximum() const
+{
+    return m_maximum.loadAcquire();
+}
+
+qint64 LatencyHistogram::percentile(int percent) const
+{
+    int counts[LATENCY_HISTOGRAM_BUCKETS];
+    qint64 total = 0;
+
+    //take a copy first, the buckets may change while we are counting
+    for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; ++i) {
+        counts[i] = m_buckets[i].loadAcquire();
+        total += counts[i];
+    }
+
+    if (total == 0)
+        return 0;
+
+    qint64 threshold = (total * qBound(0, percent, 100) + 99) / 100;
+    qint64 accumulated = 0;
+    for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; ++i) {
+        accumulated += counts[i];
+        if (accumulated >= threshold && accumulated > 0)
+            return qMin((Q_INT64_C(1) << (i + 1)) - 1, maximum());
+    }
+
+    return maximum();
+}
+
+QVariantMap LatencyHistogram::toVariantMap() const
+{
+    QVariantMap map;
+    map["count"] = count();
+    map["average"] = average();
+    map["p50"] = percentile(50);
+    map["p95"] = percentile(95);
+    map["p99"] = percentile(99);
+    map["max"] = maximum();
+
+    return map;
+}
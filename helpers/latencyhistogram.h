@@ -0,0 +1,65 @@
+/****************************************************************************
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License as published by the Free Software Foundation; either
+** version 2.1 of the License, or (at your option) any later version.
+**
+** This library is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public
+** License along with this library; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**
+****************************************************************************/
+
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <QAtomicInteger>
+#include <QVariantMap>
+
+#define LATENCY_HISTOGRAM_BUCKETS 32
+
+//! The LatencyHistogram class collects durations into power of two microsecond buckets.
+/*!
+  Bucket \c i counts samples in the range [2^i, 2^(i+1)) microseconds, so percentiles are exact up to a factor of two.
+  addSample() never locks or allocates and may be called from any thread while another thread reads the histogram.
+*/
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    /*! Adds a sample of \a usecs microseconds, negative samples are ignored. */
+    void addSample(qint64 usecs);
+    /*! Discards all samples. */
+    void reset();
+
+    int count() const;
+    /*! Returns the average sample in microseconds, or 0 if the histogram is empty. */
+    qint64 average() const;
+    /*! Returns the largest sample in microseconds. */
+    qint64 maximum() const;
+    /*!
+      Returns the upper bound in microseconds of the bucket containing the \a percent percentile,
+      or 0 if the histogram is empty.
+    */
+    qint64 percentile(int percent) const;
+
+    /*! Returns count, average, p50, p95, p99 and max (in microseconds) as a map suitable for QML. */
+    QVariantMap toVariantMap() const;
+
+private:
+    Q_DISABLE_COPY(LatencyHistogram)
+
+    QAtomicInt m_buckets[LATENCY_HISTOGRAM_BUCKETS];
+    QAtomicInt m_count;
+    QAtomicInteger<qint64> m_sum;
+    QAtomicInteger<qint64> m_maximum;
+};
+
+#endif // LATENCYHISTOGRAM_H
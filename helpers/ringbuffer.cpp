@@ -0,0 +1,126 @@
+/****************************************************************************
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License as published by the Free Software Foundation; either
+** version 2.1 of the License, or (at your option) any later version.
+**
+** This library is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public
+** License along with this library; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**
+****************************************************************************/
+
+#include "ringbuffer.h"
+
+#include <string.h>
+
+RingBuffer::RingBuffer(int capacity)
+    : m_buffer(0)
+    , m_mask(0)
+{
+    setCapacity(capacity);
+}
+
+RingBuffer::~RingBuffer()
+{
+    delete[] m_buffer;
+}
+
+void RingBuffer::setCapacity(int capacity)
+{
+    delete[] m_buffer;
+    m_buffer = 0;
+    m_mask = 0;
+
+    if (capacity > 0) {
+        quint32 size = 1;
+        while (size < static_cast<quint32>(capacity))
+            size <<= 1;
+
+        m_buffer = new char[size];
+        m_mask = size - 1;
+    }
+
+    m_readPos.store(0);
+    m_writePos.store(0);
+}
+
+int RingBuffer::capacity() const
+{
+    return m_buffer ? m_mask + 1 : 0;
+}
+
+int RingBuffer::bytesAvailable() const
+{
+    return m_writePos.loadAcquire() - m_readPos.loadAcquire();
+}
+
+int RingBuffer::freeSpace() const
+{
+    return capacity() - bytesAvailable();
+}
+
+int RingBuffer::write(const char *data, int size)
+{
+    quint32 writePos = m_writePos.load();
+    int count = qMin(size, capacity() - static_cast<int>(writePos - m_readPos.loadAcquire()));
+    if (count <= 0)
+        return 0;
+
+    quint32 offset = writePos & m_mask;
+    int firstPart = qMin<int>(count, m_mask + 1 - offset);
+
+    memcpy(m_buffer + offset, data, firstPart);
+    memcpy(m_buffer, data + firstPart, count - firstPart);
+
+    m_writePos.storeRelease(writePos + count);
+
+    return count;
+}
+
+int RingBuffer::read(char *data, int size)
+{
+    int count = peek(data, size);
+    m_readPos.storeRelease(m_readPos.load() + count);
+
+    return count;
+}
+
+int RingBuffer::peek(char *data, int size) const
+{
+    quint32 readPos = m_readPos.load();
+    int count = qMin(size, static_cast<int>(m_writePos.loadAcquire() - readPos));
+    if (count <= 0)
+        return 0;
+
+    quint32 offset = readPos & m_mask;
+    int firstPart = qMin<int>(count, m_mask + 1 - offset);
+
+    memcpy(data, m_buffer + offset, firstPart);
+    memcpy(data + firstPart, m_buffer, count - firstPart);
+
+    return count;
+}
+
+int RingBuffer::skip(int size)
+{
+    quint32 readPos = m_readPos.load();
+    int count = qMin(size, static_cast<int>(m_writePos.loadAcquire() - readPos));
+    if (count <= 0)
+        return 0;
+
+    m_readPos.storeRelease(readPos + count);
+
+    return count;
+}
+
+void RingBuffer::clear()
+{
+    m_readPos.storeRelease(m_writePos.loadAcquire());
+}
@@ -0,0 +1,71 @@
+/****************************************************************************
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License as published by the Free Software Foundation; either
+** version 2.1 of the License, or (at your option) any later version.
+**
+** This library is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public
+** License along with this library; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**
+****************************************************************************/
+
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <QAtomicInteger>
+
+//! The RingBuffer class is a preallocated byte FIFO.
+/*!
+  The buffer never allocates memory after setCapacity(), so it can be used from real-time threads.
+  One producer thread and one consumer thread may use it at the same time without locking: write() is the producer side,
+  read(), peek(), skip() and clear() are the consumer side.
+
+  The capacity is rounded up to a power of two.
+*/
+class RingBuffer
+{
+public:
+    /*! Constructs a buffer that can hold \a capacity bytes. */
+    explicit RingBuffer(int capacity = 0);
+    ~RingBuffer();
+
+    /*!
+      Reallocates the buffer, buffered data is discarded.
+      Must not be called while the buffer is used by other threads.
+    */
+    void setCapacity(int capacity);
+    int capacity() const;
+
+    /*! Returns count of bytes that can be read. */
+    int bytesAvailable() const;
+    /*! Returns count of bytes that can be written. */
+    int freeSpace() const;
+
+    /*! Writes at most \a size bytes and returns count of written bytes. */
+    int write(const char *data, int size);
+    /*! Reads at most \a size bytes and returns count of read bytes. */
+    int read(char *data, int size);
+    /*! Copies at most \a size bytes without consuming them and returns count of copied bytes. */
+    int peek(char *data, int size) const;
+    /*! Discards at most \a size bytes and returns count of discarded bytes. */
+    int skip(int size);
+    /*! Discards all buffered bytes. */
+    void clear();
+
+private:
+    Q_DISABLE_COPY(RingBuffer)
+
+    char *m_buffer;
+    quint32 m_mask;
+    QAtomicInteger<quint32> m_readPos;
+    QAtomicInteger<quint32> m_writePos;
+};
+
+#endif // RINGBUFFER_H
@@ -0,0 +1,385 @@
+/****************************************************************************
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License as published by the Free Software Foundation; either
+** version 2.1 of the License, or (at your option) any later version.
+**
+** This library is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public
+** License along with this library; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**
+****************************************************************************/
+#include "loopbackaudiobackend.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QThread>
+#include <qmath.h>
+
+#include <string.h>
+
+#define LOOPBACK_DEVICE_INDEX 0
+#define LOOPBACK_DEVICE_NAME "Loopback"
+#define DEFAULT_SINE_FREQUENCY 440.0
+#define SINE_AMPLITUDE 0.25
+#define DEFAULT_PLAYBACK_BUFFER_DURATION 10000
+
+class LoopbackThread : public QThread
+{
+public:
+    explicit LoopbackThread(LoopbackAudioBackend *backend)
+        : m_backend(backend)
+    {
+    }
+
+protected:
+    void run()
+    {
+        m_backend->run();
+    }
+
+private:
+    LoopbackAudioBackend *m_backend;
+};
+
+//writes one little endian sample, value is in the range [-1, 1]
+static void writeSample(char *data, double value, AudioFormat::Format format)
+{
+    switch (format) {
+    case AudioFormat::SignedInt8: {
+        qint8 sample = static_cast<qint8>(value * 127);
+        memcpy(data, &sample, sizeof(sample));
+        break;
+    }
+
+    case AudioFormat::SignedInt16: {
+        qint16 sample = static_cast<qint16>(value * 32767);
+        memcpy(data, &sample, sizeof(sample));
+        break;
+    }
+
+    case AudioFormat::SignedInt24: {
+        qint32 sample = static_cast<qint32>(value * 8388607);
+        data[0] = static_cast<char>(sample & 0xff);
+        data[1] = static_cast<char>((sample >> 8) & 0xff);
+        data[2] = static_cast<char>((sample >> 16) & 0xff);
+        break;
+    }
+
+    case AudioFormat::SignedInt32: {
+        qint32 sample = static_cast<qint32>(value * 2147483647.0);
+        memcpy(data, &sample, sizeof(sample));
+        break;
+    }
+
+    case AudioFormat::Float32: {
+        float sample = static_cast<float>(value);
+        memcpy(data, &sample, sizeof(sample));
+        break;
+    }
+
+    case AudioFormat::Float64:
+        memcpy(data, &value, sizeof(value));
+        break;
+    }
+}
+
+//returns the payload of the data chunk of a WAV file, or the whole file if it is not one
+static QByteArray samplesOf(const QByteArray &file)
+{
+    if (file.size() < 12 || !file.startsWith("RIFF") || file.mid(8, 4) != "WAVE")
+        return file;
+
+    int position = 12;
+    while (position + 8 <= file.size()) {
+        const uchar *header = reinterpret_cast<const uchar *>(file.constData() + position);
+        int chunkSize = header[4] | (header[5] << 8) | (header[6] << 16) | (header[7] << 24);
+
+        if (file.mid(position, 4) == "data")
+            return file.mid(position + 8, chunkSize);
+
+        //chunks are padded to an even size
+        position += 8 + chunkSize + (chunkSize & 1);
+    }
+
+    return QByteArray();
+}
+
+LoopbackAudioBackend::LoopbackAudioBackend()
+    : m_source(LoopbackAudioBackend::SineSource)
+    , m_sineFrequency(DEFAULT_SINE_FREQUENCY)
+    , m_filePosition(0)
+    , m_sampleNumber(0)
+    , m_open(false)
+    , m_direction(AudioBackend::CaptureStream)
+    , m_bufferFrames(0)
+    , m_callback(NULL)
+    , m_userData(NULL)
+    , m_playbackBufferDuration(DEFAULT_PLAYBACK_BUFFER_DURATION)
+    , m_processedFrames(0)
+    , m_thread(new LoopbackThread(this))
+{
+}
+
+LoopbackAudioBackend::~LoopbackAudioBackend()
+{
+    closeStream();
+    delete m_thread;
+}
+
+void LoopbackAudioBackend::setSource(LoopbackAudioBackend::Source source)
+{
+    if (!isStreamRunning())
+        m_source = source;
+}
+
+LoopbackAudioBackend::Source LoopbackAudioBackend::source() const
+{
+    return m_source;
+}
+
+void LoopbackAudioBackend::setSineFrequency(double frequency)
+{
+    if (!isStreamRunning())
+        m_sineFrequency = frequency;
+}
+
+double LoopbackAudioBackend::sineFrequency() const
+{
+    return m_sineFrequency;
+}
+
+bool LoopbackAudioBackend::setSourceFile(const QString &fileName)
+{
+    if (isStreamRunning())
+        return false;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        setErrorString(file.errorString());
+        return false;
+    }
+
+    m_fileData = samplesOf(file.readAll());
+    m_filePosition = 0;
+    m_source = LoopbackAudioBackend::FileSource;
+
+    return true;
+}
+
+void LoopbackAudioBackend::setPlaybackBufferDuration(int msecs)
+{
+    if (!m_open)
+        m_playbackBufferDuration = msecs;
+}
+
+int LoopbackAudioBackend::playbackBufferDuration() const
+{
+    return m_playbackBufferDuration;
+}
+
+int LoopbackAudioBackend::readPlayback(char *data, int size)
+{
+    return m_playback.read(data, size);
+}
+
+int LoopbackAudioBackend::playbackBytesAvailable() const
+{
+    return m_playback.bytesAvailable();
+}
+
+AudioBackend::Api LoopbackAudioBackend::api() const
+{
+    return AudioBackend::LoopbackApi;
+}
+
+QHash<int, QString> LoopbackAudioBackend::inputDevices()
+{
+    QHash<int, QString> devices;
+    devices.insert(LOOPBACK_DEVICE_INDEX, LOOPBACK_DEVICE_NAME);
+
+    return devices;
+}
+
+QHash<int, QString> LoopbackAudioBackend::outputDevices()
+{
+    return inputDevices();
+}
+
+int LoopbackAudioBackend::defaultInputDevice()
+{
+    return LOOPBACK_DEVICE_INDEX;
+}
+
+int LoopbackAudioBackend::defaultOutputDevice()
+{
+    return LOOPBACK_DEVICE_INDEX;
+}
+
+bool LoopbackAudioBackend::openStream(int deviceIndex, AudioBackend::StreamDirection direction, const AudioFormat &format,
+                                      unsigned int *bufferFrames, AudioBackendCallback callback, void *userData)
+{
+    if (m_open) {
+        setErrorString(QString("A stream is already open."));
+        return false;
+    }
+
+    if (deviceIndex != LOOPBACK_DEVICE_INDEX || format.sampleRate() <= 0 || format.channelCount() <= 0
+            || format.bytesPerSample() == 0 || !bufferFrames || *bufferFrames == 0 || !callback) {
+        setErrorString(QString("Invalid stream parameters."));
+        return false;
+    }
+
+    m_direction = direction;
+    m_format = format;
+    m_bufferFrames = *bufferFrames;
+    m_callback = callback;
+    m_userData = userData;
+
+    //everything the stream thread needs is allocated here
+    int frameBytes = format.channelCount() * format.bytesPerSample();
+    m_buffer.fill('\0', m_bufferFrames * frameBytes);
+
+    if (direction == AudioBackend::PlaybackStream)
+        m_playback.setCapacity(static_cast<int>(static_cast<qint64>(format.sampleRate()) * m_playbackBufferDuration / 1000 * frameBytes));
+
+    //a source file is played in whole frames only
+    m_fileData.truncate(m_fileData.size() - m_fileData.size() % frameBytes);
+    m_filePosition = 0;
+
+    m_sampleNumber = 0;
+    m_processedFrames.store(0);
+    m_open = true;
+
+    return true;
+}
+
+void LoopbackAudioBackend::closeStream()
+{
+    stopStream();
+
+    m_open = false;
+    m_callback = NULL;
+}
+
+bool LoopbackAudioBackend::isStreamOpen() const
+{
+    return m_open;
+}
+
+bool LoopbackAudioBackend::startStream()
+{
+    if (!m_open) {
+        setErrorString(QString("No stream is open."));
+        return false;
+    }
+
+    if (!m_thread->isRunning())
+        m_thread->start(QThread::TimeCriticalPriority);
+
+    return true;
+}
+
+void LoopbackAudioBackend::stopStream()
+{
+    m_thread->requestInterruption();
+    m_thread->wait();
+}
+
+bool LoopbackAudioBackend::isStreamRunning() const
+{
+    return m_thread->isRunning();
+}
+
+double LoopbackAudioBackend::streamTime()
+{
+    return m_open ? static_cast<double>(m_processedFrames.load()) / m_format.sampleRate() : 0.0;
+}
+
+void LoopbackAudioBackend::setStreamTime(double time)
+{
+    if (m_open)
+        m_processedFrames.store(static_cast<qint64>(time * m_format.sampleRate()));
+}
+
+void LoopbackAudioBackend::run()
+{
+    QElapsedTimer clock;
+    clock.start();
+
+    double periodUsecs = m_bufferFrames * 1000000.0 / m_format.sampleRate();
+    qint64 period = 0;
+
+    while (!m_thread->isInterruptionRequested()) {
+        //periods are scheduled on the clock, so a late wakeup does not shift the following ones
+        qint64 due = static_cast<qint64>(period * periodUsecs);
+        qint64 now = clock.nsecsElapsed() / 1000;
+        if (due > now)
+            QThread::usleep(due - now);
+
+        int result;
+        if (m_direction == AudioBackend::CaptureStream) {
+            generate(m_buffer.data(), m_bufferFrames);
+            result = m_callback(NULL, m_buffer.data(), m_bufferFrames, streamTime(), 0, m_userData);
+        } else {
+            memset(m_buffer.data(), 0, m_buffer.size());
+            result = m_callback(m_buffer.data(), NULL, m_bufferFrames, streamTime(), 0, m_userData);
+            m_playback.write(m_buffer.constData(), m_buffer.size());
+        }
+
+        m_processedFrames.fetchAndAddOrdered(m_bufferFrames);
+        ++period;
+
+        //like RtAudio, 1 drains and 2 aborts the stream
+        if (result == 1 || result == 2)
+            break;
+    }
+}
+
+void LoopbackAudioBackend::generate(char *data, unsigned int frameCount)
+{
+    int sampleBytes = m_format.bytesPerSample();
+    int channelCount = m_format.channelCount();
+
+    switch (m_source) {
+    case LoopbackAudioBackend::SineSource:
+        for (unsigned int i = 0; i < frameCount; ++i, ++m_sampleNumber) {
+            double value = SINE_AMPLITUDE * qSin(2.0 * M_PI * m_sineFrequency * m_sampleNumber / m_format.sampleRate());
+
+            for (int channel = 0; channel < channelCount; ++channel) {
+                writeSample(data, value, m_format.format());
+                data += sampleBytes;
+            }
+        }
+        break;
+
+    case LoopbackAudioBackend::FileSource:
+        if (!m_fileData.isEmpty()) {
+            int bytesLeft = frameCount * channelCount * sampleBytes;
+
+            while (bytesLeft > 0) {
+                int count = qMin(bytesLeft, m_fileData.size() - m_filePosition);
+                memcpy(data, m_fileData.constData() + m_filePosition, count);
+
+                data += count;
+                bytesLeft -= count;
+                m_filePosition = (m_filePosition + count) % m_fileData.size();
+            }
+            break;
+        }
+
+        //an empty file sounds like silence
+        memset(data, 0, frameCount * channelCount * sampleBytes);
+        break;
+
+    default:
+        memset(data, 0, frameCount * channelCount * sampleBytes);
+        break;
+    }
+}
@@ -0,0 +1,122 @@
+/****************************************************************************
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License as published by the Free Software Foundation; either
+** version 2.1 of the License, or (at your option) any later version.
+**
+** This library is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public
+** License along with this library; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**
+****************************************************************************/
+#ifndef LOOPBACKAUDIOBACKEND_H
+#define LOOPBACKAUDIOBACKEND_H
+
+#include "audiobackend.h"
+#include "helpers/ringbuffer.h"
+
+#include <QAtomicInteger>
+#include <QByteArray>
+
+class QThread;
+
+//! The LoopbackAudioBackend class is an in-process virtual sound device.
+/*!
+  The backend has one device, which has both input and output channels. An own thread calls the stream callback
+  every buffer period, paced by the clock like a sound card would.
+
+  A capture stream is fed with a sine tone, silence or the content of a file, see setSource(). A playback stream
+  is rendered into a ring buffer, which can be inspected with readPlayback(). So the audio path can be exercised and
+  measured without sound hardware.
+*/
+class LoopbackAudioBackend : public AudioBackend
+{
+public:
+    /*! This enum describes what a capture stream receives. */
+    enum Source {
+        SineSource = 0, /*!< A sine tone, see setSineFrequency(). */
+        SilenceSource, /*!< Zero samples. */
+        FileSource /*!< Samples of the file set by setSourceFile(), played in a loop. */
+    };
+
+    LoopbackAudioBackend();
+    virtual ~LoopbackAudioBackend();
+
+    /*! Sets the capture source. The default value is LoopbackAudioBackend::SineSource. */
+    void setSource(LoopbackAudioBackend::Source source);
+    LoopbackAudioBackend::Source source() const;
+
+    /*! Sets the frequency of the sine tone in Hz. The default value is 440. */
+    void setSineFrequency(double frequency);
+    double sineFrequency() const;
+
+    /*!
+      Loads the samples of a capture source file and selects LoopbackAudioBackend::FileSource. The file holds raw samples
+      or a WAV file, in both cases in the format of the stream. Returns false if the file can not be read.
+    */
+    bool setSourceFile(const QString &fileName);
+
+    /*! Sets how many milliseconds of playback are kept for readPlayback(). The default value is 10000. */
+    void setPlaybackBufferDuration(int msecs);
+    int playbackBufferDuration() const;
+
+    /*!
+      Reads at most \a size bytes of rendered playback and returns the count of read bytes.
+      Playback is dropped while the buffer is full.
+    */
+    int readPlayback(char *data, int size);
+    int playbackBytesAvailable() const;
+
+    AudioBackend::Api api() const;
+
+    QHash<int, QString> inputDevices();
+    QHash<int, QString> outputDevices();
+    int defaultInputDevice();
+    int defaultOutputDevice();
+
+    bool openStream(int deviceIndex, AudioBackend::StreamDirection direction, const AudioFormat &format,
+                    unsigned int *bufferFrames, AudioBackendCallback callback, void *userData);
+    void closeStream();
+    bool isStreamOpen() const;
+
+    bool startStream();
+    void stopStream();
+    bool isStreamRunning() const;
+
+    double streamTime();
+    void setStreamTime(double time);
+
+private:
+    friend class LoopbackThread;
+
+    void run();
+    void generate(char *data, unsigned int frameCount);
+
+    Source m_source;
+    double m_sineFrequency;
+    QByteArray m_fileData;
+    int m_filePosition;
+    qint64 m_sampleNumber;
+
+    bool m_open;
+    AudioBackend::StreamDirection m_direction;
+    AudioFormat m_format;
+    unsigned int m_bufferFrames;
+    AudioBackendCallback m_callback;
+    void *m_userData;
+
+    QByteArray m_buffer;
+    RingBuffer m_playback;
+    int m_playbackBufferDuration;
+
+    QAtomicInteger<qint64> m_processedFrames;
+    QThread *m_thread;
+};
+
+#endif // LOOPBACKAUDIOBACKEND_H
@@ -0,0 +1,124 @@
+/****************************************************************************
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License as published by the Free Software Foundation; either
+** version 2.1 of the License, or (at your option) any later version.
+**
+** This library is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public
+** License along with this library; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**
+****************************************************************************/
+#include "patternimagegrabber.h"
+
+#include <string.h>
+
+#define FRAME_POOL_SIZE 4
+#define BAR_COUNT 8
+#define BAR_SPEED 4
+
+//75% color bars in BT.601 YUV: white, yellow, cyan, green, magenta, red, blue, black
+static const uchar barColors[BAR_COUNT][3] = {
+    { 180, 128, 128 }, { 162, 44, 142 }, { 131, 156, 44 }, { 112, 72, 58 },
+    { 84, 184, 198 }, { 65, 100, 212 }, { 35, 212, 114 }, { 16, 128, 128 }
+};
+
+PatternImageGrabber::PatternImageGrabber(QObject *parent)
+    : AbstractImageGrabber(parent)
+    , m_size(1280, 720)
+    , m_frameNumber(0)
+{
+    //there is no device to wait for
+    setInitializationTime(0);
+}
+
+PatternImageGrabber::~PatternImageGrabber()
+{
+}
+
+void PatternImageGrabber::setSize(const QSize &size)
+{
+    if (state() == AbstractGrabber::StoppedState) {
+        m_size = QSize(size.width() & ~1, size.height() & ~1);
+
+        //bars and pooled frames are recreated for the new size
+        for (int plane = 0; plane < 3; ++plane)
+            m_bars[plane].clear();
+
+        m_framePool.clear();
+    }
+}
+
+QSize PatternImageGrabber::size() const
+{
+    return m_size;
+}
+
+QImage PatternImageGrabber::captureFrame()
+{
+    return captureVideoFrame().toImage();
+}
+
+VideoFrame PatternImageGrabber::captureVideoFrame()
+{
+    if (m_size.isEmpty())
+        return VideoFrame();
+
+    createBars();
+
+    VideoFrame frame = pooledFrame();
+    int width = m_size.width();
+    int height = m_size.height();
+    int shift = m_frameNumber * BAR_SPEED;
+
+    //every row is a window into two periods of bars, shifted by one pixel per row so the bars slide diagonally
+    uchar *luma = frame.bits(0);
+    for (int y = 0; y < height; ++y)
+        memcpy(luma + y * frame.bytesPerLine(0), m_bars[0].constData() + (shift + y) % width, width);
+
+    for (int plane = 1; plane < 3; ++plane) {
+        uchar *chroma = frame.bits(plane);
+        for (int y = 0; y < height / 2; ++y)
+            memcpy(chroma + y * frame.bytesPerLine(plane), m_bars[plane].constData() + ((shift + y * 2) % width) / 2, width / 2);
+    }
+
+    ++m_frameNumber;
+
+    return frame;
+}
+
+void PatternImageGrabber::createBars()
+{
+    int width = m_size.width();
+    if (m_bars[0].size() == width * 2)
+        return;
+
+    for (int plane = 0; plane < 3; ++plane) {
+        int planeWidth = plane == 0 ? width : width / 2;
+        m_bars[plane].resize(planeWidth * 2);
+
+        for (int x = 0; x < planeWidth * 2; ++x)
+            m_bars[plane][x] = barColors[(x % planeWidth) * BAR_COUNT / planeWidth][plane];
+    }
+}
+
+VideoFrame PatternImageGrabber::pooledFrame()
+{
+    //a frame is free again as soon as the encoder has released its copy
+    for (int i = 0; i < m_framePool.count(); ++i) {
+        if (!m_framePool.at(i).isShared())
+            return m_framePool.at(i);
+    }
+
+    VideoFrame frame(m_size, EncoderGlobal::YUV420P);
+    if (m_framePool.count() < FRAME_POOL_SIZE)
+        m_framePool.append(frame);
+
+    return frame;
+}
@@ -0,0 +1,65 @@
+/****************************************************************************
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License as published by the Free Software Foundation; either
+** version 2.1 of the License, or (at your option) any later version.
+**
+** This library is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public
+** License along with this library; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**
+****************************************************************************/
+#ifndef PATTERNIMAGEGRABBER_H
+#define PATTERNIMAGEGRABBER_H
+
+#include "abstractimagegrabber.h"
+
+#include <QByteArray>
+#include <QList>
+#include <QSize>
+
+//! The PatternImageGrabber class generates moving color bars instead of capturing a device.
+/*!
+  The grabber needs no hardware, so it can be used to load test the streaming pipeline. Frames are generated in YUV420P
+  straight into a small pool of reused frames, which the Encoder takes without any conversion when the output pixel format
+  is YUV420P and the sizes match. The bars move with every frame, so the encoder can not take shortcuts on static content.
+
+  The frame rate is set through AbstractImageGrabber::setLatency(). frameAvailable() carries null images, as frames are not RGB.
+*/
+class PatternImageGrabber : public AbstractImageGrabber
+{
+    Q_OBJECT
+
+public:
+    PatternImageGrabber(QObject *parent = 0);
+    virtual ~PatternImageGrabber();
+
+    /*!
+      Sets the frame size, both dimensions are rounded down to even numbers. It can only be changed while the grabber is stopped.
+      The default value is 1280x720.
+      \sa size()
+    */
+    void setSize(const QSize &size);
+    QSize size() const;
+
+protected:
+    QImage captureFrame();
+    VideoFrame captureVideoFrame();
+
+private:
+    void createBars();
+    VideoFrame pooledFrame();
+
+    QSize m_size;
+    QByteArray m_bars[3];
+    QList<VideoFrame> m_framePool;
+    int m_frameNumber;
+};
+
+#endif // PATTERNIMAGEGRABBER_H
@@ -0,0 +1,191 @@
+/****************************************************************************
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License as published by the Free Software Foundation; either
+** version 2.1 of the License, or (at your option) any later version.
+**
+** This library is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public
+** License along with this library; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**
+****************************************************************************/
+#include "rtaudiobackend.h"
+#include "3rdparty/RtAudio/RtAudio.h"
+
+#include <vector>
+
+static RtAudio::Api toRtAudioApi(AudioBackend::Api api)
+{
+    switch (api) {
+    case AudioBackend::AlsaApi:
+        return RtAudio::LINUX_ALSA;
+
+    case AudioBackend::PulseAudioApi:
+        return RtAudio::LINUX_PULSE;
+
+    case AudioBackend::DirectSoundApi:
+        return RtAudio::WINDOWS_DS;
+
+    default:
+        return RtAudio::UNSPECIFIED;
+    }
+}
+
+RtAudioBackend::RtAudioBackend(AudioBackend::Api api)
+    : m_api(api)
+    , m_rtAudio(new RtAudio(toRtAudioApi(api)))
+{
+}
+
+RtAudioBackend::~RtAudioBackend()
+{
+    closeStream();
+    delete m_rtAudio;
+}
+
+QList<AudioBackend::Api> RtAudioBackend::compiledApis()
+{
+    std::vector<RtAudio::Api> rtApis;
+    RtAudio::getCompiledApi(rtApis);
+
+    QList<AudioBackend::Api> apis;
+    for (size_t i = 0; i < rtApis.size(); ++i) {
+        switch (rtApis[i]) {
+        case RtAudio::LINUX_ALSA:
+            apis.append(AudioBackend::AlsaApi);
+            break;
+
+        case RtAudio::LINUX_PULSE:
+            apis.append(AudioBackend::PulseAudioApi);
+            break;
+
+        case RtAudio::WINDOWS_DS:
+            apis.append(AudioBackend::DirectSoundApi);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    return apis;
+}
+
+AudioBackend::Api RtAudioBackend::api() const
+{
+    return m_api;
+}
+
+QHash<int, QString> RtAudioBackend::inputDevices()
+{
+    return devices(AudioBackend::CaptureStream);
+}
+
+QHash<int, QString> RtAudioBackend::outputDevices()
+{
+    return devices(AudioBackend::PlaybackStream);
+}
+
+int RtAudioBackend::defaultInputDevice()
+{
+    return m_rtAudio->getDefaultInputDevice();
+}
+
+int RtAudioBackend::defaultOutputDevice()
+{
+    return m_rtAudio->getDefaultOutputDevice();
+}
+
+bool RtAudioBackend::openStream(int deviceIndex, AudioBackend::StreamDirection direction, const AudioFormat &format,
+                                unsigned int *bufferFrames, AudioBackendCallback callback, void *userData)
+{
+    RtAudio::StreamParameters params;
+    params.deviceId = deviceIndex;
+    params.nChannels = format.channelCount();
+    params.firstChannel = 0;
+
+    //AudioFormat::Format values are the RtAudio sample formats
+    try {
+        m_rtAudio->openStream(direction == AudioBackend::PlaybackStream ? &params : NULL,
+                              direction == AudioBackend::CaptureStream ? &params : NULL,
+                              format.format(), format.sampleRate(), bufferFrames, callback, userData);
+    } catch (RtAudioError &e) {
+        setErrorString(QString::fromStdString(e.getMessage()));
+        return false;
+    }
+
+    return true;
+}
+
+void RtAudioBackend::closeStream()
+{
+    if (m_rtAudio->isStreamOpen())
+        m_rtAudio->closeStream();
+}
+
+bool RtAudioBackend::isStreamOpen() const
+{
+    return m_rtAudio->isStreamOpen();
+}
+
+bool RtAudioBackend::startStream()
+{
+    try {
+        m_rtAudio->startStream();
+    } catch (RtAudioError &e) {
+        setErrorString(QString::fromStdString(e.getMessage()));
+        return false;
+    }
+
+    return true;
+}
+
+void RtAudioBackend::stopStream()
+{
+    if (m_rtAudio->isStreamRunning())
+        m_rtAudio->stopStream();
+}
+
+bool RtAudioBackend::isStreamRunning() const
+{
+    return m_rtAudio->isStreamRunning();
+}
+
+double RtAudioBackend::streamTime()
+{
+    return m_rtAudio->isStreamOpen() ? m_rtAudio->getStreamTime() : 0.0;
+}
+
+void RtAudioBackend::setStreamTime(double time)
+{
+    if (m_rtAudio->isStreamOpen())
+        m_rtAudio->setStreamTime(time);
+}
+
+QHash<int, QString> RtAudioBackend::devices(AudioBackend::StreamDirection direction)
+{
+    QHash<int, QString> devices;
+    unsigned int deviceCount = m_rtAudio->getDeviceCount();
+
+    for (unsigned int i = 0; i < deviceCount; ++i) {
+        RtAudio::DeviceInfo info;
+
+        //a device which disappeared meanwhile is skipped
+        try {
+            info = m_rtAudio->getDeviceInfo(i);
+        } catch (RtAudioError &) {
+            continue;
+        }
+
+        if ((direction == AudioBackend::CaptureStream ? info.inputChannels : info.outputChannels) > 0)
+            devices.insert(i, QString::fromStdString(info.name));
+    }
+
+    return devices;
+}
@@ -0,0 +1,64 @@
+/****************************************************************************
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License as published by the Free Software Foundation; either
+** version 2.1 of the License, or (at your option) any later version.
+**
+** This library is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public
+** License along with this library; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**
+****************************************************************************/
+#ifndef RTAUDIOBACKEND_H
+#define RTAUDIOBACKEND_H
+
+#include "audiobackend.h"
+
+class RtAudio;
+
+//! The RtAudioBackend class opens streams on the sound systems supported by RtAudio.
+/*!
+  Which sound systems are available depends on the RtAudio build flags: __LINUX_ALSA__, __LINUX_PULSE__ and __WINDOWS_DS__.
+*/
+class RtAudioBackend : public AudioBackend
+{
+public:
+    explicit RtAudioBackend(AudioBackend::Api api = AudioBackend::DefaultApi);
+    virtual ~RtAudioBackend();
+
+    /*! Returns the sound systems RtAudio has been compiled with. */
+    static QList<AudioBackend::Api> compiledApis();
+
+    AudioBackend::Api api() const;
+
+    QHash<int, QString> inputDevices();
+    QHash<int, QString> outputDevices();
+    int defaultInputDevice();
+    int defaultOutputDevice();
+
+    bool openStream(int deviceIndex, AudioBackend::StreamDirection direction, const AudioFormat &format,
+                    unsigned int *bufferFrames, AudioBackendCallback callback, void *userData);
+    void closeStream();
+    bool isStreamOpen() const;
+
+    bool startStream();
+    void stopStream();
+    bool isStreamRunning() const;
+
+    double streamTime();
+    void setStreamTime(double time);
+
+private:
+    QHash<int, QString> devices(AudioBackend::StreamDirection direction);
+
+    AudioBackend::Api m_api;
+    RtAudio *m_rtAudio;
+};
+
+#endif // RTAUDIOBACKEND_H
@@ -17,6 +17,7 @@
 ****************************************************************************/
 
 #include "rtmpreader.h"
+#include "rtmpreaderengine.h"
 
 #ifndef INT64_C
 #define INT64_C(c) (c ## LL)
@@ -28,6 +29,7 @@ extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
 #include <libswscale/swscale.h>
+#include <libswresample/swresample.h>
 #include <libavutil/opt.h>
 #include <libavdevice/avdevice.h>
 }
@@ -37,19 +39,171 @@ extern "C" {
 #include <QMutexLocker>
 #include <QAudioFormat>
 #include <QElapsedTimer>
+#include <QRunnable>
+#include <QTimer>
+
+#define DEFAULT_STATISTICS_INTERVAL 1000
+//about two seconds of video
+#define PRESENTATION_QUEUE_SIZE 64
+#define MAX_PRESENTATION_WAIT 40
+#define DEFAULT_CATCH_UP_THRESHOLD 1000
+//a late picture is not converted at all while catching up
+#define STALE_FRAME_AGE 100
+//a larger jump of the stream time against the arrival time is a restart of the stream, not a backlog
+#define STREAM_DISCONTINUITY 10000
+
+#define PACKET_QUEUE_SIZE 128
+//packets decoded by one task before the worker moves on to other streams
+#define DECODE_BATCH_SIZE 8
+#define NO_PRESENTATION -1
+
+//AVChannelLayout replaced the channels/channel_layout pair in libavutil 57.24
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(57, 24, 100)
+#define READER_CHANNEL_LAYOUT_API
+#endif
+
+class ReaderTask : public QRunnable
+{
+public:
+    explicit ReaderTask(RTMPReaderPrivate *reader)
+        : _reader(reader)
+    {
+    }
+
+protected:
+    void run()
+    {
+        this->_reader->work();
+    }
+
+private:
+    RTMPReaderPrivate *_reader;
+};
+
+//threadType 0 keeps the threading defaults of the codec
+static AVCodecContext *openDecoder(const AVStream *stream, int threadCount = 1, int threadType = 0)
+{
+    const AVCodec *codec = avcodec_find_decoder(stream->codecpar->codec_id);
+    if (!codec)
+        return NULL;
+
+    AVCodecContext *codecContext = avcodec_alloc_context3(codec);
+    if (codecContext && threadType != 0) {
+        codecContext->thread_count = threadCount;
+        codecContext->thread_type = threadType;
+    }
+
+    if (!codecContext
+            || avcodec_parameters_to_context(codecContext, stream->codecpar) < 0
+            || avcodec_open2(codecContext, codec, NULL) < 0) {
+        avcodec_free_context(&codecContext);
+        return NULL;
+    }
+
+    return codecContext;
+}
+
+//blocking reads of the input return once the reader is asked to stop
+static int interruptReading(void *opaque)
+{
+    return static_cast<const RTMPReaderPrivate *>(opaque)->isStopRequest() ? 1 : 0;
+}
+
+static AVSampleFormat sampleFormat(AudioFormat::Format format)
+{
+    switch (format) {
+    case AudioFormat::SignedInt8:
+        return AV_SAMPLE_FMT_U8;
+    case AudioFormat::SignedInt16:
+        return AV_SAMPLE_FMT_S16;
+    case AudioFormat::SignedInt32:
+        return AV_SAMPLE_FMT_S32;
+    case AudioFormat::Float32:
+        return AV_SAMPLE_FMT_FLT;
+    case AudioFormat::Float64:
+        return AV_SAMPLE_FMT_DBL;
+    default:
+        return AV_SAMPLE_FMT_NONE;
+    }
+}
+
+//converts a decoded frame into the interleaved format of the player, the jitter buffer counts time in its samples
+static QByteArray convertAudio(SwrContext *resampler, const AVFrame *frame, const AudioFormat &format)
+{
+    AVFrame *converted = av_frame_alloc();
+    if (!converted)
+        return QByteArray();
+
+    converted->format = sampleFormat(format.format());
+    converted->sample_rate = format.sampleRate();
+#ifdef READER_CHANNEL_LAYOUT_API
+    av_channel_layout_default(&converted->ch_layout, format.channelCount());
+#else
+    converted->channels = format.channelCount();
+    converted->channel_layout = av_get_default_channel_layout(format.channelCount());
+#endif
+
+    //the resampler is configured by the first frame and again whenever the stream format changes
+    int result = swr_convert_frame(resampler, converted, frame);
+    if (result == AVERROR_INPUT_CHANGED && swr_config_frame(resampler, converted, frame) >= 0)
+        result = swr_convert_frame(resampler, converted, frame);
+
+    QByteArray data;
+    if (result >= 0 && converted->nb_samples > 0) {
+        data = QByteArray(reinterpret_cast<const char *>(converted->data[0]),
+                          converted->nb_samples * format.channelCount() * format.bytesPerSample());
+    }
+
+    av_frame_free(&converted);
+
+    return data;
+}
+
+//returns the pts of a decoded frame in milliseconds
+static qint64 framePts(const AVFrame *frame, const AVStream *stream)
+{
+    if (frame->best_effort_timestamp == AV_NOPTS_VALUE)
+        return AV_NOPTS_VALUE;
+
+    return av_rescale_q(frame->best_effort_timestamp, stream->time_base, av_make_q(1, 1000));
+}
 
 RTMPReaderPrivate::RTMPReaderPrivate(QObject* parent)
     : QObject(parent)
+    , _readBytes(0)
+    , _decodedFrameCount(0)
+    , _decodedAudioFrameCount(0)
+    , _presentedFrameCount(0)
+    , _droppedFrameCount(0)
+    , _syncError(0)
+    , _backlog(0)
+    , _catchUpCount(0)
+    , _skippedPacketCount(0)
+    , _catchUpThreshold(DEFAULT_CATCH_UP_THRESHOLD)
+    , _skipToKeyFrame(true)
+    , _catchingUp(false)
+    , _decoderThreadCount(0)
+    , _decoderThreadType(FF_THREAD_FRAME | FF_THREAD_SLICE)
+    , _packetQueue(PACKET_QUEUE_SIZE)
+    , _videoCodecContext(NULL)
+    , _videoStream(NULL)
+    , _decodedFrame(NULL)
+    , _decoderCatchingUp(false)
+    , _demuxFinished(false)
+    , _decoderDrained(false)
+    , _workScheduled(false)
+    , _nextPresentationTime(NO_PRESENTATION)
+    , _audioClockReady(false)
+    , _wallClockBase(0)
+    , _scaleContext(NULL)
+    , _scaleFlags(SWS_FAST_BILINEAR)
+    , _nextRgbFrame(0)
     , _isStopped(false)
+    , _isShutDown(false)
     , _isRunning(false)
 {
-    AudioFormat rtFormat;
-    rtFormat.setChannelCount(1);
-    rtFormat.setSampleRate(44100);
-    rtFormat.setFormat(AudioFormat::SignedInt16);
-
-    player.setDeviceIndex(1);
-    player.setFormat(rtFormat);
+    //reading waits for the decoder instead of dropping packets, a backlog ends up in the catch-up mode
+    this->_packetQueue.setOverflowPolicy(BoundedQueueBase::BlockProducer);
 
 //    QAudioFormat format;
 //    format.setChannelCount(1);
@@ -66,165 +220,467 @@ RTMPReaderPrivate::RTMPReaderPrivate(QObject* parent)
 RTMPReaderPrivate::~RTMPReaderPrivate()
 {
     this->setStopRequest(true);
+    RTMPReaderEngine::instance()->unregisterReader(this);
+    this->waitForWork();
 }
 
 void RTMPReaderPrivate::start(QString url) {
-    if (this->_isRunning) {
+    if (this->_isRunning || this->_isShutDown.load()) {
         return;
     }
 
     this->_isRunning = true;
     this->setStopRequest(false);
+    this->resetStatistics();
 
     AVFormatContext* context = avformat_alloc_context();
-    AVCodecContext  *pCodecCtx;
-    int video_stream_index = -1;
-    int audio_stream_index = -1;
+    context->probesize = 200000;
+    context->max_analyze_duration = 200000;
+    context->interrupt_callback.callback = &interruptReading;
+    context->interrupt_callback.opaque = this;
 
     QString params = url + " live=1";
     if(avformat_open_input(&context, params.toUtf8().data(), NULL, NULL) != 0){
         this->_isRunning = false;
         return;
     }
-    context->probesize2 = 200000;
-    context->max_analyze_duration2 = 200000;
 
     if(avformat_find_stream_info(context, NULL) < 0){
+        avformat_close_input(&context);
         this->_isRunning = false;
         return;
     }
 
     av_dump_format(context, 0, params.toUtf8().data(), 0);
 
-    for (int i = 0; i< context->nb_streams; i++){
-        if (context->streams[i]->codec->codec_type == AVMEDIA_TYPE_VIDEO) {
-            video_stream_index = i;
-        }
+    int video_stream_index = av_find_best_stream(context, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    int audio_stream_index = av_find_best_stream(context, AVMEDIA_TYPE_AUDIO, -1, -1, NULL, 0);
 
-        if (context->streams[i]->codec->codec_type == AVMEDIA_TYPE_AUDIO) {
-            audio_stream_index = i;
-        }
-    }
+    AVCodecContext* pCodecCtx = video_stream_index >= 0 ? openDecoder(context->streams[video_stream_index],
+                                                                      this->_decoderThreadCount.load(),
+                                                                      this->_decoderThreadType.load()) : NULL;
+    AVCodecContext* audioCodecContext = audio_stream_index >= 0 ? openDecoder(context->streams[audio_stream_index]) : NULL;
 
-    AVCodec* pCodec = 0;
-    AVCodec* audioCodec = 0;
-    AVCodecContext* audioCodecContext = 0;
+    if ((video_stream_index >= 0 && !pCodecCtx) || (audio_stream_index >= 0 && !audioCodecContext)) {
+        avcodec_free_context(&pCodecCtx);
+        avcodec_free_context(&audioCodecContext);
+        avformat_close_input(&context);
+        this->_isRunning = false;
+        return;
+    }
 
-    AVFrame* pFrame    = av_frame_alloc();
     AVFrame* audioFrame = av_frame_alloc();
-    AVFrame* pFrameRGB = av_frame_alloc();
-
-    uint8_t *buffer;
-    int numBytes;
-    int res;
-    int audioFrameFinished, frameFinished;
-    AVPacket packet;
-
-    AVPixelFormat pFormat = AV_PIX_FMT_RGB24;
-
-    if (video_stream_index != -1) {
-        pCodecCtx = context->streams[video_stream_index]->codec;
-        pCodec = avcodec_find_decoder(pCodecCtx->codec_id);
+    AVPacket* packet = av_packet_alloc();
 
-        if(avcodec_open2(pCodecCtx, pCodec, NULL) < 0) {
-            this->_isRunning = false;
-            return;
-        }
+    RTMPReaderEngine *engine = RTMPReaderEngine::instance();
 
-        numBytes = avpicture_get_size(pFormat, pCodecCtx->width, pCodecCtx->height);
-        buffer = (uint8_t *) av_malloc(numBytes * sizeof(uint8_t));
-    }
+    //the shared player has one format for all streams, each stream is resampled into it
+    AudioFormat playerFormat = engine->player()->format();
+    SwrContext *resampler = audioCodecContext ? swr_alloc() : NULL;
 
-    if (audio_stream_index != -1) {
-        audioCodecContext = context->streams[audio_stream_index]->codec;
-        audioCodec = avcodec_find_decoder(audioCodecContext->codec_id);
+    this->_wallClock.invalidate();
+    this->_audioClockReady.store(false);
+    this->_nextPresentationTime.store(NO_PRESENTATION);
 
-        if(avcodec_open2(audioCodecContext, audioCodec, NULL) < 0) {
-            this->_isRunning = false;
-            return;
-        }
-    }
+    //video is decoded by tasks on the worker pool of the engine, reading the network never waits for them
+    //unless the packet queue is full
+    this->_videoCodecContext = pCodecCtx;
+    this->_videoStream = pCodecCtx ? context->streams[video_stream_index] : NULL;
+    this->_decodedFrame = av_frame_alloc();
+    this->_decoderCatchingUp = false;
+    this->_demuxFinished.store(false);
+    this->_decoderDrained.store(false);
+    this->_packetQueue.open();
 
+    engine->registerReader(this);
     this->unmute();
 
-    int currentPts = 0;
-
-    player.start();
-    QElapsedTimer timer;
-    timer.start();
+    QElapsedTimer stageTimer;
+    QElapsedTimer readClock;
+    readClock.start();
+    qint64 liveOffset = AV_NOPTS_VALUE;
+    bool waitForKeyFrame = false;
+    bool flushDecoder = false;
+    bool audioFocus = false;
 
-    while (res = av_read_frame(context, &packet) >= 0)
+    while (av_read_frame(context, packet) >= 0)
     {
         if (this->isStopRequest())
             break;
 
-        currentPts = packet.pts;
-        player.setStreamTime((static_cast<double>(packet.pts) / 1000.0f));
+        this->_readBytes.fetchAndAddRelaxed(packet->size);
+
+        if (packet->dts != AV_NOPTS_VALUE) {
+            //the stream time runs ahead of the arrival time at most as much as it did at the freshest packet,
+            //it falls back only if reading falls behind the sender
+            qint64 offset = av_rescale_q(packet->dts, context->streams[packet->stream_index]->time_base, av_make_q(1, 1000))
+                    - readClock.elapsed();
+
+            if (liveOffset == AV_NOPTS_VALUE || offset > liveOffset || liveOffset - offset > STREAM_DISCONTINUITY)
+                liveOffset = offset;
 
-        if (audio_stream_index != -1 && packet.stream_index == audio_stream_index){
-            avcodec_decode_audio4(audioCodecContext, audioFrame, &audioFrameFinished, &packet);
+            int backlog = static_cast<int>(liveOffset - offset);
+            this->_backlog.store(backlog);
 
-            if(audioFrameFinished){
-                if (packet.pts >= timer.elapsed() - 1000) {
-                    QByteArray sample;
-                    sample.resize(audioFrame->linesize[0]);
-                    memcpy(sample.data(), (char*)audioFrame->extended_data[0], audioFrame->linesize[0]);
-                    player.writeData(static_cast<double>(packet.pts) / 1000.0f, sample);
+            int threshold = this->_catchUpThreshold.load();
+            bool catchingUp = threshold > 0 && (backlog > threshold || (this->_catchingUp.load() && backlog > threshold / 2));
+
+            //the decoding tasks follow the flag and stop decoding non-reference pictures
+            if (catchingUp != static_cast<bool>(this->_catchingUp.load())) {
+                this->_catchingUp.store(catchingUp);
+
+                if (catchingUp) {
+                    this->_catchUpCount.ref();
+                    waitForKeyFrame = this->_skipToKeyFrame.load();
+
+                    //the packets still waiting for the decoder are as stale as the ones to be skipped
+                    if (waitForKeyFrame)
+                        this->_skippedPacketCount.fetchAndAddRelaxed(this->clearPacketQueue());
                 }
+            }
+        }
 
-                av_free_packet(&packet);
+        //pictures up to the next key frame are skipped without reading them into the decoder
+        if (waitForKeyFrame && pCodecCtx && packet->stream_index == video_stream_index) {
+            if (!(packet->flags & AV_PKT_FLAG_KEY)) {
+                this->_skippedPacketCount.ref();
+                av_packet_unref(packet);
+                continue;
             }
+
+            waitForKeyFrame = false;
+            flushDecoder = true;
         }
 
-        else if (video_stream_index != -1 && packet.stream_index == video_stream_index){
-            avcodec_decode_video2(pCodecCtx, pFrame, &frameFinished, &packet);
+        if (audioCodecContext && packet->stream_index == audio_stream_index){
+            //audio of the streams without the focus is not decoded at all, the decoder starts over when it gets it
+            if (engine->hasAudioFocus(this) != audioFocus) {
+                audioFocus = !audioFocus;
+                this->_audioClockReady.store(false);
+
+                if (audioFocus) {
+                    avcodec_flush_buffers(audioCodecContext);
+                    swr_close(resampler);
+                }
+            }
+
+            if (!audioFocus) {
+                av_packet_unref(packet);
+                continue;
+            }
 
-            if(frameFinished){
-                avpicture_fill((AVPicture *)pFrameRGB, buffer, pFormat, pCodecCtx->width, pCodecCtx->height);
+            stageTimer.start();
+            avcodec_send_packet(audioCodecContext, packet);
 
-                struct SwsContext * img_convert_ctx;
+            while (avcodec_receive_frame(audioCodecContext, audioFrame) >= 0) {
+                this->_audioDecodingTime.addSample(stageTimer.nsecsElapsed() / 1000);
+                this->_decodedAudioFrameCount.ref();
 
-                img_convert_ctx = sws_getCachedContext(NULL,
-                                                       pCodecCtx->width,
-                                                       pCodecCtx->height,
-                                                       pCodecCtx->pix_fmt,
-                                                       pCodecCtx->width,
-                                                       pCodecCtx->height,
-                                                       AV_PIX_FMT_RGB24,
-                                                       SWS_BICUBIC, NULL, NULL,NULL);
+                //late or lost packets are handled by the jitter buffer of the player, it keeps the playout delay
+                //at the network jitter and compensates the drift between the sender clock and the sound card
+                qint64 pts = framePts(audioFrame, context->streams[audio_stream_index]);
 
-                sws_scale(img_convert_ctx,
-                          ((AVPicture*)pFrame)->data,
-                          ((AVPicture*)pFrame)->linesize,
-                          0,
-                          pCodecCtx->height,
-                          ((AVPicture *)pFrameRGB)->data,
-                          ((AVPicture *)pFrameRGB)->linesize);
+                QByteArray sample = convertAudio(resampler, audioFrame, playerFormat);
 
-                QImage image = QImage(pFrameRGB->data[0], pFrame->width, pFrame->height, QImage::Format_RGB888);
-                emit this->frameAvailable(image);
+                //the audio clock is only used once the shared player plays samples of this stream
+                if (pts != AV_NOPTS_VALUE && !sample.isEmpty()
+                        && engine->writeAudio(this, static_cast<double>(pts) / 1000.0, sample))
+                    this->_audioClockReady.store(true);
 
-                av_free_packet(&packet);
-                sws_freeContext(img_convert_ctx);
+                av_frame_unref(audioFrame);
+                stageTimer.start();
             }
         }
+
+        else if (pCodecCtx && packet->stream_index == video_stream_index){
+            VideoPacket item;
+            item.packet = av_packet_alloc();
+            item.flush = flushDecoder;
+
+            if (item.packet) {
+                av_packet_move_ref(item.packet, packet);
+
+                if (this->_packetQueue.enqueue(item)) {
+                    flushDecoder = false;
+                    this->scheduleWork();
+                } else {
+                    av_packet_free(&item.packet);
+                }
+            }
+        }
+
+        av_packet_unref(packet);
     }
 
-    emit this->frameAvailable(QImage());
+    //the last task decodes the pictures delayed by the decoder, the engine does not queue any more after that
+    this->_demuxFinished.store(true);
+    this->scheduleWork();
+    engine->unregisterReader(this);
+    this->waitForWork();
+
+    //reading must not wait for a queue nobody empties any more
+    this->_packetQueue.close();
+    this->clearPacketQueue();
+    this->clearPresentationQueue();
+    this->_videoCodecContext = NULL;
+    this->_videoStream = NULL;
+    av_frame_free(&this->_decodedFrame);
 
-    player.stop();
+    emit this->frameAvailable(QImage());
 
-   // av_free(buffer);
-    av_free_packet(&packet);
-    av_free(pFrame);
-    av_free(pFrameRGB);
-    av_free(audioFrame);
+    av_packet_free(&packet);
+    av_frame_free(&audioFrame);
+    swr_free(&resampler);
+    avcodec_free_context(&pCodecCtx);
+    avcodec_free_context(&audioCodecContext);
     avformat_close_input(&context);
 
+    sws_freeContext(this->_scaleContext);
+    this->_scaleContext = NULL;
+
+    for (int i = 0; i < RGB_FRAME_POOL_SIZE; ++i)
+        this->_rgbFrames[i] = QImage();
+
     this->_isRunning = false;
     this->setStopRequest(false);
 }
 
+void RTMPReaderPrivate::scheduleWork()
+{
+    if (this->_workScheduled.testAndSetOrdered(false, true))
+        RTMPReaderEngine::instance()->startTask(new ReaderTask(this));
+}
+
+bool RTMPReaderPrivate::isPresentationDue(qint64 now) const
+{
+    qint64 time = this->_nextPresentationTime.load();
+    return time != NO_PRESENTATION && time <= now;
+}
+
+void RTMPReaderPrivate::work()
+{
+    if (this->_videoCodecContext)
+        this->decodeVideo();
+
+    this->presentDueFrames();
+
+    QMutexLocker locker(&this->_workMutex);
+    this->_workScheduled.store(false);
+
+    //packets queued while the task was busy would otherwise wait for the next due picture
+    if (this->_packetQueue.size() > 0 || (this->_videoCodecContext && this->_demuxFinished.load() && !this->_decoderDrained.load()))
+        this->scheduleWork();
+
+    this->_workIdle.wakeAll();
+}
+
+void RTMPReaderPrivate::waitForWork()
+{
+    QMutexLocker locker(&this->_workMutex);
+
+    while (this->_workScheduled.load() || (this->_videoCodecContext && this->_demuxFinished.load() && !this->_decoderDrained.load()))
+        this->_workIdle.wait(&this->_workMutex);
+}
+
+void RTMPReaderPrivate::decodeVideo()
+{
+    VideoPacket item;
+
+    //a batch keeps one busy stream from holding a worker while the others wait
+    for (int i = 0; i < DECODE_BATCH_SIZE && !this->isStopRequest() && this->_packetQueue.tryDequeue(&item); ++i) {
+        //freshness over completeness: non-reference pictures are not decoded at all
+        if (this->_decoderCatchingUp != static_cast<bool>(this->_catchingUp.load())) {
+            this->_decoderCatchingUp = !this->_decoderCatchingUp;
+            this->_videoCodecContext->skip_frame = this->_decoderCatchingUp ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+        }
+
+        //the first key frame after skipped packets starts from a clean decoder
+        if (item.flush)
+            avcodec_flush_buffers(this->_videoCodecContext);
+
+        this->decodeVideoPacket(item.packet, this->_decodedFrame);
+        av_packet_free(&item.packet);
+    }
+
+    //the reading thread does not wait for a decoder which has been stopped
+    if (this->isStopRequest())
+        this->clearPacketQueue();
+
+    //reading has finished after queueing the last packet, so an empty queue stays empty
+    if (this->_demuxFinished.load() && this->_packetQueue.size() == 0 && !this->_decoderDrained.load()) {
+        //at the end of the stream the pictures delayed by the decoder are presented as well
+        if (!this->isStopRequest())
+            this->decodeVideoPacket(NULL, this->_decodedFrame);
+
+        this->_decoderDrained.store(true);
+    }
+}
+
+void RTMPReaderPrivate::decodeVideoPacket(const AVPacket *packet, AVFrame *decodedFrame)
+{
+    QElapsedTimer stageTimer;
+    stageTimer.start();
+
+    avcodec_send_packet(this->_videoCodecContext, packet);
+
+    while (avcodec_receive_frame(this->_videoCodecContext, decodedFrame) >= 0) {
+        this->_videoDecodingTime.addSample(stageTimer.nsecsElapsed() / 1000);
+        this->_decodedFrameCount.ref();
+
+        //the picture is converted to RGB only when it is due, see present()
+        AVFrame *frame = av_frame_alloc();
+        if (frame) {
+            av_frame_move_ref(frame, decodedFrame);
+            frame->pts = framePts(frame, this->_videoStream);
+            this->schedule(frame);
+        }
+
+        av_frame_unref(decodedFrame);
+        stageTimer.start();
+    }
+}
+
+int RTMPReaderPrivate::clearPacketQueue()
+{
+    VideoPacket item;
+    int count = 0;
+
+    while (this->_packetQueue.tryDequeue(&item)) {
+        av_packet_free(&item.packet);
+        ++count;
+    }
+
+    return count;
+}
+
+void RTMPReaderPrivate::schedule(AVFrame *frame)
+{
+    //frames wait for a stalled clock at most this long, the oldest is dropped
+    if (this->_presentationQueue.count() >= PRESENTATION_QUEUE_SIZE) {
+        AVFrame *oldest = this->_presentationQueue.dequeue();
+        av_frame_free(&oldest);
+        this->_droppedFrameCount.ref();
+    }
+
+    this->_presentationQueue.enqueue(frame);
+}
+
+void RTMPReaderPrivate::clearPresentationQueue()
+{
+    while (!this->_presentationQueue.isEmpty()) {
+        AVFrame *frame = this->_presentationQueue.dequeue();
+        av_frame_free(&frame);
+    }
+
+    this->_nextPresentationTime.store(NO_PRESENTATION);
+}
+
+qint64 RTMPReaderPrivate::masterClock()
+{
+    RTMPReaderEngine *engine = RTMPReaderEngine::instance();
+    AudioPlayer *player = engine->player();
+
+    //another stream may still be heard until this one has written samples since it got the focus
+    qint64 audioClock = this->_audioClockReady.load() && engine->hasAudioFocus(this)
+            && player->state() == AbstractGrabber::ActiveState ? player->playbackPosition() : -1;
+
+    //the wall clock takes over where the audio clock stopped, e.g. while muted
+    if (audioClock >= 0) {
+        this->_wallClockBase = audioClock;
+        this->_wallClock.start();
+        return audioClock;
+    }
+
+    if (!this->_wallClock.isValid())
+        return AV_NOPTS_VALUE;
+
+    return this->_wallClockBase + this->_wallClock.elapsed();
+}
+
+void RTMPReaderPrivate::presentDueFrames()
+{
+    while (!this->_presentationQueue.isEmpty() && !this->isStopRequest()) {
+        AVFrame *frame = this->_presentationQueue.head();
+        qint64 clock = this->masterClock();
+
+        //while catching up a stale picture is not worth its conversion even if it is the last one
+        if (this->_catchingUp.load() && clock != AV_NOPTS_VALUE && frame->pts != AV_NOPTS_VALUE
+                && clock - frame->pts > STALE_FRAME_AGE) {
+            this->_presentationQueue.dequeue();
+            av_frame_free(&frame);
+            this->_droppedFrameCount.ref();
+            continue;
+        }
+
+        //without any clock yet the first frame starts the wall clock
+        if (clock == AV_NOPTS_VALUE && frame->pts != AV_NOPTS_VALUE) {
+            this->_wallClockBase = frame->pts;
+            this->_wallClock.start();
+            clock = frame->pts;
+        }
+
+        if (frame->pts != AV_NOPTS_VALUE && frame->pts > clock) {
+            //the engine queues the next task when the picture is due, the clock is checked again at least this often
+            this->_nextPresentationTime.store(RTMPReaderEngine::instance()->now() + qMin<qint64>(frame->pts - clock, MAX_PRESENTATION_WAIT));
+            return;
+        }
+
+        this->_presentationQueue.dequeue();
+
+        //a frame is skipped without conversion if the next one is due as well
+        const AVFrame *next = this->_presentationQueue.isEmpty() ? NULL : this->_presentationQueue.head();
+        if (next && next->pts != AV_NOPTS_VALUE && next->pts <= clock) {
+            av_frame_free(&frame);
+            this->_droppedFrameCount.ref();
+            continue;
+        }
+
+        if (frame->pts != AV_NOPTS_VALUE)
+            this->_syncError.store(static_cast<int>(clock - frame->pts));
+
+        this->convert(frame);
+        av_frame_free(&frame);
+    }
+
+    //new pictures come with new packets, which queue a task anyway
+    this->_nextPresentationTime.store(NO_PRESENTATION);
+}
+
+void RTMPReaderPrivate::convert(const AVFrame *frame)
+{
+    QElapsedTimer stageTimer;
+    stageTimer.start();
+
+    //the scaler is only rebuilt when the stream resolution, pixel format or algorithm changes
+    this->_scaleContext = sws_getCachedContext(this->_scaleContext,
+                                               frame->width,
+                                               frame->height,
+                                               static_cast<AVPixelFormat>(frame->format),
+                                               frame->width,
+                                               frame->height,
+                                               AV_PIX_FMT_RGB24,
+                                               this->scaleFlags(), NULL, NULL, NULL);
+
+    if (this->_scaleContext) {
+        //the pooled image is not shared here, so bits() does not detach it
+        QImage &image = this->rgbFrame(frame->width, frame->height);
+        uint8_t *rgbData[1] = { image.bits() };
+        int rgbLinesize[1] = { image.bytesPerLine() };
+
+        sws_scale(this->_scaleContext,
+                  frame->data,
+                  frame->linesize,
+                  0,
+                  frame->height,
+                  rgbData,
+                  rgbLinesize);
+
+        this->_conversionTime.addSample(stageTimer.nsecsElapsed() / 1000);
+        this->_presentedFrameCount.ref();
+        emit this->frameAvailable(image);
+    }
+}
+
 void RTMPReaderPrivate::setStopRequest(bool stop)
 {
     QMutexLocker locker(&_stopPauseMutex);
@@ -233,7 +689,16 @@ void RTMPReaderPrivate::setStopRequest(bool stop)
 
 bool RTMPReaderPrivate::isStopRequest() const
 {
-    return this->_isStopped;
+    return this->_isStopped || this->_isShutDown.load();
+}
+
+void RTMPReaderPrivate::shutdown()
+{
+    this->_isShutDown.store(true);
+    this->setStopRequest(true);
+
+    //reading may wait for room in the queue, the decoding tasks do not empty it after the stop request
+    this->_packetQueue.close();
 }
 
 bool RTMPReaderPrivate::isRunning() const
@@ -243,53 +708,167 @@ bool RTMPReaderPrivate::isRunning() const
 
 void RTMPReaderPrivate::mute()
 {
-    player.suspend();
+    RTMPReaderEngine *engine = RTMPReaderEngine::instance();
+    if (engine->hasAudioFocus(this))
+        engine->player()->suspend();
 }
 
 void RTMPReaderPrivate::unmute()
 {
-    player.resume();
+    RTMPReaderEngine *engine = RTMPReaderEngine::instance();
+    if (engine->hasAudioFocus(this))
+        engine->player()->resume();
+}
+
+void RTMPReaderPrivate::setScaleFlags(int flags)
+{
+    this->_scaleFlags.store(flags);
+}
+
+int RTMPReaderPrivate::scaleFlags() const
+{
+    return this->_scaleFlags.load();
+}
+
+void RTMPReaderPrivate::setDecoderThreading(int threadCount, int threadType)
+{
+    this->_decoderThreadCount.store(threadCount);
+    this->_decoderThreadType.store(threadType);
+}
+
+void RTMPReaderPrivate::setCatchUpThreshold(int msecs)
+{
+    this->_catchUpThreshold.store(msecs);
+}
+
+void RTMPReaderPrivate::setSkipToKeyFrame(bool skip)
+{
+    this->_skipToKeyFrame.store(skip);
+}
+
+QVariantMap RTMPReaderPrivate::statistics() const
+{
+    QVariantMap statistics;
+    statistics["readBytes"] = this->_readBytes.load();
+    statistics["decodedFrameCount"] = this->_decodedFrameCount.load();
+    statistics["decodedAudioFrameCount"] = this->_decodedAudioFrameCount.load();
+    statistics["presentedFrameCount"] = this->_presentedFrameCount.load();
+    statistics["droppedFrameCount"] = this->_droppedFrameCount.load();
+    statistics["avSyncError"] = this->_syncError.load();
+    statistics["backlog"] = this->_backlog.load();
+    statistics["videoPacketQueueDepth"] = this->_packetQueue.size();
+    statistics["catchUpCount"] = this->_catchUpCount.load();
+    statistics["skippedPacketCount"] = this->_skippedPacketCount.load();
+
+    //the player is shared, its state belongs to the reader with the audio focus
+    RTMPReaderEngine *engine = RTMPReaderEngine::instance();
+    statistics["audioFocus"] = engine->hasAudioFocus(this);
+
+    if (engine->hasAudioFocus(this)) {
+        const AudioPlayer *player = engine->player();
+        statistics["audioUnderrunCount"] = player->underrunCount();
+        statistics["audioBufferedDuration"] = player->bufferedDuration();
+        statistics["audioPlayoutDelay"] = player->playoutDelay();
+        statistics["audioDroppedDuration"] = player->droppedDuration();
+        statistics["audioJitter"] = player->jitter();
+        statistics["audioClockDrift"] = player->clockDrift();
+    }
+
+    statistics["videoDecodingTime"] = this->_videoDecodingTime.toVariantMap();
+    statistics["audioDecodingTime"] = this->_audioDecodingTime.toVariantMap();
+    statistics["conversionTime"] = this->_conversionTime.toVariantMap();
+
+    return statistics;
+}
+
+void RTMPReaderPrivate::resetStatistics()
+{
+    this->_readBytes.store(0);
+    this->_decodedFrameCount.store(0);
+    this->_decodedAudioFrameCount.store(0);
+    this->_presentedFrameCount.store(0);
+    this->_droppedFrameCount.store(0);
+    this->_syncError.store(0);
+    this->_backlog.store(0);
+    this->_catchUpCount.store(0);
+    this->_skippedPacketCount.store(0);
+    this->_catchingUp.store(false);
+    this->_videoDecodingTime.reset();
+    this->_audioDecodingTime.reset();
+    this->_conversionTime.reset();
+}
+
+QImage &RTMPReaderPrivate::rgbFrame(int width, int height)
+{
+    //an image nobody else refers to any more has been painted already, so its pixels are reused
+    for (int i = 0; i < RGB_FRAME_POOL_SIZE; ++i) {
+        QImage &frame = this->_rgbFrames[i];
+
+        if (frame.isDetached() && frame.width() == width && frame.height() == height)
+            return frame;
+    }
+
+    //a replaced image that is still on screen keeps its pixels until it is painted
+    QImage &frame = this->_rgbFrames[this->_nextRgbFrame];
+    this->_nextRgbFrame = (this->_nextRgbFrame + 1) % RGB_FRAME_POOL_SIZE;
+
+    frame = QImage(width, height, QImage::Format_RGB888);
+    return frame;
 }
 
 RTMPReader::RTMPReader(QQuickItem *parent)
-    : QQuickPaintedItem(parent)
+    : VideoItem(parent)
+    , _scaleAlgorithm(RTMPReader::FastBilinear)
+    , _catchUpThreshold(DEFAULT_CATCH_UP_THRESHOLD)
+    , _skipToKeyFrame(true)
+    , _decoderThreadCount(0)
+    , _decoderThreading(RTMPReader::FrameAndSliceThreading)
+    , _hasAudioFocus(false)
+    , _statisticsTimer(new QTimer(this))
+    , _lastDecodedFrameCount(0)
+    , _frameRate(0.0)
     , _thread(new QThread(this))
     , d_ptr(new RTMPReaderPrivate())
 {
+#if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58, 9, 100)
     av_register_all();
-    avdevice_register_all();
     avcodec_register_all();
+#endif
+    avdevice_register_all();
     avformat_network_init();
 
     this->d_ptr->moveToThread(this->_thread);
     connect(d_ptr, &RTMPReaderPrivate::frameAvailable,
             this, &RTMPReader::frameAvailable);
 
+    this->_statisticsTimer->setInterval(DEFAULT_STATISTICS_INTERVAL);
+    connect(this->_statisticsTimer, &QTimer::timeout,
+            this, &RTMPReader::updateStatistics);
+
+    //the first reader is heard, like a single reader always was
+    RTMPReaderEngine *engine = RTMPReaderEngine::instance();
+    connect(engine, &RTMPReaderEngine::audioFocusChanged,
+            this, &RTMPReader::updateAudioFocus);
+
+    if (!engine->audioFocus())
+        engine->setAudioFocus(this->d_ptr);
+
     this->_thread->start();
 }
 
 RTMPReader::~RTMPReader()
 {
-    this->_thread->terminate();
-//    delete this->d_ptr;
-//    this->d_ptr = 0;
-}
-
-void RTMPReader::paint(QPainter *painter)
-{
-    QRect paintRect = this->_frame.rect();
-    QImage frame = this->_frame;
+    RTMPReaderEngine *engine = RTMPReaderEngine::instance();
+    if (engine->hasAudioFocus(this->d_ptr))
+        engine->setAudioFocus(NULL);
 
-    if (!this->_frame.isNull()) {
-        if (paintRect.width() != painter->window().width() ||
-            paintRect.height() != painter->window().height()) {
-            frame = frame.scaled(painter->window().width(), painter->window().height(),
-                                 Qt::KeepAspectRatio);
-        }
-    }
+    //start() returns on the reading thread, which then leaves its event loop
+    this->d_ptr->shutdown();
+    this->_thread->quit();
+    this->_thread->wait();
 
-    painter->drawImage(QPoint(0,0), frame);
-    this->update();
+    delete this->d_ptr;
+    this->d_ptr = 0;
 }
 
 QString RTMPReader::url()
@@ -305,6 +884,158 @@ void RTMPReader::setUrl(const QString &newUrl)
     }
 }
 
+RTMPReader::ScaleAlgorithm RTMPReader::scaleAlgorithm() const
+{
+    return this->_scaleAlgorithm;
+}
+
+void RTMPReader::setScaleAlgorithm(RTMPReader::ScaleAlgorithm algorithm)
+{
+    if (this->_scaleAlgorithm != algorithm) {
+        this->_scaleAlgorithm = algorithm;
+
+        int flags;
+        switch (algorithm) {
+        case RTMPReader::Point:
+            flags = SWS_POINT;
+            break;
+        case RTMPReader::Bilinear:
+            flags = SWS_BILINEAR;
+            break;
+        case RTMPReader::Bicubic:
+            flags = SWS_BICUBIC;
+            break;
+        default:
+            flags = SWS_FAST_BILINEAR;
+            break;
+        }
+
+        this->d_ptr->setScaleFlags(flags);
+        emit this->scaleAlgorithmChanged();
+    }
+}
+
+int RTMPReader::catchUpThreshold() const
+{
+    return this->_catchUpThreshold;
+}
+
+void RTMPReader::setCatchUpThreshold(int msecs)
+{
+    msecs = qMax(msecs, 0);
+
+    if (this->_catchUpThreshold != msecs) {
+        this->_catchUpThreshold = msecs;
+        this->d_ptr->setCatchUpThreshold(msecs);
+        emit this->catchUpThresholdChanged();
+    }
+}
+
+bool RTMPReader::skipToKeyFrame() const
+{
+    return this->_skipToKeyFrame;
+}
+
+void RTMPReader::setSkipToKeyFrame(bool skip)
+{
+    if (this->_skipToKeyFrame != skip) {
+        this->_skipToKeyFrame = skip;
+        this->d_ptr->setSkipToKeyFrame(skip);
+        emit this->skipToKeyFrameChanged();
+    }
+}
+
+int RTMPReader::decoderThreadCount() const
+{
+    return this->_decoderThreadCount;
+}
+
+void RTMPReader::setDecoderThreadCount(int count)
+{
+    count = qMax(count, 0);
+
+    if (this->_decoderThreadCount != count) {
+        this->_decoderThreadCount = count;
+        this->updateDecoderThreading();
+    }
+}
+
+RTMPReader::DecoderThreading RTMPReader::decoderThreading() const
+{
+    return this->_decoderThreading;
+}
+
+void RTMPReader::setDecoderThreading(RTMPReader::DecoderThreading threading)
+{
+    if (this->_decoderThreading != threading) {
+        this->_decoderThreading = threading;
+        this->updateDecoderThreading();
+    }
+}
+
+void RTMPReader::updateDecoderThreading()
+{
+    int threadType;
+    switch (this->_decoderThreading) {
+    case RTMPReader::FrameThreading:
+        threadType = FF_THREAD_FRAME;
+        break;
+    case RTMPReader::SliceThreading:
+        threadType = FF_THREAD_SLICE;
+        break;
+    default:
+        threadType = FF_THREAD_FRAME | FF_THREAD_SLICE;
+        break;
+    }
+
+    this->d_ptr->setDecoderThreading(this->_decoderThreadCount, threadType);
+    emit this->decoderThreadingChanged();
+}
+
+bool RTMPReader::hasAudioFocus() const
+{
+    return this->_hasAudioFocus;
+}
+
+void RTMPReader::setAudioFocus(bool focus)
+{
+    RTMPReaderEngine *engine = RTMPReaderEngine::instance();
+
+    if (focus)
+        engine->setAudioFocus(this->d_ptr);
+    else if (engine->hasAudioFocus(this->d_ptr))
+        engine->setAudioFocus(NULL);
+}
+
+QVariantMap RTMPReader::statistics() const
+{
+    QVariantMap statistics = this->d_ptr->statistics();
+    statistics["frameRate"] = this->_frameRate;
+
+    return statistics;
+}
+
+int RTMPReader::statisticsInterval() const
+{
+    return this->_statisticsTimer->interval();
+}
+
+void RTMPReader::setStatisticsInterval(int msecs)
+{
+    msecs = qMax(msecs, 0);
+
+    if (this->_statisticsTimer->interval() != msecs) {
+        this->_statisticsTimer->setInterval(msecs);
+
+        if (msecs == 0)
+            this->_statisticsTimer->stop();
+        else if (this->d_ptr->isRunning())
+            this->_statisticsTimer->start();
+
+        emit this->statisticsIntervalChanged();
+    }
+}
+
 void RTMPReader::start(QString url)
 {
     if (!url.isEmpty()) {
@@ -316,8 +1047,16 @@ void RTMPReader::start(QString url)
         return;
     }
 
-    if (!d_ptr->isRunning())
+    if (!d_ptr->isRunning()) {
         QMetaObject::invokeMethod(d_ptr, "start", Qt::QueuedConnection, Q_ARG(QString, this->url()));
+
+        this->_lastDecodedFrameCount = 0;
+        this->_frameRate = 0.0;
+        this->_statisticsClock.start();
+
+        if (this->statisticsInterval() > 0)
+            this->_statisticsTimer->start();
+    }
 }
 
 void RTMPReader::stop()
@@ -337,5 +1076,35 @@ void RTMPReader::unmute()
 
 void RTMPReader::frameAvailable(QImage image)
 {
-    this->_frame = image;
+    this->setFrame(image);
+}
+
+void RTMPReader::updateStatistics()
+{
+    qint64 elapsed = this->_statisticsClock.restart();
+
+    QVariantMap statistics = this->d_ptr->statistics();
+
+    //the counters are reset by the reading thread when it starts
+    int decodedFrameCount = statistics.value("decodedFrameCount").toInt();
+    int decodedFrames = decodedFrameCount - (decodedFrameCount >= this->_lastDecodedFrameCount ? this->_lastDecodedFrameCount : 0);
+    this->_lastDecodedFrameCount = decodedFrameCount;
+    this->_frameRate = elapsed > 0 ? decodedFrames * 1000.0 / elapsed : 0.0;
+
+    statistics["frameRate"] = this->_frameRate;
+    emit this->statisticsUpdated(statistics);
+
+    //the last snapshot is sent after reading has finished
+    if (!this->d_ptr->isRunning())
+        this->_statisticsTimer->stop();
+}
+
+void RTMPReader::updateAudioFocus()
+{
+    bool focus = RTMPReaderEngine::instance()->hasAudioFocus(this->d_ptr);
+
+    if (this->_hasAudioFocus != focus) {
+        this->_hasAudioFocus = focus;
+        emit this->audioFocusChanged();
+    }
 }
@@ -19,20 +19,41 @@
 #ifndef RTMPREADER_H
 #define RTMPREADER_H
 
-#include <QQuickItem>
-#include <QQuickPaintedItem>
 #include <QImage>
-#include <QPainter>
 #include <QThread>
 #include <QMutex>
+#include <QQueue>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QVariantMap>
 #include <QAudioOutput>
 #include <QIODevice>
 #include <QAudioOutput>
 
-#include <audioplayer.h>
+#include "videoitem.h"
+#include "helpers/boundedqueue.h"
+#include "helpers/latencyhistogram.h"
 
 
+#define RGB_FRAME_POOL_SIZE 3
+
 class AudioBuffer;
+class QTimer;
+class ReaderTask;
+struct AVCodecContext;
+struct AVFrame;
+struct AVPacket;
+struct AVStream;
+struct SwsContext;
+
+/*! A compressed picture on its way from the reading thread to the decoding tasks. */
+struct VideoPacket
+{
+    AVPacket *packet;
+    bool flush; /*!< The decoder is flushed before the packet, it is the first key frame after skipped packets. */
+};
 
 class RTMPReaderPrivate: public QObject
 {
@@ -57,36 +78,223 @@ public Q_SLOTS:
     */
     bool isStopRequest() const;
 
+    /*!
+      Stops reading for good: a running start() returns, also from a blocking network call, and later calls of
+      start() do nothing. It may be called from any thread.
+    */
+    void shutdown();
+
     bool isRunning() const;
 
+    /*! Mute and unmute only affect the shared player while the reader has the audio focus. */
     void mute();
     void unmute();
 
+    /*!
+      Sets the swscale algorithm flag used to convert decoded pictures to RGB.
+      The scaler is only rebuilt when the flag, the picture size or the pixel format changes.
+    */
+    void setScaleFlags(int flags);
+    int scaleFlags() const;
+
+    /*!
+      Sets the threading of the video decoder, it takes effect at the next start().
+      \a threadCount 0 lets FFmpeg choose, \a threadType is a combination of FF_THREAD_FRAME and FF_THREAD_SLICE.
+    */
+    void setDecoderThreading(int threadCount, int threadType);
+
+    /*!
+      Sets how many milliseconds reading may fall behind the stream before the catch-up mode starts, 0 disables it.
+      In the catch-up mode non-reference pictures are not decoded and stale pictures are not converted.
+      It ends when the backlog is below half of the threshold.
+    */
+    void setCatchUpThreshold(int msecs);
+    /*! Sets whether the catch-up mode also skips video to the next key frame. */
+    void setSkipToKeyFrame(bool skip);
+
+    /*!
+      Returns a snapshot of the decoding statistics. It may be called from any thread while decoding,
+      the counters are reset when start() is called.
+    */
+    QVariantMap statistics() const;
+
 signals:
     void frameAvailable(QImage image);
 
 private:
+    friend class ReaderTask;
+    friend class RTMPReaderEngine;
+
+    /*!
+      Queues work() on the pool of the RTMPReaderEngine unless it is queued already,
+      so the work of one stream never runs on two workers at the same time.
+    */
+    void scheduleWork();
+    /*! Returns whether the next picture is due at \a now, the time of the engine clock. */
+    bool isPresentationDue(qint64 now) const;
+    /*!
+      One task of the worker pool: decodes a batch of queued packets and presents the pictures which are due.
+      It is queued again by the reading thread for new packets and by the engine scheduler for due pictures.
+    */
+    void work();
+    void waitForWork();
+
+    void decodeVideo();
+    void decodeVideoPacket(const AVPacket *packet, AVFrame *decodedFrame);
+    int clearPacketQueue();
+
+    /*!
+      Queues a decoded picture, its pts in milliseconds, for presentation.
+      presentDueFrames() converts it to RGB and emits frameAvailable() when the master clock reaches the pts:
+      the playback position of the shared player while the reader has the audio focus, or a wall clock otherwise.
+      Pictures which are overtaken by the next one are dropped before conversion.
+    */
+    void schedule(AVFrame *frame);
+    void presentDueFrames();
+    void clearPresentationQueue();
+    qint64 masterClock();
+    void convert(const AVFrame *frame);
+
+    QImage &rgbFrame(int width, int height);
+    void resetStatistics();
+
+    QAtomicInteger<qint64> _readBytes;
+    QAtomicInt _decodedFrameCount;
+    QAtomicInt _decodedAudioFrameCount;
+    QAtomicInt _presentedFrameCount;
+    QAtomicInt _droppedFrameCount;
+    QAtomicInt _syncError;
+    QAtomicInt _backlog;
+    QAtomicInt _catchUpCount;
+    QAtomicInt _skippedPacketCount;
+    QAtomicInt _catchUpThreshold;
+    QAtomicInt _skipToKeyFrame;
+    QAtomicInt _catchingUp;
+    LatencyHistogram _videoDecodingTime;
+    LatencyHistogram _audioDecodingTime;
+    LatencyHistogram _conversionTime;
+
+    QAtomicInt _decoderThreadCount;
+    QAtomicInt _decoderThreadType;
+    BoundedQueue<VideoPacket> _packetQueue;
+    AVCodecContext *_videoCodecContext;
+    const AVStream *_videoStream;
+    AVFrame *_decodedFrame;
+    bool _decoderCatchingUp;
+    QAtomicInt _demuxFinished;
+    QAtomicInt _decoderDrained;
+
+    QAtomicInt _workScheduled;
+    QMutex _workMutex;
+    QWaitCondition _workIdle;
+    QAtomicInteger<qint64> _nextPresentationTime;
+
+    //only touched by work(), which never runs twice at the same time
+    QQueue<AVFrame *> _presentationQueue;
+    QAtomicInt _audioClockReady;
+    qint64 _wallClockBase;
+    QElapsedTimer _wallClock;
+
+    SwsContext *_scaleContext;
+    QAtomicInt _scaleFlags;
+    QImage _rgbFrames[RGB_FRAME_POOL_SIZE];
+    int _nextRgbFrame;
     bool _isStopped;
+    QAtomicInt _isShutDown;
     QMutex _stopPauseMutex;
-    AudioPlayer player;
     bool _isRunning;
 };
 
-class RTMPReader : public QQuickPaintedItem
+class RTMPReader : public VideoItem
 {
     Q_OBJECT
     Q_DISABLE_COPY(RTMPReader)
     Q_PROPERTY(QString url READ url WRITE setUrl NOTIFY urlChanged)
+    Q_PROPERTY(ScaleAlgorithm scaleAlgorithm READ scaleAlgorithm WRITE setScaleAlgorithm NOTIFY scaleAlgorithmChanged)
+    Q_PROPERTY(int catchUpThreshold READ catchUpThreshold WRITE setCatchUpThreshold NOTIFY catchUpThresholdChanged)
+    Q_PROPERTY(bool skipToKeyFrame READ skipToKeyFrame WRITE setSkipToKeyFrame NOTIFY skipToKeyFrameChanged)
+    Q_PROPERTY(int decoderThreadCount READ decoderThreadCount WRITE setDecoderThreadCount NOTIFY decoderThreadingChanged)
+    Q_PROPERTY(DecoderThreading decoderThreading READ decoderThreading WRITE setDecoderThreading NOTIFY decoderThreadingChanged)
+    Q_PROPERTY(bool audioFocus READ hasAudioFocus WRITE setAudioFocus NOTIFY audioFocusChanged)
+    Q_PROPERTY(QVariantMap statistics READ statistics NOTIFY statisticsUpdated)
+    Q_PROPERTY(int statisticsInterval READ statisticsInterval WRITE setStatisticsInterval NOTIFY statisticsIntervalChanged)
+    Q_ENUMS(ScaleAlgorithm)
+    Q_ENUMS(DecoderThreading)
 
 public:
+    /*! This enum describes the algorithm converting decoded pictures to RGB. */
+    enum ScaleAlgorithm {
+        FastBilinear = 0, /*!< Fastest conversion, the default. */
+        Point, /*!< Nearest neighbour, cheapest chroma upsampling. */
+        Bilinear,
+        Bicubic /*!< Best quality, slowest. */
+    };
+
+    /*! This enum describes how the video decoder uses several threads. */
+    enum DecoderThreading {
+        FrameAndSliceThreading = 0, /*!< Whatever the codec supports, the default. */
+        FrameThreading, /*!< Consecutive pictures are decoded in parallel, which delays the output by one picture per thread. */
+        SliceThreading /*!< The slices of one picture are decoded in parallel, without delay. Only helps with streams encoded in several slices. */
+    };
+
     explicit RTMPReader(QQuickItem *parent = 0);
     virtual ~RTMPReader();
 
-    void paint(QPainter *painter);
-
     QString url();
     void setUrl(const QString& newUrl);
 
+    ScaleAlgorithm scaleAlgorithm() const;
+    void setScaleAlgorithm(ScaleAlgorithm algorithm);
+
+    /*!
+      Sets how many milliseconds reading may fall behind the live stream before the reader catches up, preferring
+      freshness over completeness. The default value is 1000, 0 disables catching up.
+    */
+    int catchUpThreshold() const;
+    void setCatchUpThreshold(int msecs);
+
+    /*! Sets whether catching up skips video to the next key frame. The default value is true. */
+    bool skipToKeyFrame() const;
+    void setSkipToKeyFrame(bool skip);
+
+    /*!
+      Sets how many threads decode video, 0 (the default) uses one per CPU core.
+      Threading changes take effect at the next start(). Readers already decode in parallel on the worker pool of
+      RTMPReaderEngine, so with many readers 1 avoids running more threads than there are cores.
+    */
+    int decoderThreadCount() const;
+    void setDecoderThreadCount(int count);
+
+    DecoderThreading decoderThreading() const;
+    void setDecoderThreading(DecoderThreading threading);
+
+    /*!
+      Sets whether this reader plays its audio. Only one reader of the application has the audio focus, giving it to
+      one takes it from the other. The first reader created gets it, readers without it present video on a wall clock
+      and do not decode audio at all.
+    */
+    bool hasAudioFocus() const;
+    void setAudioFocus(bool focus);
+
+    /*!
+      Returns the decoding statistics:
+      - the counters readBytes, decodedFrameCount, decodedAudioFrameCount, presentedFrameCount, droppedFrameCount
+        (late pictures never converted), catchUpCount, skippedPacketCount (video packets skipped to reach a key frame),
+        videoPacketQueueDepth (packets waiting for the decoding tasks) and audioUnderrunCount;
+      - in milliseconds backlog (how far reading is behind the stream), avSyncError (how late the last picture was
+        presented against the master clock, negative if early), audioBufferedDuration, audioPlayoutDelay,
+        audioDroppedDuration (samples too late to be played) and audioJitter;
+      - audioClockDrift in parts per million and frameRate (decoded frames per second during the last interval);
+      - audioFocus, the audio entries are only present while it is true;
+      - the latency maps videoDecodingTime, audioDecodingTime and conversionTime with count, average, p50, p95, p99
+        and max in microseconds.
+    */
+    QVariantMap statistics() const;
+
+    /*! Sets how often statisticsUpdated() is emitted while reading, in milliseconds. The default value is 1000, 0 disables the signal. */
+    int statisticsInterval() const;
+    void setStatisticsInterval(int msecs);
+
 public slots:
     Q_INVOKABLE void start(QString url = QString());
     Q_INVOKABLE void stop();
@@ -96,13 +304,33 @@ public slots:
 
 signals:
     void urlChanged();
+    void scaleAlgorithmChanged();
+    void catchUpThresholdChanged();
+    void skipToKeyFrameChanged();
+    void decoderThreadingChanged();
+    void audioFocusChanged();
+    void statisticsIntervalChanged();
+    void statisticsUpdated(const QVariantMap &statistics);
 
 private slots:
     void frameAvailable(QImage image);
+    void updateStatistics();
+    void updateAudioFocus();
 
 private:
-    QImage _frame;
+    void updateDecoderThreading();
+
     QString _url;
+    ScaleAlgorithm _scaleAlgorithm;
+    int _catchUpThreshold;
+    bool _skipToKeyFrame;
+    int _decoderThreadCount;
+    DecoderThreading _decoderThreading;
+    bool _hasAudioFocus;
+    QTimer* _statisticsTimer;
+    QElapsedTimer _statisticsClock;
+    int _lastDecodedFrameCount;
+    double _frameRate;
     QThread* _thread;
     RTMPReaderPrivate* d_ptr;
 };
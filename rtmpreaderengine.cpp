@@ -0,0 +1,208 @@
+/****************************************************************************
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License as published by the Free Software Foundation; either
+** version 2.1 of the License, or (at your option) any later version.
+**
+** This library is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public
+** License along with this library; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**
+****************************************************************************/
+
+
+#include "rtmpreaderengine.h"
+#include "rtmpreader.h"
+
+#include <QThread>
+#include <QMutexLocker>
+
+//how often the scheduler looks for due pictures, well below the duration of a frame
+#define SCHEDULER_INTERVAL 5
+
+class SchedulerThread : public QThread
+{
+public:
+    explicit SchedulerThread(RTMPReaderEngine *engine)
+        : _engine(engine)
+    {
+    }
+
+protected:
+    void run()
+    {
+        this->_engine->schedule();
+    }
+
+private:
+    RTMPReaderEngine *_engine;
+};
+
+Q_GLOBAL_STATIC(RTMPReaderEngine, globalEngine)
+
+RTMPReaderEngine::RTMPReaderEngine()
+    : _schedulerThread(new SchedulerThread(this))
+    , _schedulerStopped(false)
+    , _audioFocus(NULL)
+{
+    this->_clock.start();
+    this->_pool.setMaxThreadCount(QThread::idealThreadCount());
+
+    AudioFormat rtFormat;
+    rtFormat.setChannelCount(1);
+    rtFormat.setSampleRate(44100);
+    rtFormat.setFormat(AudioFormat::SignedInt16);
+
+    this->_player.setDeviceIndex(this->_player.defaultAudioDeviceIndex());
+    this->_player.setFormat(rtFormat);
+
+    this->_schedulerThread->start();
+}
+
+RTMPReaderEngine::~RTMPReaderEngine()
+{
+    {
+        QMutexLocker locker(&this->_mutex);
+        this->_schedulerStopped = true;
+        this->_schedulerCondition.wakeOne();
+    }
+
+    this->_schedulerThread->wait();
+    delete this->_schedulerThread;
+
+    this->_pool.waitForDone();
+    this->_player.stop();
+}
+
+RTMPReaderEngine *RTMPReaderEngine::instance()
+{
+    return globalEngine();
+}
+
+void RTMPReaderEngine::setWorkerCount(int count)
+{
+    this->_pool.setMaxThreadCount(count > 0 ? count : QThread::idealThreadCount());
+}
+
+int RTMPReaderEngine::workerCount() const
+{
+    return this->_pool.maxThreadCount();
+}
+
+int RTMPReaderEngine::readerCount() const
+{
+    QMutexLocker locker(&this->_mutex);
+    return this->_readers.count();
+}
+
+void RTMPReaderEngine::setAudioFocus(RTMPReaderPrivate *reader)
+{
+    {
+        QMutexLocker locker(&this->_audioMutex);
+        if (this->_audioFocus == reader)
+            return;
+
+        this->_audioFocus = reader;
+
+        //the pts of the next stream have nothing to do with the buffered ones
+        this->_player.restartTimeline();
+    }
+
+    emit this->audioFocusChanged();
+}
+
+RTMPReaderPrivate *RTMPReaderEngine::audioFocus() const
+{
+    QMutexLocker locker(&this->_audioMutex);
+    return this->_audioFocus;
+}
+
+bool RTMPReaderEngine::hasAudioFocus(const RTMPReaderPrivate *reader) const
+{
+    QMutexLocker locker(&this->_audioMutex);
+    return reader && this->_audioFocus == reader;
+}
+
+AudioPlayer *RTMPReaderEngine::player()
+{
+    return &this->_player;
+}
+
+qint64 RTMPReaderEngine::now() const
+{
+    return this->_clock.elapsed();
+}
+
+void RTMPReaderEngine::registerReader(RTMPReaderPrivate *reader)
+{
+    bool first;
+    {
+        QMutexLocker locker(&this->_mutex);
+        if (this->_readers.contains(reader))
+            return;
+
+        first = this->_readers.isEmpty();
+        this->_readers.append(reader);
+    }
+
+    if (first) {
+        QMutexLocker locker(&this->_audioMutex);
+        this->_player.start();
+    }
+}
+
+void RTMPReaderEngine::unregisterReader(RTMPReaderPrivate *reader)
+{
+    bool last;
+    {
+        //the scheduler holds the lock while it queues work, so it does not touch the reader afterwards
+        QMutexLocker locker(&this->_mutex);
+        if (!this->_readers.removeOne(reader))
+            return;
+
+        last = this->_readers.isEmpty();
+    }
+
+    if (last) {
+        QMutexLocker locker(&this->_audioMutex);
+        this->_player.stop();
+    }
+}
+
+void RTMPReaderEngine::startTask(QRunnable *task)
+{
+    this->_pool.start(task);
+}
+
+bool RTMPReaderEngine::writeAudio(const RTMPReaderPrivate *reader, double pts, const QByteArray &data)
+{
+    //the jitter buffer of the player takes one producer, the lock serializes the readers around a focus change
+    QMutexLocker locker(&this->_audioMutex);
+    if (this->_audioFocus != reader)
+        return false;
+
+    this->_player.writeData(pts, data);
+    return true;
+}
+
+void RTMPReaderEngine::schedule()
+{
+    QMutexLocker locker(&this->_mutex);
+
+    while (!this->_schedulerStopped) {
+        qint64 now = this->now();
+
+        for (int i = 0; i < this->_readers.count(); ++i) {
+            if (this->_readers.at(i)->isPresentationDue(now))
+                this->_readers.at(i)->scheduleWork();
+        }
+
+        this->_schedulerCondition.wait(&this->_mutex, SCHEDULER_INTERVAL);
+    }
+}
@@ -0,0 +1,112 @@
+/****************************************************************************
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License as published by the Free Software Foundation; either
+** version 2.1 of the License, or (at your option) any later version.
+**
+** This library is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public
+** License along with this library; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**
+****************************************************************************/
+
+
+#ifndef RTMPREADERENGINE_H
+#define RTMPREADERENGINE_H
+
+#include <QObject>
+#include <QList>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QThreadPool>
+
+#include "audioplayer.h"
+
+class QThread;
+class QRunnable;
+class RTMPReaderPrivate;
+
+//! The RTMPReaderEngine class runs the decoding of all RTMPReader instances on one pool of worker threads.
+/*!
+  Every reader keeps a thread of its own only for reading the network, which mostly waits for data. Decoding and
+  presenting pictures is work of short tasks which the engine queues on a QThreadPool of workerCount() threads, so
+  a wall of many streams needs as many threads as there are CPU cores instead of several threads per stream. A stream
+  is never worked on by two workers at the same time, and an idle worker takes the next task of whichever stream has
+  one. A scheduler thread queues the work of readers whose next picture is due.
+
+  The engine owns the only AudioPlayer. Only the reader with the audio focus decodes and plays its audio,
+  the video of the other readers follows a wall clock.
+*/
+class RTMPReaderEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    RTMPReaderEngine();
+    virtual ~RTMPReaderEngine();
+
+    /*! Returns the engine shared by all readers of the application. */
+    static RTMPReaderEngine *instance();
+
+    /*! Sets how many worker threads decode the streams. The default value is QThread::idealThreadCount(). */
+    void setWorkerCount(int count);
+    int workerCount() const;
+
+    /*! Returns the count of readers which are reading a stream. */
+    int readerCount() const;
+
+    /*!
+      Gives the audio focus to \a reader, or to no reader if it is 0.
+      Samples buffered for the previous reader are played out, the audio of \a reader follows on a new timeline.
+    */
+    void setAudioFocus(RTMPReaderPrivate *reader);
+    RTMPReaderPrivate *audioFocus() const;
+    bool hasAudioFocus(const RTMPReaderPrivate *reader) const;
+
+    /*! Returns the player of the reader with the audio focus. */
+    AudioPlayer *player();
+
+    /*! Returns milliseconds since the engine has been created, the clock of presentation times. */
+    qint64 now() const;
+
+signals:
+    void audioFocusChanged();
+
+private:
+    friend class RTMPReaderPrivate;
+    friend class SchedulerThread;
+
+    /*! Adds \a reader to the readers whose presentation times are watched, the player runs while there is any. */
+    void registerReader(RTMPReaderPrivate *reader);
+    void unregisterReader(RTMPReaderPrivate *reader);
+
+    /*! Queues \a task on the worker pool. */
+    void startTask(QRunnable *task);
+
+    /*! Queues samples of \a reader for playback, they are discarded and false is returned if it has no audio focus. */
+    bool writeAudio(const RTMPReaderPrivate *reader, double pts, const QByteArray &data);
+
+    void schedule();
+
+    QThreadPool _pool;
+    QElapsedTimer _clock;
+
+    mutable QMutex _mutex;
+    QWaitCondition _schedulerCondition;
+    QList<RTMPReaderPrivate *> _readers;
+    QThread *_schedulerThread;
+    bool _schedulerStopped;
+
+    mutable QMutex _audioMutex;
+    RTMPReaderPrivate *_audioFocus;
+    AudioPlayer _player;
+};
+
+#endif // RTMPREADERENGINE_H
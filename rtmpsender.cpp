@@ -18,11 +18,6 @@
 
 #include "rtmpsender.h"
 
-#include <QSGGeometry>
-#include <QSGFlatColorMaterial>
-#include <QSGGeometryNode>
-
-
 #include <opencv2/opencv.hpp>
 
 #include "encoder/encoder.h"
@@ -75,10 +70,8 @@ VideoCodecSettings videoCodecSettingsLosslessStreaming()
 }
 
 RTMPSender::RTMPSender(QQuickItem *parent):
-    QQuickPaintedItem(parent)
+    VideoItem(parent)
 {
-     setFlag(ItemHasContents, true);
-
      camera = new CameraGrabber(this);
      camera->setDeviceIndex(0);
      camera->setLatency(50);
@@ -108,41 +101,14 @@ RTMPSender::RTMPSender(QQuickItem *parent):
 
      QObject::connect(camera, &CameraGrabber::frameAvailable,
                       this, &RTMPSender::frameAvailable);
+     QObject::connect(this->_streamer, &Streamer::statisticsUpdated,
+                      this, &RTMPSender::statisticsUpdated);
 }
 
 RTMPSender::~RTMPSender()
 {
 }
 
-QMutex locker;
-
-void RTMPSender::paint(QPainter *painter)
-{
-    QMutexLocker mutex(&locker);
-
-    QRect paintRect = this->_frame.rect();
-    QImage frame = this->_frame;
-
-    if (this->_streamer->encoder()->state() == Encoder::StoppedState) {
-        this->_frame = QImage();
-        this->update();
-        return;
-    }
-
-    if (!this->_frame.isNull()) {
-        if (paintRect.width() != painter->window().width() ||
-            paintRect.height() != painter->window().height()) {
-            frame = frame.scaled(painter->window().width(), painter->window().height(),
-                                 Qt::KeepAspectRatio);
-        }
-    }
-
-    painter->beginNativePainting();
-    painter->drawImage(QPoint(0,0), frame);
-    painter->endNativePainting();
-    this->update();
-}
-
 void RTMPSender::start(QString url)
 {
     if (!url.isEmpty()) {
@@ -163,6 +129,7 @@ void RTMPSender::start(QString url)
 void RTMPSender::stop()
 {
     this->_streamer->stop();
+    this->setFrame(QImage());
 }
 
 void RTMPSender::mute()
@@ -244,8 +211,16 @@ QString RTMPSender::audioDeviceByIndex(int index)
     return this->_streamer->audioGrabber()->deviceNameByIndex(index);
 }
 
+QVariantMap RTMPSender::statistics() const
+{
+    return this->_streamer->statistics();
+}
+
 void RTMPSender::frameAvailable(const QImage &frame, int pts)
 {
-    this->_frame = frame;
+    Q_UNUSED(pts);
+
+    //the grabber sends a null frame when it stops, which clears the preview
+    this->setFrame(frame);
 }
 
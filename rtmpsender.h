@@ -19,19 +19,17 @@
 #ifndef RTMPSENDER_H
 #define RTMPSENDER_H
 
-#include <QQuickItem>
-#include <QQuickPaintedItem>
 #include <QImage>
-#include <QPainter>
 #include <QString>
 
 #include "audiograbber.h"
 #include "cameragrabber.h"
 #include "streamer.h"
+#include "videoitem.h"
 
 class QtCameraGrabber;
 
-class RTMPSender : public QQuickPaintedItem
+class RTMPSender : public VideoItem
 {
     Q_OBJECT
     Q_DISABLE_COPY(RTMPSender)
@@ -44,12 +42,12 @@ class RTMPSender : public QQuickPaintedItem
     Q_PROPERTY(int cameraIndex READ cameraIndex WRITE setCameraIndex NOTIFY cameraIndexChanged)
     Q_PROPERTY(QVariant cameraDevices READ cameraDevices)
 
+    Q_PROPERTY(QVariantMap statistics READ statistics NOTIFY statisticsUpdated)
+
 public:
     explicit RTMPSender(QQuickItem *parent = 0);
     virtual ~RTMPSender();
 
-    void paint(QPainter *painter);
-
 public slots:
     Q_INVOKABLE void start(QString url = QString());
     Q_INVOKABLE void stop();
@@ -74,11 +72,14 @@ public slots:
     QVariant audioDevices() const;
     QString audioDeviceByIndex(int index);
 
+    QVariantMap statistics() const;
+
 signals:
     void urlChanged();
     void frameRateChanged();
     void audioDeviceIndexChanged();
     void cameraIndexChanged();
+    void statisticsUpdated(const QVariantMap &statistics);
 
 private slots:
     void frameAvailable(const QImage &frame, int pts);
@@ -86,7 +87,6 @@ private slots:
 private:
     CameraGrabber* camera;
     AudioGrabber* audioGrabber;
-    QImage _frame;
     Streamer* _streamer;
 
     QString _url;
@@ -36,10 +36,12 @@ Streamer::Streamer(QObject *parent) :
   , m_state(Streamer::StoppedState)
   , m_startMuteTime(-1)
   , m_muted(false)
+  , m_lastGrabbedFrameCount(0)
 {
     qRegisterMetaType<AbstractGrabber::State>("Streamer::State");
 
     connect(m_encoder, SIGNAL(started()), this, SLOT(startGrabbers()));
+    connect(m_encoder, SIGNAL(statisticsUpdated(QVariantMap)), this, SLOT(updateStatistics(QVariantMap)));
 }
 
 Streamer::~Streamer()
@@ -63,7 +65,9 @@ void Streamer::setImageGrabber(AbstractImageGrabber *grabber)
         }
 
         if (state() == Streamer::ActiveState || state() == Streamer::SuspendedState) {
-            connect(grabber, SIGNAL(frameAvailable(QImage,int)), m_encoder, SLOT(encodeVideoFrame(QImage,int)), Qt::UniqueConnection);
+            //the encoder queues frames itself, so they are passed directly from the grabber thread
+            connect(grabber, SIGNAL(videoFrameAvailable(VideoFrame,int)), m_encoder, SLOT(encodeVideoFrame(VideoFrame,int)),
+                    static_cast<Qt::ConnectionType>(Qt::DirectConnection | Qt::UniqueConnection));
 
             grabber->start();
 
@@ -104,6 +108,11 @@ bool Streamer::isMuted() const
     return m_muted;
 }
 
+QVariantMap Streamer::statistics() const
+{
+    return m_statistics;
+}
+
 void Streamer::start()
 {
     if (state() == Streamer::StoppedState) {
@@ -112,6 +121,10 @@ void Streamer::start()
             return;
         }
 
+        //the encoder converts the captured samples into the audio codec format
+        if (m_audioGrabber)
+            m_encoder->setAudioInputFormat(m_audioGrabber->format());
+
         m_encoder->start();
     }
 }
@@ -181,9 +194,13 @@ void Streamer::unmute()
 
 void Streamer::startGrabbers()
 {
+    m_lastGrabbedFrameCount = 0;
+    m_statisticsClock.start();
+
     if (m_imageGrabber) {
-        connect(m_imageGrabber, SIGNAL(frameAvailable(QImage,int)),
-                m_encoder, SLOT(encodeVideoFrame(QImage,int)), Qt::UniqueConnection);
+        connect(m_imageGrabber, SIGNAL(videoFrameAvailable(VideoFrame,int)),
+                m_encoder, SLOT(encodeVideoFrame(VideoFrame,int)),
+                static_cast<Qt::ConnectionType>(Qt::DirectConnection | Qt::UniqueConnection));
         connect(m_imageGrabber, SIGNAL(initialized()), m_audioGrabber, SLOT(start()));
 
         if (m_audioGrabber) {
@@ -216,6 +233,26 @@ void Streamer::startGrabbers()
     }
 }
 
+void Streamer::updateStatistics(const QVariantMap &encoderStatistics)
+{
+    QVariantMap statistics = encoderStatistics;
+
+    int grabbedFrameCount = m_imageGrabber ? m_imageGrabber->grabbedFrameCount() : 0;
+    qint64 elapsed = m_statisticsClock.isValid() ? m_statisticsClock.restart() : 0;
+
+    //the grabber restarts counting when it is started again
+    int grabbedFrames = grabbedFrameCount - (grabbedFrameCount >= m_lastGrabbedFrameCount ? m_lastGrabbedFrameCount : 0);
+    m_lastGrabbedFrameCount = grabbedFrameCount;
+
+    statistics["grabbedFrameCount"] = grabbedFrameCount;
+    statistics["captureFrameRate"] = elapsed > 0 ? grabbedFrames * 1000.0 / elapsed : 0.0;
+    statistics["grabbedAudioDataSize"] = m_audioGrabber ? m_audioGrabber->grabbedAudioDataSize() : 0;
+    statistics["audioOverrunCount"] = m_audioGrabber ? m_audioGrabber->overrunCount() : 0;
+
+    m_statistics = statistics;
+    Q_EMIT statisticsUpdated(m_statistics);
+}
+
 void Streamer::setState(Streamer::State state)
 {
     if (m_state != state) {
@@ -239,7 +276,8 @@ void Streamer::onGrabbersError()
 
 bool Streamer::connectAudioGrabber()
 {
-    return connect(m_audioGrabber, SIGNAL(dataAvailable(QByteArray, int)), m_encoder, SLOT(encodeAudioData(QByteArray, int)), Qt::UniqueConnection);
+    return connect(m_audioGrabber, SIGNAL(dataAvailable(QByteArray, int)), m_encoder, SLOT(encodeAudioData(QByteArray, int)),
+                   static_cast<Qt::ConnectionType>(Qt::DirectConnection | Qt::UniqueConnection));
 }
 
 bool Streamer::disconnectAudioGrabber()
@@ -251,31 +289,7 @@ void Streamer::encodeSilence(int milliseconds)
 {
     if (m_audioGrabber) {
         AudioFormat format = m_audioGrabber->format();
-
-        int sampleSize = 0;
-        switch (format.format()) {
-        case AudioFormat::SignedInt8:
-            sampleSize = 1;
-            break;
-
-        case AudioFormat::SignedInt16:
-            sampleSize = 2;
-            break;
-
-        case AudioFormat::SignedInt24:
-            sampleSize = 3;
-            break;
-
-        case AudioFormat::SignedInt32:
-        case AudioFormat::Float32:
-            sampleSize = 4;
-            break;
-
-        case AudioFormat::Float64:
-            sampleSize = 8;
-            break;
-        }
-
+        int sampleSize = format.bytesPerSample();
 
         int silenceDataSize = ((format.sampleRate() * format.channelCount() * sampleSize) / 1000) * milliseconds;
         QByteArray silenceData;
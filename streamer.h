@@ -21,6 +21,8 @@
 
 #include <QObject>
 #include <QImage>
+#include <QVariantMap>
+#include <QElapsedTimer>
 
 class AbstractImageGrabber;
 class CameraGrabber;
@@ -38,6 +40,7 @@ class AudioTimer;
 class Streamer: public QObject
 {
     Q_OBJECT
+    Q_PROPERTY(QVariantMap statistics READ statistics NOTIFY statisticsUpdated)
 public:
     /*! This enum describes the state of the recorder. */
     enum State {
@@ -62,6 +65,15 @@ public:
     /*! Returns a boolean value if audio is muted or no */
     bool isMuted() const;
 
+    /*!
+      Returns the last statistics snapshot: Encoder::statistics() extended with the capture counters
+      grabbedFrameCount, captureFrameRate (frames per second during the last interval), grabbedAudioDataSize and
+      audioOverrunCount (see AudioGrabber::overrunCount()).
+      The snapshot is refreshed every Encoder::statisticsInterval() milliseconds while streaming.
+      \sa statisticsUpdated()
+    */
+    QVariantMap statistics() const;
+
 public Q_SLOTS:
     /*! Starts audio/video grabbing. The state() is set to Recorder::ActiveState if no errors occurred. */
     void start();
@@ -82,9 +94,12 @@ Q_SIGNALS:
     void stateChanged(Streamer::State state);
     /*! This signal is emitted when an error occurs. */
     void error(const QString &errorString);
+    /*! This signal is emitted when a new statistics snapshot is available. */
+    void statisticsUpdated(const QVariantMap &statistics);
 
 private Q_SLOTS:
     void startGrabbers();
+    void updateStatistics(const QVariantMap &encoderStatistics);
 
 private:
     void setState(Streamer::State state);
@@ -103,6 +118,10 @@ private:
     Streamer::State m_state;
     int m_startMuteTime;
     bool m_muted;
+
+    QVariantMap m_statistics;
+    QElapsedTimer m_statisticsClock;
+    int m_lastGrabbedFrameCount;
 };
 
 #endif // RECORDER_H
@@ -28,20 +28,31 @@ win32 {
     -lavdevice \
     -lavformat \
     -lswscale \
+    -lswresample \
     -lavutil \
     -ldsound \
     -lole32 \
     -lwinmm
 }
 
+unix {
+    DEFINES += __LINUX_ALSA__ __LINUX_PULSE__
+    LIBS += -lasound -lpulse-simple -lpulse -lpthread
+}
+
 # Input
 SOURCES += \
     streamer_plugin.cpp \
     rtmpsender.cpp \
     abstractgrabber.cpp \
     abstractimagegrabber.cpp \
+    audiobackend.cpp \
     audiograbber.cpp \
     cameragrabber.cpp \
+    fileimagegrabber.cpp \
+    loopbackaudiobackend.cpp \
+    patternimagegrabber.cpp \
+    rtaudiobackend.cpp \
     streamer.cpp \
     3rdparty/RtAudio/include/asio.cpp \
     3rdparty/RtAudio/include/asiodrivers.cpp \
@@ -49,21 +60,36 @@ SOURCES += \
     3rdparty/RtAudio/include/iasiothiscallresolver.cpp \
     3rdparty/RtAudio/RtAudio.cpp \
     encoder/audiocodecsettings.cpp \
+    encoder/bitratecontroller.cpp \
     encoder/encoder.cpp \
+    encoder/muxer.cpp \
+    encoder/outputwriter.cpp \
+    encoder/renditionencoder.cpp \
     encoder/videocodecsettings.cpp \
+    encoder/videoframe.cpp \
     helpers/audiotimer.cpp \
+    helpers/jitterbuffer.cpp \
+    helpers/latencyhistogram.cpp \
+    helpers/ringbuffer.cpp \
     rtmpreader.cpp \
+    rtmpreaderengine.cpp \
     audioplayer.cpp \
     audioformat.cpp \
-    qtcameragrabber.cpp
+    qtcameragrabber.cpp \
+    videoitem.cpp
 
 HEADERS += \
     streamer_plugin.h \
     rtmpsender.h \
     abstractgrabber.h \
     abstractimagegrabber.h \
+    audiobackend.h \
     audiograbber.h \
     cameragrabber.h \
+    fileimagegrabber.h \
+    loopbackaudiobackend.h \
+    patternimagegrabber.h \
+    rtaudiobackend.h \
     streamer.h \
     3rdparty/RtAudio/include/asio.h \
     3rdparty/RtAudio/include/asiodrivers.h \
@@ -77,14 +103,25 @@ HEADERS += \
     3rdparty/RtAudio/include/soundcard.h \
     3rdparty/RtAudio/RtAudio.h \
     encoder/audiocodecsettings.h \
+    encoder/bitratecontroller.h \
     encoder/encoder.h \
     encoder/encoderglobal.h \
+    encoder/muxer.h \
+    encoder/outputwriter.h \
+    encoder/renditionencoder.h \
     encoder/videocodecsettings.h \
+    encoder/videoframe.h \
     helpers/audiotimer.h \
+    helpers/boundedqueue.h \
+    helpers/jitterbuffer.h \
+    helpers/latencyhistogram.h \
+    helpers/ringbuffer.h \
     rtmpreader.h \
+    rtmpreaderengine.h \
     audioplayer.h \
     audioformat.h \
-    qtcameragrabber.h
+    qtcameragrabber.h \
+    videoitem.h
 
 
 OTHER_FILES = qmldir
@@ -0,0 +1,88 @@
+/****************************************************************************
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License as published by the Free Software Foundation; either
+** version 2.1 of the License, or (at your option) any later version.
+**
+** This library is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public
+** License along with this library; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**
+****************************************************************************/
+
+
+#include "videoitem.h"
+
+#include <QQuickWindow>
+#include <QSGSimpleTextureNode>
+
+VideoItem::VideoItem(QQuickItem *parent)
+    : QQuickItem(parent)
+    , m_frameChanged(false)
+{
+    setFlag(ItemHasContents, true);
+}
+
+VideoItem::~VideoItem()
+{
+}
+
+QImage VideoItem::frame() const
+{
+    return m_frame;
+}
+
+void VideoItem::setFrame(const QImage &frame)
+{
+    //a null frame only needs a repaint if something is shown
+    if (frame.isNull() && m_frame.isNull())
+        return;
+
+    m_frame = frame;
+    m_frameChanged = true;
+    update();
+}
+
+QSGNode *VideoItem::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *data)
+{
+    Q_UNUSED(data);
+
+    QSGSimpleTextureNode *node = static_cast<QSGSimpleTextureNode *>(oldNode);
+
+    if (m_frame.isNull() || width() <= 0 || height() <= 0) {
+        delete node;
+        return 0;
+    }
+
+    if (!node) {
+        node = new QSGSimpleTextureNode;
+        node->setOwnsTexture(true);
+        node->setFiltering(QSGTexture::Linear);
+        m_frameChanged = true;
+    }
+
+    //the texture is only uploaded for a new frame, resizing the item just changes the node rectangle
+    if (m_frameChanged) {
+        node->setTexture(window()->createTextureFromImage(m_frame));
+        m_frameChanged = false;
+    }
+
+    QSizeF size = QSizeF(m_frame.size()).scaled(width(), height(), Qt::KeepAspectRatio);
+    node->setRect(QRectF(QPointF(0, 0), size));
+
+    return node;
+}
+
+void VideoItem::geometryChanged(const QRectF &newGeometry, const QRectF &oldGeometry)
+{
+    QQuickItem::geometryChanged(newGeometry, oldGeometry);
+
+    if (newGeometry.size() != oldGeometry.size())
+        update();
+}
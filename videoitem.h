@@ -0,0 +1,54 @@
+/****************************************************************************
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License as published by the Free Software Foundation; either
+** version 2.1 of the License, or (at your option) any later version.
+**
+** This library is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public
+** License along with this library; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**
+****************************************************************************/
+
+
+#ifndef VIDEOITEM_H
+#define VIDEOITEM_H
+
+#include <QQuickItem>
+#include <QImage>
+
+//! The VideoItem class is the base of QML items showing video frames.
+/*!
+  Frames passed to setFrame() are uploaded to a texture by the scene graph and scaled by it to the item size,
+  keeping the aspect ratio. The item is only repainted when a new frame arrives or its geometry changes.
+*/
+class VideoItem : public QQuickItem
+{
+    Q_OBJECT
+
+public:
+    explicit VideoItem(QQuickItem *parent = 0);
+    virtual ~VideoItem();
+
+    QImage frame() const;
+
+public Q_SLOTS:
+    /*! Shows \a frame, a null image clears the item. */
+    void setFrame(const QImage &frame);
+
+protected:
+    QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *data);
+    void geometryChanged(const QRectF &newGeometry, const QRectF &oldGeometry);
+
+private:
+    QImage m_frame;
+    bool m_frameChanged;
+};
+
+#endif // VIDEOITEM_H